@@ -0,0 +1,85 @@
+#include <steem/chain/block_log.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Rewrites a block log in the compressed format, or back to the uncompressed format with
+ * --decompress. The input is read through block_log, so either format is accepted. The
+ * index of the output is written alongside it.
+ */
+int main( int argc, char** argv )
+{
+   try
+   {
+      bool decompress = false;
+      bool need_help = false;
+      std::vector< std::string > paths;
+
+      for( int i = 1; i < argc; ++i )
+      {
+         std::string arg = argv[i];
+         if( arg == "--decompress" )
+            decompress = true;
+         else if( arg == "-h" || arg == "--help" )
+            need_help = true;
+         else
+            paths.push_back( arg );
+      }
+
+      if( need_help || paths.size() != 2 )
+      {
+         std::cerr << "compress_block_log [--decompress] <input block_log> <output block_log>\n"
+            "\n"
+            "Converts a block log between the uncompressed and the compressed format.\n"
+            "The output file must not exist.\n";
+         return 1;
+      }
+
+      fc::path input( paths[0] );
+      fc::path output( paths[1] );
+
+      FC_ASSERT( fc::exists( input ), "Input block log ${i} does not exist", ("i", input.generic_string()) );
+      FC_ASSERT( !fc::exists( output ), "Output block log ${o} already exists", ("o", output.generic_string()) );
+
+      steem::chain::block_log in;
+      in.open( input );
+      FC_ASSERT( in.head().valid(), "Input block log is empty" );
+
+      steem::chain::block_log out;
+      out.open( output, !decompress );
+
+      uint32_t head_block_num = in.head()->block_num();
+      auto itr = in.read_block( in.get_block_pos( 1 ) );
+
+      while( true )
+      {
+         uint32_t block_num = itr.first.block_num();
+         out.append( itr.first );
+
+         if( block_num % 100000 == 0 )
+            std::cerr << "   " << double( block_num * 100 ) / head_block_num << "%   " << block_num << " of " << head_block_num << "\n";
+
+         if( block_num == head_block_num )
+            break;
+
+         itr = in.read_block( itr.second );
+      }
+
+      out.flush();
+
+      std::cerr << "Wrote " << head_block_num << " blocks, " << fc::file_size( input ) << " bytes in, "
+         << fc::file_size( output ) << " bytes out\n";
+   }
+   catch( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+
+   return 0;
+}
@@ -1,15 +1,32 @@
 #include <fc/compress/zlib.hpp>
+#include <fc/exception/exception.hpp>
 
 #include "miniz.c"
 
 namespace fc
 {
   string zlib_compress(const string& in)
+  {
+    return zlib_compress(in.c_str(), in.size());
+  }
+
+  string zlib_compress(const char* in, size_t in_size)
   {
     size_t compressed_message_length;
-    char* compressed_message = (char*)tdefl_compress_mem_to_heap(in.c_str(), in.size(), &compressed_message_length,  TDEFL_WRITE_ZLIB_HEADER | TDEFL_DEFAULT_MAX_PROBES);
+    char* compressed_message = (char*)tdefl_compress_mem_to_heap(in, in_size, &compressed_message_length,  TDEFL_WRITE_ZLIB_HEADER | TDEFL_DEFAULT_MAX_PROBES);
+    FC_ASSERT( compressed_message != nullptr, "zlib compression failed" );
     string result(compressed_message, compressed_message_length);
     free(compressed_message);
     return result;
   }
+
+  string zlib_decompress(const char* in, size_t in_size, size_t out_size)
+  {
+    string result(out_size, '\0');
+    size_t decompressed_length = tinfl_decompress_mem_to_mem(&result[0], out_size, in, in_size, TINFL_FLAG_PARSE_ZLIB_HEADER);
+    FC_ASSERT( decompressed_length != TINFL_DECOMPRESS_MEM_TO_MEM_FAILED, "zlib decompression failed" );
+    FC_ASSERT( decompressed_length == out_size, "zlib stream decompressed to an unexpected size",
+      ("expected", out_size)("actual", decompressed_length) );
+    return result;
+  }
 }
@@ -6,5 +6,12 @@ namespace fc
 {
 
   string zlib_compress(const string& in);
+  string zlib_compress(const char* in, size_t in_size);
+
+  /**
+   * Decompresses a zlib stream whose decompressed size is known in advance.
+   * Throws if the stream is corrupt or does not decompress to exactly out_size bytes.
+   */
+  string zlib_decompress(const char* in, size_t in_size, size_t out_size);
 
 } // namespace fc
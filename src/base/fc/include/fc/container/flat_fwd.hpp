@@ -2,6 +2,8 @@
 #include <boost/container/flat_map.hpp>
 #include <boost/container/flat_set.hpp>
 #include <boost/interprocess/containers/vector.hpp>
+#include <boost/interprocess/containers/deque.hpp>
+#include <boost/interprocess/containers/string.hpp>
 
 namespace fc {
 
@@ -24,6 +26,16 @@ namespace fc {
        void pack( Stream& s, const bip::vector<T,A>& value );
        template<typename Stream, typename T, typename A>
        void unpack( Stream& s, bip::vector<T,A>& value );
+
+       template<typename Stream, typename T, typename... A>
+       void pack( Stream& s, const bip::deque<T,A...>& value );
+       template<typename Stream, typename T, typename... A>
+       void unpack( Stream& s, bip::deque<T,A...>& value );
+
+       template<typename Stream, typename... A>
+       void pack( Stream& s, const bip::basic_string<char,A...>& value );
+       template<typename Stream, typename... A>
+       void unpack( Stream& s, bip::basic_string<char,A...>& value );
    } // namespace raw
 
 } // fc
@@ -6,8 +6,10 @@
 #include <boost/interprocess/containers/flat_map.hpp>
 #include <boost/interprocess/containers/map.hpp>
 #include <boost/interprocess/containers/set.hpp>
+#include <boost/interprocess/containers/string.hpp>
 #include <boost/interprocess/containers/vector.hpp>
 #include <fc/crypto/hex.hpp>
+#include <fc/exception/exception.hpp>
 #include <fc/io/raw_fwd.hpp>
 
 // boost::interprocess::flat_map is an alias to boost::container::flat_map
@@ -142,6 +144,38 @@ namespace fc {
          for( auto& item : value )
              fc::raw::unpack( s, item );
        }
+
+       template<typename Stream, typename T, typename... A>
+       void pack( Stream& s, const bip::deque<T,A...>& value ) {
+         pack( s, unsigned_int((uint32_t)value.size()) );
+         for( const auto& item : value )
+           fc::raw::pack( s, item );
+       }
+       template<typename Stream, typename T, typename... A>
+       void unpack( Stream& s, bip::deque<T,A...>& value ) {
+         unsigned_int size;
+         unpack( s, size );
+         value.clear(); value.resize(size);
+         for( auto& item : value )
+             fc::raw::unpack( s, item );
+       }
+
+       // Serialized like std::string
+       template<typename Stream, typename... A>
+       void pack( Stream& s, const bip::basic_string<char,A...>& value ) {
+         pack( s, unsigned_int((uint32_t)value.size()) );
+         if( value.size() )
+           s.write( value.data(), value.size() );
+       }
+       template<typename Stream, typename... A>
+       void unpack( Stream& s, bip::basic_string<char,A...>& value ) {
+         unsigned_int size;
+         unpack( s, size );
+         FC_ASSERT( size.value < MAX_ARRAY_ALLOC_SIZE );
+         value.resize( size.value );
+         if( size.value )
+           s.read( &value[0], size.value );
+       }
    }
 
 template< typename E, typename Allocator >
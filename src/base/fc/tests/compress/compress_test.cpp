@@ -89,6 +89,9 @@ BOOST_AUTO_TEST_CASE( zlib_compression )
     std::string compressed = fc::zlib_compress( line );
     std::string decomp = zlib_decompress( compressed );
     BOOST_CHECK_EQUAL( decomp, line );
+
+    BOOST_CHECK_EQUAL( fc::zlib_decompress( compressed.data(), compressed.size(), line.size() ), line );
+    BOOST_CHECK_THROW( fc::zlib_decompress( compressed.data(), compressed.size(), line.size() - 1 ), fc::exception );
 }
 
 BOOST_AUTO_TEST_SUITE_END()
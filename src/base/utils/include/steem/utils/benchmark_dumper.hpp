@@ -56,6 +56,36 @@ public:
 
    typedef std::vector<database_object_sizeof_t> database_object_sizeof_cntr_t;
 
+   /// Conflict statistics of the analyzed blocks, see steem::chain::util::analyze_block_conflicts
+   struct block_conflict_stats_t
+   {
+      void add(const block_conflict_stats_t& other)
+      {
+         blocks += other.blocks;
+         transactions += other.transactions;
+         conflict_groups += other.conflict_groups;
+         serial_transactions += other.serial_transactions;
+         global_transactions += other.global_transactions;
+      }
+
+      uint64_t       blocks = 0;
+      uint64_t       transactions = 0;
+      uint64_t       conflict_groups = 0;
+      /// Sum of the largest conflict group of every block, transactions/serial_transactions bounds the speedup
+      uint64_t       serial_transactions = 0;
+      uint64_t       global_transactions = 0;
+   };
+
+   /// Shared memory segment statistics, see chainbase::database::get_segment_statistics
+   struct segment_stats_t
+   {
+      uint64_t       file_size = 0;
+      uint64_t       free_memory = 0;
+      /// Page size of the file system, the huge page size on hugetlbfs
+      uint64_t       page_size = 0;
+      uint64_t       huge_page_bytes = 0;
+   };
+
    class measurement
    {
    public:
@@ -74,6 +104,8 @@ public:
       int32_t  cpu_ms = 0;
       uint64_t current_mem = 0;
       uint64_t peak_mem = 0;
+      block_conflict_stats_t block_conflicts;
+      segment_stats_t segment_stats;
       index_memory_details_cntr_t index_memory_details_cntr;
    };
 
@@ -99,6 +131,20 @@ public:
       get_database_objects_sizeofs(_all_data.database_object_sizeofs);
    }
 
+   /// Adds block conflict statistics to the next measurement and the total
+   void add_block_conflicts(const block_conflict_stats_t& stats)
+   {
+      _block_conflicts.add(stats);
+      _all_data.total_measurement.block_conflicts.add(stats);
+   }
+
+   /// Sets the segment statistics of the next measurement and the total
+   void set_segment_stats(const segment_stats_t& stats)
+   {
+      _segment_stats = stats;
+      _all_data.total_measurement.segment_stats = stats;
+   }
+
    const measurement& measure(uint32_t block_number, get_indexes_memory_details_t get_indexes_memory_details)
    {
       uint64_t current_virtual = 0;
@@ -114,6 +160,9 @@ public:
                 int((current_cpu_time - _last_cpu_time) * 1000 / CLOCKS_PER_SEC), // cpu_ms
                 current_virtual,
                 peak_virtual );
+      data.block_conflicts = _block_conflicts;
+      _block_conflicts = block_conflict_stats_t();
+      data.segment_stats = _segment_stats;
       get_indexes_memory_details(data.index_memory_details_cntr, true);
       _all_data.measurements.push_back( data );
    
@@ -175,6 +224,8 @@ private:
    clock_t        _last_cpu_time = 0;
    uint64_t       _total_blocks = 0;
    pid_t          _pid = 0;
+   block_conflict_stats_t _block_conflicts;
+   segment_stats_t _segment_stats;
    TAllData       _all_data;
 };
 
@@ -188,8 +239,14 @@ FC_REFLECT( steem::utilities::benchmark_dumper::index_memory_details_t,
 FC_REFLECT( steem::utilities::benchmark_dumper::database_object_sizeof_t,
             (object_name)(object_size) )
 
+FC_REFLECT( steem::utilities::benchmark_dumper::block_conflict_stats_t,
+            (blocks)(transactions)(conflict_groups)(serial_transactions)(global_transactions) )
+
+FC_REFLECT( steem::utilities::benchmark_dumper::segment_stats_t,
+            (file_size)(free_memory)(page_size)(huge_page_bytes) )
+
 FC_REFLECT( steem::utilities::benchmark_dumper::measurement,
-            (block_number)(real_ms)(cpu_ms)(current_mem)(peak_mem)(index_memory_details_cntr) )
+            (block_number)(real_ms)(cpu_ms)(current_mem)(peak_mem)(block_conflicts)(segment_stats)(index_memory_details_cntr) )
 
 FC_REFLECT( steem::utilities::benchmark_dumper::TAllData,
             (database_object_sizeofs)(measurements)(total_measurement) )
@@ -1,12 +1,19 @@
 #include <steem/chain/block_log.hpp>
 #include <fstream>
 #include <fc/io/raw.hpp>
+#include <fc/compress/zlib.hpp>
 
 #include <boost/thread/mutex.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/interprocess/sync/lock_options.hpp>
 
-#define LOG_READ  (std::ios::in | std::ios::binary)
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
 
 namespace steem { namespace chain {
@@ -16,75 +23,131 @@ namespace steem { namespace chain {
    boost::interprocess::defer_lock_type defer_lock;
 
    namespace detail {
+      namespace bip = boost::interprocess;
+
+      /*
+       * Read only mapping of a prefix of an append only file. A mapping is never modified,
+       * when the file grows past it a larger mapping replaces it. Readers that still hold
+       * the old mapping keep it alive until they are done with it.
+       */
+      class mapped_file
+      {
+         public:
+            mapped_file( const fc::path& file, uint64_t size )
+               : _mapping( file.generic_string().c_str(), bip::read_only ),
+                 _region( _mapping, bip::read_only, 0, size )
+            {}
+
+            const char* data()const { return static_cast< const char* >( _region.get_address() ); }
+            uint64_t    size()const { return _region.get_size(); }
+
+         private:
+            bip::file_mapping  _mapping;
+            bip::mapped_region _region;
+      };
+
+      typedef std::shared_ptr< const mapped_file > mapped_file_ptr;
+
+      // First 8 bytes of a compressed block log. An uncompressed log starts with the zero previous id of block 1.
+      const uint64_t compressed_log_magic = 0x315a4c4254534d53ull; // "SMSTBLZ1"
+
+      // Precedes every block in a compressed log
+      struct compressed_block_header
+      {
+         uint32_t block_size  = 0;
+         uint32_t packed_size = 0;
+      };
+
       class block_log_impl {
          public:
             optional< signed_block > head;
             block_id_type            head_id;
-            std::fstream             block_stream;
-            std::fstream             index_stream;
+            std::atomic< uint32_t >  head_num{ 0 };
+            std::ofstream            block_stream;
+            std::ofstream            index_stream;
             fc::path                 block_file;
             fc::path                 index_file;
-            bool                     block_write = false;
-            bool                     index_write = false;
+
+            // Only accessed through std::atomic_load/std::atomic_store
+            mapped_file_ptr          block_map;
+            mapped_file_ptr          index_map;
+
+            // Sizes of the files up to the last completely written block. Mappings never extend
+            // past them, so readers can never observe a partially appended block.
+            std::atomic< uint64_t >  block_size{ 0 };
+            std::atomic< uint64_t >  index_size{ 0 };
 
             bool                     use_locking = true;
+            bool                     compressed = false;
 
+            // Serializes writers. Readers never take it.
             boost::mutex             mtx;
 
-            inline void check_block_read()
+            // Taken only when a reader needs to grow a mapping
+            std::mutex               remap_mtx;
+
+            /**
+             * Returns a mapping of file covering at least its first min_size bytes. Everything
+             * appended to the file is flushed before its size is published, so a reader that
+             * misses the current mapping only has to remap the file at its published size.
+             */
+            mapped_file_ptr get_mapping( mapped_file_ptr& map, const fc::path& file, const std::atomic< uint64_t >& published_size, uint64_t min_size )
+            {
+               auto m = std::atomic_load( &map );
+               if( m && m->size() >= min_size )
+                  return m;
+
+               std::lock_guard< std::mutex > guard( remap_mtx );
+
+               m = std::atomic_load( &map );
+               if( m && m->size() >= min_size )
+                  return m;
+
+               uint64_t file_size = published_size.load();
+               FC_ASSERT( file_size > 0 && file_size >= min_size, "Read past the end of ${f}",
+                  ("f", file.generic_string())("size", file_size)("required", min_size) );
+
+               m = std::make_shared< const mapped_file >( file, file_size );
+               std::atomic_store( &map, m );
+               return m;
+            }
+
+            mapped_file_ptr get_block_mapping( uint64_t min_size )
+            {
+               return get_mapping( block_map, block_file, block_size, min_size );
+            }
+
+            mapped_file_ptr get_index_mapping( uint64_t min_size )
+            {
+               return get_mapping( index_map, index_file, index_size, min_size );
+            }
+
+            void reset_mappings()
             {
-               try
-               {
-                  if( block_write )
-                  {
-                     block_stream.close();
-                     block_stream.open( block_file.generic_string().c_str(), LOG_READ );
-                     block_write = false;
-                  }
-               }
-               FC_LOG_AND_RETHROW()
+               std::lock_guard< std::mutex > guard( remap_mtx );
+               std::atomic_store( &block_map, mapped_file_ptr() );
+               std::atomic_store( &index_map, mapped_file_ptr() );
             }
 
-            inline void check_block_write()
+            uint64_t first_block_pos()const
             {
-               try
-               {
-                  if( !block_write )
-                  {
-                     block_stream.close();
-                     block_stream.open( block_file.generic_string().c_str(), LOG_WRITE );
-                     block_write = true;
-                  }
-               }
-               FC_LOG_AND_RETHROW()
+               return compressed ? sizeof( compressed_log_magic ) : 0;
             }
 
-            inline void check_index_read()
+            compressed_block_header read_compressed_header( uint64_t pos )
             {
-               try
-               {
-                  if( index_write )
-                  {
-                     index_stream.close();
-                     index_stream.open( index_file.generic_string().c_str(), LOG_READ );
-                     index_write = false;
-                  }
-               }
-               FC_LOG_AND_RETHROW()
+               auto m = get_block_mapping( pos + sizeof( compressed_block_header ) );
+               compressed_block_header header;
+               std::memcpy( &header, m->data() + pos, sizeof( header ) );
+               return header;
             }
 
-            inline void check_index_write()
+            /// Reads the trailing position stored in the last 8 bytes of a mapped file
+            static uint64_t read_last_pos( const mapped_file_ptr& m )
             {
-               try
-               {
-                  if( !index_write )
-                  {
-                     index_stream.close();
-                     index_stream.open( index_file.generic_string().c_str(), LOG_WRITE );
-                     index_write = true;
-                  }
-               }
-               FC_LOG_AND_RETHROW()
+               uint64_t pos;
+               std::memcpy( &pos, m->data() + m->size() - sizeof( pos ), sizeof( pos ) );
+               return pos;
             }
       };
    }
@@ -101,20 +164,25 @@ namespace steem { namespace chain {
       flush();
    }
 
-   void block_log::open( const fc::path& file )
+   void block_log::open( const fc::path& file, bool compress )
    {
       if( my->block_stream.is_open() )
          my->block_stream.close();
       if( my->index_stream.is_open() )
          my->index_stream.close();
+      my->reset_mappings();
+      my->head.reset();
+      my->head_id = block_id_type();
+      my->head_num = 0;
+      my->block_size = 0;
+      my->index_size = 0;
+      my->compressed = false;
 
       my->block_file = file;
       my->index_file = fc::path( file.generic_string() + ".index" );
 
       my->block_stream.open( my->block_file.generic_string().c_str(), LOG_WRITE );
       my->index_stream.open( my->index_file.generic_string().c_str(), LOG_WRITE );
-      my->block_write = true;
-      my->index_write = true;
 
       /* On startup of the block log, there are several states the log file and the index file can be
        * in relation to eachother.
@@ -136,8 +204,25 @@ namespace steem { namespace chain {
        */
       auto log_size = fc::file_size( my->block_file );
       auto index_size = fc::file_size( my->index_file );
+      my->block_size = log_size;
+      my->index_size = index_size;
+
+      if( log_size >= sizeof( detail::compressed_log_magic ) )
+      {
+         uint64_t magic;
+         std::memcpy( &magic, my->get_block_mapping( sizeof( magic ) )->data(), sizeof( magic ) );
+         my->compressed = ( magic == detail::compressed_log_magic );
+      }
+      else if( log_size == 0 && compress )
+      {
+         my->block_stream.write( (const char*)&detail::compressed_log_magic, sizeof( detail::compressed_log_magic ) );
+         my->block_stream.flush();
+         my->compressed = true;
+         log_size = sizeof( detail::compressed_log_magic );
+         my->block_size = log_size;
+      }
 
-      if( log_size )
+      if( log_size > my->first_block_pos() )
       {
          ilog( "Log is nonempty" );
          my->head = read_head();
@@ -145,17 +230,9 @@ namespace steem { namespace chain {
 
          if( index_size )
          {
-            my->check_block_read();
-            my->check_index_read();
-
             ilog( "Index is nonempty" );
-            uint64_t block_pos;
-            my->block_stream.seekg( -sizeof( uint64_t), std::ios::end );
-            my->block_stream.read( (char*)&block_pos, sizeof( block_pos ) );
-
-            uint64_t index_pos;
-            my->index_stream.seekg( -sizeof( uint64_t), std::ios::end );
-            my->index_stream.read( (char*)&index_pos, sizeof( index_pos ) );
+            uint64_t block_pos = my->read_last_pos( my->get_block_mapping( log_size ) );
+            uint64_t index_pos = my->read_last_pos( my->get_index_mapping( index_size ) );
 
             if( block_pos < index_pos )
             {
@@ -173,14 +250,17 @@ namespace steem { namespace chain {
             ilog( "Index is empty" );
             construct_index();
          }
+
+         my->head_num = protocol::block_header::num_from_id( my->head_id );
       }
       else if( index_size )
       {
          ilog( "Index is nonempty, remove and recreate it" );
          my->index_stream.close();
+         my->reset_mappings();
          fc::remove_all( my->index_file );
          my->index_stream.open( my->index_file.generic_string().c_str(), LOG_WRITE );
-         my->index_write = true;
+         my->index_size = 0;
       }
    }
 
@@ -194,6 +274,11 @@ namespace steem { namespace chain {
       return my->block_stream.is_open();
    }
 
+   bool block_log::is_compressed()const
+   {
+      return my->compressed;
+   }
+
    uint64_t block_log::append( const signed_block& b )
    {
       try
@@ -205,19 +290,40 @@ namespace steem { namespace chain {
             lock.lock();;
          }
 
-         my->check_block_write();
-         my->check_index_write();
-
          uint64_t pos = my->block_stream.tellp();
          FC_ASSERT( static_cast<uint64_t>(my->index_stream.tellp()) == sizeof( uint64_t ) * ( b.block_num() - 1 ),
             "Append to index file occuring at wrong position.",
             ( "position", (uint64_t) my->index_stream.tellp() )( "expected",( b.block_num() - 1 ) * sizeof( uint64_t ) ) );
          auto data = fc::raw::pack_to_vector( b );
-         my->block_stream.write( data.data(), data.size() );
+         uint64_t entry_size = data.size();
+
+         if( my->compressed )
+         {
+            auto packed = fc::zlib_compress( data.data(), data.size() );
+            detail::compressed_block_header header;
+            header.block_size = data.size();
+            header.packed_size = packed.size();
+            my->block_stream.write( (const char*)&header, sizeof( header ) );
+            my->block_stream.write( packed.data(), packed.size() );
+            entry_size = sizeof( header ) + packed.size();
+         }
+         else
+         {
+            my->block_stream.write( data.data(), data.size() );
+         }
+
          my->block_stream.write( (char*)&pos, sizeof( pos ) );
          my->index_stream.write( (char*)&pos, sizeof( pos ) );
+
+         // Readers map the files directly, so the block has to reach the file before it is published
+         my->block_stream.flush();
+         my->index_stream.flush();
+         my->block_size = pos + entry_size + sizeof( pos );
+         my->index_size = sizeof( uint64_t ) * b.block_num();
+
          my->head = b;
          my->head_id = b.id();
+         my->head_num = b.block_num();
 
          return pos;
       }
@@ -239,13 +345,6 @@ namespace steem { namespace chain {
 
    std::pair< signed_block, uint64_t > block_log::read_block( uint64_t pos )const
    {
-      scoped_lock lock( my->mtx, defer_lock );
-
-      if( my->use_locking )
-      {
-         lock.lock();;
-      }
-
       return read_block_helper( pos );
    }
 
@@ -253,28 +352,47 @@ namespace steem { namespace chain {
    {
       try
       {
-         my->check_block_read();
-
-         my->block_stream.seekg( pos );
          std::pair<signed_block,uint64_t> result;
-         fc::raw::unpack( my->block_stream, result.first );
-         result.second = uint64_t(my->block_stream.tellg()) + 8;
+
+         if( my->compressed )
+         {
+            auto header = my->read_compressed_header( pos );
+            uint64_t packed_pos = pos + sizeof( header );
+            auto m = my->get_block_mapping( packed_pos + header.packed_size );
+
+            auto data = fc::zlib_decompress( m->data() + packed_pos, header.packed_size, header.block_size );
+            fc::datastream< const char* > ds( data.data(), data.size() );
+            fc::raw::unpack( ds, result.first );
+            result.second = packed_pos + header.packed_size + 8;
+            return result;
+         }
+
+         auto m = my->get_block_mapping( pos + 1 );
+
+         fc::datastream< const char* > ds( m->data() + pos, m->size() - pos );
+         fc::raw::unpack( ds, result.first );
+         result.second = pos + ds.tellp() + 8;
          return result;
       }
       FC_LOG_AND_RETHROW()
    }
 
+   uint64_t block_log::next_block_pos( uint64_t pos )const
+   {
+      if( my->compressed )
+         return pos + sizeof( detail::compressed_block_header ) + my->read_compressed_header( pos ).packed_size + 8;
+
+      auto m = my->get_block_mapping( pos + 1 );
+      fc::datastream< const char* > ds( m->data() + pos, m->size() - pos );
+      signed_block tmp;
+      fc::raw::unpack( ds, tmp );
+      return pos + ds.tellp() + 8;
+   }
+
    optional< signed_block > block_log::read_block_by_num( uint32_t block_num )const
    {
       try
       {
-         scoped_lock lock( my->mtx, defer_lock );
-
-         if( my->use_locking )
-         {
-            lock.lock();;
-         }
-
          optional< signed_block > b;
          uint64_t pos = get_block_pos_helper( block_num );
          if( pos != npos )
@@ -287,15 +405,60 @@ namespace steem { namespace chain {
       FC_LOG_AND_RETHROW()
    }
 
-   uint64_t block_log::get_block_pos( uint32_t block_num ) const
+   vector< signed_block > block_log::read_block_range( uint32_t first_block_num, uint32_t count )const
    {
-      scoped_lock lock( my->mtx, defer_lock );
-
-      if( my->use_locking )
+      try
       {
-         lock.lock();;
+         vector< signed_block > result;
+
+         uint32_t head_num = my->head_num.load();
+         if( count == 0 || first_block_num == 0 || first_block_num > head_num )
+            return result;
+
+         uint32_t last_block_num = first_block_num + std::min( count - 1, head_num - first_block_num );
+         uint64_t pos = get_block_pos_helper( first_block_num );
+         uint64_t end_pos = last_block_num < head_num ? get_block_pos_helper( last_block_num + 1 ) : my->block_size.load();
+
+         // Map the whole range once and walk it front to back
+         auto m = my->get_block_mapping( end_pos );
+         size_t num_blocks = last_block_num - first_block_num + 1;
+         result.reserve( num_blocks );
+
+         while( result.size() < num_blocks )
+         {
+            result.emplace_back();
+
+            if( my->compressed )
+            {
+               detail::compressed_block_header header;
+               std::memcpy( &header, m->data() + pos, sizeof( header ) );
+               pos += sizeof( header );
+
+               auto data = fc::zlib_decompress( m->data() + pos, header.packed_size, header.block_size );
+               fc::datastream< const char* > ds( data.data(), data.size() );
+               fc::raw::unpack( ds, result.back() );
+               pos += header.packed_size;
+            }
+            else
+            {
+               fc::datastream< const char* > ds( m->data() + pos, end_pos - pos );
+               fc::raw::unpack( ds, result.back() );
+               pos += ds.tellp();
+            }
+
+            pos += sizeof( uint64_t );
+         }
+
+         FC_ASSERT( result.front().block_num() == first_block_num && result.back().block_num() == last_block_num,
+            "Wrong blocks were read from block log.", ("first", first_block_num)("last", last_block_num) );
+
+         return result;
       }
+      FC_LOG_AND_RETHROW()
+   }
 
+   uint64_t block_log::get_block_pos( uint32_t block_num ) const
+   {
       return get_block_pos_helper( block_num );
    }
 
@@ -303,13 +466,13 @@ namespace steem { namespace chain {
    {
       try
       {
-         my->check_index_read();
-
-         if( !( my->head.valid() && block_num <= protocol::block_header::num_from_id( my->head_id ) && block_num > 0 ) )
+         if( !( block_num <= my->head_num.load() && block_num > 0 ) )
             return npos;
-         my->index_stream.seekg( sizeof( uint64_t ) * ( block_num - 1 ) );
+
+         uint64_t offset = sizeof( uint64_t ) * ( block_num - 1 );
+         auto m = my->get_index_mapping( offset + sizeof( uint64_t ) );
          uint64_t pos;
-         my->index_stream.read( (char*)&pos, sizeof( pos ) );
+         std::memcpy( &pos, m->data() + offset, sizeof( pos ) );
          return pos;
       }
       FC_LOG_AND_RETHROW()
@@ -319,18 +482,10 @@ namespace steem { namespace chain {
    {
       try
       {
-         scoped_lock lock( my->mtx, defer_lock );
-
-         if( my->use_locking )
-         {
-            lock.lock();;
-         }
+         uint64_t log_size = my->block_size.load();
+         FC_ASSERT( log_size >= my->first_block_pos() + sizeof( uint64_t ), "Block log is empty" );
 
-         my->check_block_read();
-
-         uint64_t pos;
-         my->block_stream.seekg( -sizeof(pos), std::ios::end );
-         my->block_stream.read( (char*)&pos, sizeof(pos) );
+         uint64_t pos = my->read_last_pos( my->get_block_mapping( log_size ) );
          return read_block_helper( pos ).first;
       }
       FC_LOG_AND_RETHROW()
@@ -354,32 +509,30 @@ namespace steem { namespace chain {
       {
          ilog( "Reconstructing Block Log Index..." );
          my->index_stream.close();
+         my->reset_mappings();
          fc::remove_all( my->index_file );
          my->index_stream.open( my->index_file.generic_string().c_str(), LOG_WRITE );
-         my->index_write = true;
+         my->index_size = 0;
 
-         uint64_t pos = 0;
-         uint64_t end_pos;
-         my->check_block_read();
+         uint64_t end_pos = my->read_last_pos( my->get_block_mapping( my->block_size.load() ) );
+         uint64_t pos = my->first_block_pos();
 
-         my->block_stream.seekg( -sizeof( uint64_t), std::ios::end );
-         my->block_stream.read( (char*)&end_pos, sizeof( end_pos ) );
-         signed_block tmp;
-
-         my->block_stream.seekg( pos );
-
-         while( pos < end_pos )
+         while( true )
          {
-            fc::raw::unpack( my->block_stream, tmp );
-            my->block_stream.read( (char*)&pos, sizeof( pos ) );
             my->index_stream.write( (char*)&pos, sizeof( pos ) );
+            if( pos >= end_pos )
+               break;
+            pos = next_block_pos( pos );
          }
+
+         my->index_stream.flush();
+         my->index_size = fc::file_size( my->index_file );
       }
       FC_LOG_AND_RETHROW()
    }
 
    void block_log::set_locking( bool use_locking )
    {
-      my->use_locking = true;
+      my->use_locking = use_locking;
    }
 } } // steem::chain
@@ -0,0 +1,159 @@
+#include <steem/chain/comment_content_store.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/io/raw.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace steem { namespace chain {
+
+   namespace detail
+   {
+      const uint64_t content_log_magic = 0x31544e434d545353ull; // "SSTMCNT1"
+
+      const char* const content_log_name = "comment_content.log";
+      const char* const content_index_name = "comment_content.index";
+
+      void write_all( int fd, const char* data, size_t size, uint64_t pos )
+      {
+         while( size )
+         {
+            auto written = ::pwrite( fd, data, size, pos );
+            if( written < 0 && errno == EINTR )
+               continue;
+            FC_ASSERT( written > 0, "Error writing the comment content store: ${e}", ("e", strerror( errno )) );
+            data += written;
+            size -= written;
+            pos += written;
+         }
+      }
+
+      /// Returns false if the file ends before size bytes are read
+      bool read_all( int fd, char* data, size_t size, uint64_t pos )
+      {
+         while( size )
+         {
+            auto read = ::pread( fd, data, size, pos );
+            if( read < 0 && errno == EINTR )
+               continue;
+            FC_ASSERT( read >= 0, "Error reading the comment content store: ${e}", ("e", strerror( errno )) );
+            if( read == 0 )
+               return false;
+            data += read;
+            size -= read;
+            pos += read;
+         }
+
+         return true;
+      }
+
+      int open_file( const fc::path& file )
+      {
+         int fd = ::open( file.generic_string().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644 );
+         FC_ASSERT( fd >= 0, "Could not open ${f}: ${e}", ("f", file)("e", strerror( errno )) );
+         return fd;
+      }
+   }
+
+   comment_content_store::~comment_content_store()
+   {
+      close();
+   }
+
+   void comment_content_store::open( const fc::path& dir )
+   {
+      close();
+
+      fc::create_directories( dir );
+      _log_fd = detail::open_file( dir / detail::content_log_name );
+      _index_fd = detail::open_file( dir / detail::content_index_name );
+
+      struct stat st;
+      FC_ASSERT( ::fstat( _log_fd, &st ) == 0, "Could not stat ${f}", ("f", dir / detail::content_log_name) );
+      _log_size = st.st_size;
+
+      if( _log_size == 0 )
+      {
+         detail::write_all( _log_fd, (const char*)&detail::content_log_magic, sizeof( detail::content_log_magic ), 0 );
+         _log_size = sizeof( detail::content_log_magic );
+      }
+      else
+      {
+         uint64_t magic = 0;
+         FC_ASSERT( detail::read_all( _log_fd, (char*)&magic, sizeof( magic ), 0 ) && magic == detail::content_log_magic,
+            "${f} is not a comment content log", ("f", dir / detail::content_log_name) );
+      }
+   }
+
+   void comment_content_store::close()
+   {
+      if( !is_open() )
+         return;
+
+      flush();
+      ::close( _log_fd );
+      ::close( _index_fd );
+      _log_fd = -1;
+      _index_fd = -1;
+      _log_size = 0;
+   }
+
+   void comment_content_store::append( comment_id_type comment, const comment_content& content )
+   {
+      FC_ASSERT( is_open(), "The comment content store is not open" );
+
+      auto data = fc::raw::pack_to_vector( content );
+      uint32_t size = data.size();
+      uint64_t pos = _log_size;
+
+      detail::write_all( _log_fd, (const char*)&size, sizeof( size ), pos );
+      detail::write_all( _log_fd, data.data(), data.size(), pos + sizeof( size ) );
+      _log_size += sizeof( size ) + data.size();
+
+      detail::write_all( _index_fd, (const char*)&pos, sizeof( pos ), uint64_t( comment._id ) * sizeof( pos ) );
+   }
+
+   fc::optional< comment_content > comment_content_store::read( comment_id_type comment )const
+   {
+      FC_ASSERT( is_open(), "The comment content store is not open" );
+
+      // Comments past the end of the index or in a hole of it read as position 0
+      uint64_t pos = 0;
+      if( !detail::read_all( _index_fd, (char*)&pos, sizeof( pos ), uint64_t( comment._id ) * sizeof( pos ) ) || pos == 0 )
+         return fc::optional< comment_content >();
+
+      uint32_t size = 0;
+      std::vector< char > data;
+      FC_ASSERT( detail::read_all( _log_fd, (char*)&size, sizeof( size ), pos ), "Truncated comment content log", ("comment", comment) );
+      data.resize( size );
+      FC_ASSERT( detail::read_all( _log_fd, data.data(), size, pos + sizeof( size ) ), "Truncated comment content log", ("comment", comment) );
+
+      return fc::raw::unpack_from_vector< comment_content >( data );
+   }
+
+   void comment_content_store::flush()
+   {
+      if( !is_open() )
+         return;
+
+      ::fsync( _log_fd );
+      ::fsync( _index_fd );
+   }
+
+   bool comment_content_store::exists( const fc::path& dir )
+   {
+      return fc::exists( dir / detail::content_log_name );
+   }
+
+   void comment_content_store::remove( const fc::path& dir )
+   {
+      fc::remove_all( dir / detail::content_log_name );
+      fc::remove_all( dir / detail::content_index_name );
+   }
+
+} } // steem::chain
@@ -27,13 +27,18 @@
 #include <fc/container/deque.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/scoped_exit.hpp>
 
 #include <boost/scope_exit.hpp>
 
+#include <condition_variable>
 #include <cstdint>
 #include <deque>
+#include <exception>
 #include <fstream>
 #include <functional>
+#include <mutex>
+#include <thread>
 
 namespace steem { namespace chain {
 
@@ -74,6 +79,162 @@ struct reward_fund_context
    share_type  steem_awarded = 0;
 };
 
+namespace detail {
+
+/**
+ * Reads and unpacks blocks from the block log on a dedicated thread during replay, so that
+ * block log I/O, deserialization and computing block and transaction ids overlap with applying
+ * the previous blocks. At most max_depth blocks are buffered ahead of the consumer.
+ */
+class block_prefetcher
+{
+   public:
+      struct prefetched_block
+      {
+         signed_block                  block;
+         block_id_type                 id;
+         vector< transaction_id_type > transaction_ids;
+      };
+
+      block_prefetcher( block_log& log, uint32_t last_block_num, size_t max_depth )
+         : _max_depth( std::max< size_t >( max_depth, 1 ) )
+      {
+         _thread = std::thread( [this, &log, last_block_num]() { read_blocks( log, last_block_num ); } );
+      }
+
+      ~block_prefetcher()
+      {
+         {
+            std::lock_guard< std::mutex > guard( _mutex );
+            _stopped = true;
+         }
+         _not_full.notify_all();
+         _thread.join();
+      }
+
+      /// Returns the next block in the log, blocking until the reader has produced it
+      prefetched_block next()
+      {
+         std::unique_lock< std::mutex > lock( _mutex );
+         _not_empty.wait( lock, [this]() { return !_queue.empty() || _done; } );
+
+         if( _queue.empty() )
+         {
+            if( _exception )
+               std::rethrow_exception( _exception );
+            FC_THROW_EXCEPTION( block_log_exception, "Reached the end of the block log while replaying" );
+         }
+
+         prefetched_block result = std::move( _queue.front() );
+         _queue.pop_front();
+         lock.unlock();
+         _not_full.notify_one();
+
+         return result;
+      }
+
+   private:
+      void read_blocks( block_log& log, uint32_t last_block_num )
+      {
+         try
+         {
+            uint64_t pos = log.get_block_pos( 1 );
+            uint32_t block_num = 0;
+
+            while( block_num != last_block_num )
+            {
+               auto next = log.read_block( pos );
+               pos = next.second;
+
+               prefetched_block b;
+               b.block = std::move( next.first );
+               b.id = b.block.id();
+               block_num = block_header::num_from_id( b.id );
+
+               b.transaction_ids.reserve( b.block.transactions.size() );
+               for( const auto& trx : b.block.transactions )
+                  b.transaction_ids.push_back( trx.id() );
+
+               std::unique_lock< std::mutex > lock( _mutex );
+               _not_full.wait( lock, [this]() { return _queue.size() < _max_depth || _stopped; } );
+               if( _stopped )
+                  break;
+
+               _queue.push_back( std::move( b ) );
+               lock.unlock();
+               _not_empty.notify_one();
+            }
+         }
+         catch( ... )
+         {
+            std::lock_guard< std::mutex > guard( _mutex );
+            _exception = std::current_exception();
+         }
+
+         {
+            std::lock_guard< std::mutex > guard( _mutex );
+            _done = true;
+         }
+         _not_empty.notify_all();
+      }
+
+      const size_t                     _max_depth;
+      std::deque< prefetched_block >   _queue;
+      std::mutex                       _mutex;
+      std::condition_variable          _not_empty;
+      std::condition_variable          _not_full;
+      std::exception_ptr               _exception;
+      bool                             _done = false;
+      bool                             _stopped = false;
+      std::thread                      _thread;
+};
+
+} // detail
+
+/**
+ * Work done at the end of every block. This is a table of the end of block functions, not a deadline
+ * queue: due times are not registered anywhere, and is_due peeks at the head of the index the task
+ * works off, which the task repeats as its first loop check when it runs. That peek lets a block where
+ * nothing is due skip the setup work of the task. Tasks without is_due change state on every block,
+ * such as process_comment_cashout decaying the reward funds, and always run.
+ */
+struct maintenance_task
+{
+   std::string                maintenance_name;
+   std::function< bool() >    is_due;
+   std::function< void() >    apply;
+};
+
+/**
+ * When an object of a maintenance index is due. The task functions loop while the head of their index
+ * is due and the is_due of their task checks the head, both through these predicates.
+ */
+namespace maintenance {
+
+bool is_due( const transaction_object& o, time_point_sec now ) { return now > o.expiration; }
+bool is_due( const account_object& o, time_point_sec now ) { return o.next_vesting_withdrawal <= now; }
+bool is_due( const limit_order_object& o, time_point_sec now ) { return o.expiration < now; }
+bool is_due( const vesting_delegation_expiration_object& o, time_point_sec now ) { return o.expiration < now; }
+bool is_due( const convert_request_object& o, time_point_sec now ) { return o.conversion_date <= now; }
+bool is_due( const savings_withdraw_object& o, time_point_sec now ) { return o.complete <= now; }
+bool is_due( const account_recovery_request_object& o, time_point_sec now ) { return o.expires <= now; }
+bool is_due( const change_recovery_account_request_object& o, time_point_sec now ) { return o.effective_on <= now; }
+bool is_due( const escrow_object& o, time_point_sec now ) { return !o.is_approved() && o.ratification_deadline <= now; }
+bool is_due( const decline_voting_rights_request_object& o, time_point_sec now ) { return o.effective_date <= now; }
+
+bool is_due( const owner_authority_history_object& o, time_point_sec now )
+{
+   return time_point_sec( o.last_valid_time + STEEM_OWNER_AUTH_RECOVERY_PERIOD ) < now;
+}
+
+template< typename Index >
+bool is_head_due( const Index& idx, time_point_sec now )
+{
+   return !idx.empty() && is_due( *idx.begin(), now );
+}
+
+} // maintenance
+
 class database_impl
 {
    public:
@@ -81,6 +242,7 @@ class database_impl
 
       database&                              _self;
       evaluator_registry< operation >        _evaluator_registry;
+      vector< maintenance_task >             _maintenance_tasks;
 };
 
 database_impl::database_impl( database& self )
@@ -90,6 +252,7 @@ database::database()
    : _my( new database_impl(*this) )
 {
    set_chain_id( STEEM_CHAIN_ID_NAME );
+   initialize_maintenance_tasks();
 }
 
 database::~database()
@@ -102,20 +265,30 @@ void database::open( const open_args& args )
    try
    {
       init_schema();
+      set_segment_options( args.shared_file_options );
       chainbase::database::open( args.shared_mem_dir, args.chainbase_flags, args.shared_file_size );
 
       initialize_indexes();
       initialize_evaluators();
 
+      if( args.comment_content_store )
+         _content_store.open( args.data_dir );
+      else
+         FC_ASSERT( !comment_content_store::exists( args.data_dir ),
+            "The state keeps comment content in ${d}, enable comment-content-store or replay the blockchain", ("d", args.data_dir) );
+
       if( !find< dynamic_global_property_object >() )
          with_write_lock( [&]()
          {
-            init_genesis( args.initial_supply );
+            if( args.load_snapshot == fc::path() )
+               init_genesis( args.initial_supply );
+            else
+               load_snapshot( args.load_snapshot, args.snapshot_load_threads );
          });
 
       _benchmark_dumper.set_enabled( args.benchmark_is_enabled );
 
-      _block_log.open( args.data_dir / "block_log" );
+      _block_log.open( args.data_dir / "block_log", args.compress_block_log );
 
       auto log_head = _block_log.head();
 
@@ -170,6 +343,7 @@ uint32_t database::reindex( const open_args& args )
 
       ilog( "Reindexing Blockchain" );
       wipe( args.data_dir, args.shared_mem_dir, false );
+      comment_content_store::remove( args.data_dir );
       open( args );
       _fork_db.reset();    // override effect of _fork_db.start_block() call in open()
 
@@ -193,7 +367,9 @@ uint32_t database::reindex( const open_args& args )
       with_write_lock( [&]()
       {
          _block_log.set_locking( false );
-         auto itr = _block_log.read_block( 0 );
+         _deferring_indices = true;
+         auto stop_deferring = fc::make_scoped_exit( [&]() { _deferring_indices = false; } );
+
          auto last_block_num = _block_log.head()->block_num();
          if( args.stop_replay_at > 0 && args.stop_replay_at < last_block_num )
             last_block_num = args.stop_replay_at;
@@ -202,21 +378,27 @@ uint32_t database::reindex( const open_args& args )
             args.benchmark.second( 0, get_abstract_index_cntr() );
          }
 
-         while( itr.first.block_num() != last_block_num )
+         detail::block_prefetcher prefetcher( _block_log, last_block_num, args.replay_prefetch_depth );
+         auto itr = prefetcher.next();
+
+         while( itr.block.block_num() != last_block_num )
          {
-            auto cur_block_num = itr.first.block_num();
+            auto cur_block_num = itr.block.block_num();
             if( cur_block_num % 100000 == 0 )
                std::cerr << "   " << double( cur_block_num * 100 ) / last_block_num << "%   " << cur_block_num << " of " << last_block_num <<
                "   (" << (get_free_memory() / (1024*1024)) << "M free)\n";
-            apply_block( itr.first, skip_flags );
+            apply_block( itr.block, itr.id, skip_flags, &itr.transaction_ids );
 
             if( (args.benchmark.first > 0) && (cur_block_num % args.benchmark.first == 0) )
                args.benchmark.second( cur_block_num, get_abstract_index_cntr() );
-            itr = _block_log.read_block( itr.second );
+            itr = prefetcher.next();
          }
 
-         apply_block( itr.first, skip_flags );
-         note.last_block_number = itr.first.block_num();
+         apply_block( itr.block, itr.id, skip_flags, &itr.transaction_ids );
+         note.last_block_number = itr.block.block_num();
+
+         _deferring_indices = false;
+         build_deferred_indices();
 
          if( (args.benchmark.first > 0) && (note.last_block_number % args.benchmark.first == 0) )
             args.benchmark.second( note.last_block_number, get_abstract_index_cntr() );
@@ -238,6 +420,79 @@ uint32_t database::reindex( const open_args& args )
 
 }
 
+void database::compact( const open_args& args )
+{ try {
+   auto start = fc::time_point::now();
+   auto snapshot = args.data_dir / "compact.snapshot";
+
+   open_args compact_args = args;
+   compact_args.load_snapshot = snapshot;
+
+   with_write_lock( [&]()
+   {
+      auto before = get_segment_fragmentation();
+      ilog( "Compacting shared memory: ${f}M free in ${n} blocks, the largest is ${l}M",
+         ("f", before.free_memory / (1024*1024))("n", before.free_block_count)("l", before.largest_free_block / (1024*1024)) );
+   });
+
+   with_read_lock( [&]()
+   {
+      // The objects never take more room in a fresh segment than they do in the fragmented one
+      uint64_t used = get_max_memory() - get_free_memory();
+      compact_args.shared_file_size = std::max< uint64_t >( args.shared_file_size,
+         used + ( uint128_t( used ) * args.shared_file_scale_rate / STEEM_100_PERCENT ).to_uint64() );
+
+      export_snapshot( snapshot );
+   });
+
+   // Once wiped the state only exists in the snapshot, it is kept if loading fails
+   wipe( args.data_dir, args.shared_mem_dir, false );
+   open( compact_args );
+   fc::remove( snapshot );
+
+   ilog( "Compacted shared memory to ${f}M free of ${s}M in ${t} sec",
+      ("f", get_free_memory() / (1024*1024))("s", get_max_memory() / (1024*1024))
+      ("t", double( ( fc::time_point::now() - start ).count() ) / 1000000.0) );
+} FC_CAPTURE_AND_RETHROW( (args.data_dir)(args.shared_mem_dir) ) }
+
+void database::build_deferred_indices()
+{ try {
+   if( _deferred_index_builders.empty() )
+      return;
+
+   auto start = fc::time_point::now();
+   std::exception_ptr error;
+   std::mutex         error_mutex;
+
+   // Each builder only writes its own index, the indices they read are not written until all are joined
+   std::vector< std::thread > workers;
+   for( const auto& item : _deferred_index_builders )
+   {
+      const auto& build = item.second;
+      workers.emplace_back( [&]()
+      {
+         try
+         {
+            build();
+         }
+         catch( ... )
+         {
+            std::lock_guard< std::mutex > guard( error_mutex );
+            if( !error )
+               error = std::current_exception();
+         }
+      });
+   }
+
+   for( auto& worker : workers )
+      worker.join();
+
+   if( error )
+      std::rethrow_exception( error );
+
+   ilog( "Built ${n} deferred indices in ${t} sec", ("n", workers.size())("t", double( ( fc::time_point::now() - start ).count() ) / 1000000.0) );
+} FC_CAPTURE_AND_RETHROW() }
+
 void database::wipe( const fc::path& data_dir, const fc::path& shared_mem_dir, bool include_blocks)
 {
    close();
@@ -246,6 +501,7 @@ void database::wipe( const fc::path& data_dir, const fc::path& shared_mem_dir, b
    {
       fc::remove_all( data_dir / "block_log" );
       fc::remove_all( data_dir / "block_log.index" );
+      comment_content_store::remove( data_dir );
    }
 }
 
@@ -258,7 +514,9 @@ void database::close(bool rewind)
       // DB state (issue #336).
       clear_pending();
 
-      chainbase::database::flush();
+      _content_store.close();
+
+      // Flushes the state, a second flush would write an anonymous segment's image twice
       chainbase::database::close();
 
       _block_log.close();
@@ -354,6 +612,11 @@ optional<signed_block> database::fetch_block_by_number( uint32_t block_num )cons
    return b;
 } FC_LOG_AND_RETHROW() }
 
+vector<signed_block> database::fetch_irreversible_block_range( uint32_t first, uint32_t count )const
+{ try {
+   return _block_log.read_block_range( first, count );
+} FC_LOG_AND_RETHROW() }
+
 const signed_transaction database::get_recent_transaction( const transaction_id_type& trx_id ) const
 { try {
    auto& index = get_index<transaction_index>().indices().get<by_trx_id>();
@@ -397,7 +660,7 @@ void database::foreach_block(std::function<bool(const signed_block_header&, cons
    if(!_block_log.head())
       return;
 
-   auto itr = _block_log.read_block( 0 );
+   auto itr = _block_log.read_block( _block_log.get_block_pos( 1 ) );
    auto last_block_num = _block_log.head()->block_num();
    signed_block_header previousBlockHeader = itr.first;
    while( itr.first.block_num() != last_block_num )
@@ -471,27 +734,50 @@ const account_object* database::find_account( const account_name_type& name )con
    return find< account_object, by_name >( name );
 }
 
-const comment_object& database::get_comment( const account_name_type& author, const shared_string& permlink )const
+const comment_object& database::get_comment( const account_name_type& author, comment_permlink_id_type permlink )const
 { try {
-   return get< comment_object, by_permlink >( boost::make_tuple( author, permlink ) );
+   const auto& link = get( permlink );
+   return get< comment_object, by_permlink >( boost::make_tuple( author, link.hash, link.value ) );
 } FC_CAPTURE_AND_RETHROW( (author)(permlink) ) }
 
-const comment_object* database::find_comment( const account_name_type& author, const shared_string& permlink )const
+const comment_object* database::find_comment( const account_name_type& author, comment_permlink_id_type permlink )const
 {
-   return find< comment_object, by_permlink >( boost::make_tuple( author, permlink ) );
+   const auto& link = get( permlink );
+   return find< comment_object, by_permlink >( boost::make_tuple( author, link.hash, link.value ) );
 }
 
-#ifndef ENABLE_STD_ALLOCATOR
 const comment_object& database::get_comment( const account_name_type& author, const string& permlink )const
 { try {
-   return get< comment_object, by_permlink >( boost::make_tuple( author, permlink) );
+   return get< comment_object, by_permlink >( boost::make_tuple( author, permlink_hash( permlink ), permlink ) );
 } FC_CAPTURE_AND_RETHROW( (author)(permlink) ) }
 
 const comment_object* database::find_comment( const account_name_type& author, const string& permlink )const
 {
-   return find< comment_object, by_permlink >( boost::make_tuple( author, permlink ) );
+   return find< comment_object, by_permlink >( boost::make_tuple( author, permlink_hash( permlink ), permlink ) );
+}
+
+const comment_permlink_object* database::find_permlink( const string& permlink )const
+{
+   return find< comment_permlink_object, by_hash >( boost::make_tuple( permlink_hash( permlink ), permlink ) );
+}
+
+string database::get_permlink( comment_permlink_id_type permlink )const
+{
+   return to_string( get( permlink ).value );
+}
+
+comment_permlink_id_type database::intern_permlink( const string& permlink )
+{
+   auto link = find_permlink( permlink );
+   if( link != nullptr )
+      return link->id;
+
+   return create< comment_permlink_object >( [&]( comment_permlink_object& l )
+   {
+      l.hash = permlink_hash( permlink );
+      from_string( l.value, permlink );
+   }).id;
 }
-#endif
 
 const escrow_object& database::get_escrow( const account_name_type& name, uint32_t escrow_id )const
 { try {
@@ -605,6 +891,10 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
          FC_CAPTURE_AND_RETHROW( (new_block) )
 
          check_free_memory( false, new_block.block_num() );
+
+         // The pending transactions are not applied at this point, so snapshot readers see the
+         // head block state. If they hold the snapshot for too long it is published with the next block.
+         publish_snapshot( 100000 );
       });
    });
 
@@ -763,11 +1053,17 @@ void database::_push_transaction( const signed_transaction& trx )
    // The temporary session will be discarded by the destructor if
    // _apply_transaction fails.  If we make it to merge(), we
    // apply the changes.
+   // The lock groups stay locked until the session is merged or discarded, so their readers, which do not
+   // take the database lock, never see the writes of a transaction that fails.
 
+   auto lock_groups = hold_lock_groups();
    auto temp_session = start_undo_session();
    _apply_transaction( trx );
    _pending_tx.push_back( trx );
 
+   if( !( get_node_properties().skip_flags & skip_validate ) )
+      _validated_tx.insert( trx.id() );
+
    notify_changed_objects();
    // The transaction applied successfully. Merge its changes into the pending block session.
    temp_session.squash();
@@ -875,6 +1171,7 @@ signed_block database::_generate_block(
 
       try
       {
+         auto lock_groups = hold_lock_groups();
          auto temp_session = start_undo_session();
          _apply_transaction( tx );
          temp_session.squash();
@@ -1397,7 +1694,7 @@ void database::process_vesting_withdrawals()
 
    const auto& cprops = get_dynamic_global_properties();
 
-   while( current != widx.end() && current->next_vesting_withdrawal <= head_block_time() )
+   while( current != widx.end() && maintenance::is_due( *current, head_block_time() ) )
    {
       const auto& from_account = *current; ++current;
 
@@ -1896,7 +2193,7 @@ void database::process_savings_withdraws()
   const auto& idx = get_index< savings_withdraw_index >().indices().get< by_complete_from_rid >();
   auto itr = idx.begin();
   while( itr != idx.end() ) {
-     if( itr->complete > head_block_time() )
+     if( !maintenance::is_due( *itr, head_block_time() ) )
         break;
      adjust_balance( get_account( itr->to ), itr->amount );
 
@@ -1959,7 +2256,7 @@ void database::process_conversions()
    asset net_sbd( 0, SBD_SYMBOL );
    asset net_steem( 0, STEEM_SYMBOL );
 
-   while( itr != request_by_date.end() && itr->conversion_date <= now )
+   while( itr != request_by_date.end() && maintenance::is_due( *itr, now ) )
    {
       auto amount_to_issue = itr->amount * fhistory.current_median_history;
 
@@ -2000,7 +2297,7 @@ void database::account_recovery_processing()
    const auto& rec_req_idx = get_index< account_recovery_request_index >().indices().get< by_expiration >();
    auto rec_req = rec_req_idx.begin();
 
-   while( rec_req != rec_req_idx.end() && rec_req->expires <= head_block_time() )
+   while( rec_req != rec_req_idx.end() && maintenance::is_due( *rec_req, head_block_time() ) )
    {
       remove( *rec_req );
       rec_req = rec_req_idx.begin();
@@ -2010,7 +2307,7 @@ void database::account_recovery_processing()
    const auto& hist_idx = get_index< owner_authority_history_index >().indices(); //by id
    auto hist = hist_idx.begin();
 
-   while( hist != hist_idx.end() && time_point_sec( hist->last_valid_time + STEEM_OWNER_AUTH_RECOVERY_PERIOD ) < head_block_time() )
+   while( hist != hist_idx.end() && maintenance::is_due( *hist, head_block_time() ) )
    {
       remove( *hist );
       hist = hist_idx.begin();
@@ -2020,7 +2317,7 @@ void database::account_recovery_processing()
    const auto& change_req_idx = get_index< change_recovery_account_request_index >().indices().get< by_effective_date >();
    auto change_req = change_req_idx.begin();
 
-   while( change_req != change_req_idx.end() && change_req->effective_on <= head_block_time() )
+   while( change_req != change_req_idx.end() && maintenance::is_due( *change_req, head_block_time() ) )
    {
       modify( get_account( change_req->account_to_recover ), [&]( account_object& a )
       {
@@ -2037,7 +2334,7 @@ void database::expire_escrow_ratification()
    const auto& escrow_idx = get_index< escrow_index >().indices().get< by_ratification_deadline >();
    auto escrow_itr = escrow_idx.lower_bound( false );
 
-   while( escrow_itr != escrow_idx.end() && !escrow_itr->is_approved() && escrow_itr->ratification_deadline <= head_block_time() )
+   while( escrow_itr != escrow_idx.end() && maintenance::is_due( *escrow_itr, head_block_time() ) )
    {
       const auto& old_escrow = *escrow_itr;
       ++escrow_itr;
@@ -2055,7 +2352,7 @@ void database::process_decline_voting_rights()
    const auto& request_idx = get_index< decline_voting_rights_request_index >().indices().get< by_effective_date >();
    auto itr = request_idx.begin();
 
-   while( itr != request_idx.end() && itr->effective_date <= head_block_time() )
+   while( itr != request_idx.end() && maintenance::is_due( *itr, head_block_time() ) )
    {
       const auto& account = get< account_object, by_name >( itr->account );
 
@@ -2169,6 +2466,7 @@ void database::initialize_indexes()
 {
    add_core_index< dynamic_global_property_index           >(*this);
    add_core_index< account_index                           >(*this);
+   add_core_index< account_metadata_index                  >(*this);
    add_core_index< account_authority_index                 >(*this);
    add_core_index< witness_index                           >(*this);
    add_core_index< transaction_index                       >(*this);
@@ -2176,6 +2474,7 @@ void database::initialize_indexes()
    add_core_index< witness_schedule_index                  >(*this);
    add_core_index< comment_index                           >(*this);
    add_core_index< comment_content_index                   >(*this);
+   add_core_index< comment_permlink_index                  >(*this);
    add_core_index< comment_vote_index                      >(*this);
    add_core_index< witness_vote_index                      >(*this);
    add_core_index< limit_order_index                       >(*this);
@@ -2194,6 +2493,24 @@ void database::initialize_indexes()
    add_core_index< reward_fund_index                       >(*this);
    add_core_index< vesting_delegation_index                >(*this);
    add_core_index< vesting_delegation_expiration_index     >(*this);
+#ifndef IS_LOW_MEM
+   add_core_index< comment_last_update_index               >(*this);
+
+   set_deferred_index_builder< comment_last_update_index >( [this]()
+   {
+      const auto& comments = get_index< comment_index >().indices();
+      auto itr = comments.begin();
+
+      bulk_create< comment_last_update_object >( comments.size(), [&]( comment_last_update_object& clu, size_t )
+      {
+         clu.comment = itr->id;
+         clu.parent_author = itr->parent_author;
+         clu.author = itr->author;
+         clu.last_update = itr->last_update;
+         ++itr;
+      });
+   });
+#endif
 
    _plugin_index_signal();
 }
@@ -2395,6 +2712,24 @@ void database::validate_transaction( const signed_transaction& trx )
    });
 }
 
+void database::precompute_signature_keys( const signed_transaction& trx )const
+{
+   try
+   {
+      // Recovered keys are remembered by the signature key cache
+      trx.get_signature_keys( get_chain_id() );
+   }
+   catch( const fc::exception& )
+   {
+      // Invalid signatures are reported when the transaction is applied
+   }
+}
+
+flat_set< public_key_type > database::get_signature_keys( const signed_transaction& trx )const
+{
+   return trx.get_signature_keys( get_chain_id() );
+}
+
 void database::notify_changed_objects()
 {
    try
@@ -2433,15 +2768,21 @@ void database::set_flush_interval( uint32_t flush_blocks )
 //////////////////// private methods ////////////////////
 
 void database::apply_block( const signed_block& next_block, uint32_t skip )
+{
+   apply_block( next_block, next_block.id(), skip );
+}
+
+void database::apply_block( const signed_block& next_block, const block_id_type& next_block_id, uint32_t skip,
+   const vector< transaction_id_type >* trx_ids )
 { try {
    //fc::time_point begin_time = fc::time_point::now();
 
-   auto block_num = next_block.block_num();
+   auto block_num = block_header::num_from_id( next_block_id );
    if( _checkpoints.size() && _checkpoints.rbegin()->second != block_id_type() )
    {
       auto itr = _checkpoints.find( block_num );
       if( itr != _checkpoints.end() )
-         FC_ASSERT( next_block.id() == itr->second, "Block did not match checkpoint", ("checkpoint",*itr)("block_id",next_block.id()) );
+         FC_ASSERT( next_block_id == itr->second, "Block did not match checkpoint", ("checkpoint",*itr)("block_id",next_block_id) );
 
       if( _checkpoints.rbegin()->first >= block_num )
          skip = skip_witness_signature
@@ -2461,7 +2802,7 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
 
    detail::with_skip_flags( *this, skip, [&]()
    {
-      _apply_block( next_block );
+      _apply_block( next_block, next_block_id, trx_ids );
    } );
 
    /*try
@@ -2497,7 +2838,11 @@ void database::apply_block( const signed_block& next_block, uint32_t skip )
       {
          _next_flush_block = 0;
          //ilog( "Flushing database shared memory at block ${b}", ("b", block_num) );
-         chainbase::database::flush();
+         // Content moved out of the state has to be on disk before the state without it
+         _content_store.flush();
+         // The image of an anonymous segment is written by a forked process instead of the write thread
+         if( !chainbase::database::flush_in_background() )
+            wlog( "Skipping the state flush at block ${b}, the previous image is still being written", ("b", block_num) );
       }
    }
 
@@ -2542,9 +2887,9 @@ void database::check_free_memory( bool force_print, uint32_t current_block_num )
    }
 }
 
-void database::_apply_block( const signed_block& next_block )
+void database::_apply_block( const signed_block& next_block, const block_id_type& next_block_id, const vector< transaction_id_type >* trx_ids )
 { try {
-   block_notification note( next_block );
+   block_notification note( next_block, next_block_id );
 
    notify_pre_apply_block( note );
 
@@ -2654,7 +2999,7 @@ void database::_apply_block( const signed_block& next_block )
        * for transactions when validating broadcast transactions or
        * when building a block.
        */
-      apply_transaction( trx, skip );
+      apply_transaction( trx, trx_ids ? (*trx_ids)[ _current_trx_in_block ] : trx.id(), skip );
       ++_current_trx_in_block;
    }
 
@@ -2668,27 +3013,7 @@ void database::_apply_block( const signed_block& next_block )
    update_last_irreversible_block();
 
    create_block_summary(next_block);
-   clear_expired_transactions();
-   clear_expired_orders();
-   clear_expired_delegations();
-   update_witness_schedule(*this);
-
-   update_median_feed();
-   update_virtual_supply();
-
-   clear_null_account_balance();
-   process_funds();
-   process_conversions();
-   process_comment_cashout();
-   process_vesting_withdrawals();
-   process_savings_withdraws();
-   update_virtual_supply();
-
-   account_recovery_processing();
-   expire_escrow_ratification();
-   process_decline_voting_rights();
-
-   process_hardforks();
+   process_maintenance_tasks();
 
    // notify observers that the block has been applied
    notify_post_apply_block( note );
@@ -2811,25 +3136,28 @@ try {
    }
 } FC_CAPTURE_AND_RETHROW() }
 
-void database::apply_transaction(const signed_transaction& trx, uint32_t skip)
+void database::apply_transaction(const signed_transaction& trx, const transaction_id_type& trx_id, uint32_t skip)
 {
-   detail::with_skip_flags( *this, skip, [&]() { _apply_transaction(trx); });
+   detail::with_skip_flags( *this, skip, [&]() { _apply_transaction(trx, trx_id); });
 }
 
 void database::_apply_transaction(const signed_transaction& trx)
+{
+   _apply_transaction( trx, trx.id() );
+}
+
+void database::_apply_transaction(const signed_transaction& trx, const transaction_id_type& trx_id)
 { try {
-   transaction_notification note(trx);
+   transaction_notification note(trx, trx_id);
    _current_trx_id = note.transaction_id;
-   const transaction_id_type& trx_id = note.transaction_id;
    _current_virtual_op = 0;
 
    uint32_t skip = get_node_properties().skip_flags;
 
-   if( !(skip&skip_validate) )   /* issue #505 explains why this skip_flag is disabled */
+   if( !(skip&skip_validate) && _validated_tx.find( trx_id ) == _validated_tx.end() )   /* issue #505 explains why this skip_flag is disabled */
       trx.validate();
 
    auto& trx_idx = get_index<transaction_index>();
-   const chain_id_type& chain_id = get_chain_id();
    // idump((trx_id)(skip&skip_transaction_dupe_check));
    FC_ASSERT( (skip & skip_transaction_dupe_check) ||
               trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end(),
@@ -2843,7 +3171,7 @@ void database::_apply_transaction(const signed_transaction& trx)
 
       try
       {
-         trx.verify_authority( chain_id, get_active, get_owner, get_posting,
+         trx.verify_authority( get_signature_keys( trx ), get_active, get_owner, get_posting,
             STEEM_MAX_SIG_CHECK_DEPTH, STEEM_MAX_AUTHORITY_MEMBERSHIP, STEEM_MAX_SIG_CHECK_ACCOUNTS );
       }
       catch( protocol::tx_missing_active_auth& e )
@@ -2905,13 +3233,12 @@ void database::apply_operation(const operation& op)
    operation_notification note(op);
    notify_pre_apply_operation( note );
 
-   if( _benchmark_dumper.is_enabled() )
-      _benchmark_dumper.begin();
+   util::advanced_benchmark_dumper::scope timer( _benchmark_dumper );
 
    _my->_evaluator_registry.get_evaluator( op ).apply( op );
 
    if( _benchmark_dumper.is_enabled() )
-      _benchmark_dumper.end< true/*APPLY_CONTEXT*/ >( _my->_evaluator_registry.get_evaluator( op ).get_name( op ) );
+      timer.end< true/*APPLY_CONTEXT*/ >( _my->_evaluator_registry.get_evaluator( op ).get_name( op ) );
 
    notify_post_apply_operation( note );
 }
@@ -2934,13 +3261,11 @@ struct fcall<TResult(TArgs...)>
 
    void operator () (TArgs&&... args)
    {
-      if (_benchmark_dumper.is_enabled())
-         _benchmark_dumper.begin();
+      util::advanced_benchmark_dumper::scope timer( _benchmark_dumper );
 
       _func(std::forward<TArgs>(args)...);
 
-      if (_benchmark_dumper.is_enabled())
-         _benchmark_dumper.end(_name);
+      timer.end(_name);
    }
 
 private:
@@ -2980,14 +3305,13 @@ boost::signals2::connection database::any_apply_operation_handler_impl( const ap
             name = _benchmark_dumper.generate_desc< IS_PRE_OPERATION >( plugin.get_name(), _my->_evaluator_registry.get_evaluator( o.op ).get_name( o.op ) );
          else
             name = util::advanced_benchmark_dumper::get_virtual_operation_name();
-
-         _benchmark_dumper.begin();
       }
 
+      util::advanced_benchmark_dumper::scope timer( _benchmark_dumper );
+
       func( o );
 
-      if (_benchmark_dumper.is_enabled())
-         _benchmark_dumper.end( name );
+      timer.end( name );
    };
 
    if( IS_PRE_OPERATION )
@@ -3076,8 +3400,10 @@ const witness_object& database::validate_block_header( uint32_t skip, const sign
 void database::create_block_summary(const signed_block& next_block)
 { try {
    block_summary_id_type sid( next_block.block_num() & 0xffff );
+   // _currently_processing_block_id is always set by _apply_block, which avoids hashing the header again
+   FC_ASSERT( _currently_processing_block_id.valid() );
    modify( get< block_summary_object >( sid ), [&](block_summary_object& p) {
-         p.block_id = next_block.id();
+         p.block_id = *_currently_processing_block_id;
    });
 } FC_CAPTURE_AND_RETHROW() }
 
@@ -3232,6 +3558,8 @@ void database::update_last_irreversible_block()
       notify_irreversible_block( i );
    }
 
+   migrate_irreversible_content();
+
    if( !( get_node_properties().skip_flags & skip_block_log ) )
    {
       // output to block log based on new last irreverisible block num
@@ -3258,6 +3586,35 @@ void database::update_last_irreversible_block()
    _fork_db.set_max_size( dpo.head_block_number - dpo.last_irreversible_block_num + 1 );
 } FC_CAPTURE_AND_RETHROW() }
 
+void database::migrate_irreversible_content()
+{ try {
+   if( !_content_store.is_open() )
+      return;
+
+   // Moving content again after the removal was undone by a fork switch only writes the same content twice
+   const auto& content_idx = get_index< comment_content_index, by_block >();
+   auto last_irreversible_block_num = get_dynamic_global_properties().last_irreversible_block_num;
+   auto itr = content_idx.begin();
+
+   vector< const comment_content_object* > to_delete;
+
+   while( itr != content_idx.end() && itr->block_num <= last_irreversible_block_num )
+   {
+      comment_content content;
+      content.title = to_string( itr->title );
+      content.body = to_string( itr->body );
+      content.json_metadata = to_string( itr->json_metadata );
+      _content_store.append( itr->comment, content );
+
+      to_delete.push_back( &(*itr) );
+      ++itr;
+   }
+
+   for( const comment_content_object* con : to_delete )
+   {
+      remove( *con );
+   }
+} FC_CAPTURE_AND_RETHROW() }
 
 bool database::apply_order( const limit_order_object& new_order_object )
 {
@@ -3394,13 +3751,94 @@ void database::cancel_order( const limit_order_object& order )
 }
 
 
+void database::initialize_maintenance_tasks()
+{
+   auto& tasks = _my->_maintenance_tasks;
+   tasks.clear();
+
+   auto add_task = [&]( const char* name, std::function< void() > apply, std::function< bool() > is_due = std::function< bool() >() )
+   {
+      tasks.push_back( maintenance_task{ std::string( "maintenance--->" ) + name, is_due, apply } );
+   };
+
+   // The order of the tasks is consensus, is_due must be true whenever apply would change the state
+   add_task( "clear_expired_transactions", [this](){ clear_expired_transactions(); }, [this]()
+   {
+      return maintenance::is_head_due( get_index< transaction_index, by_expiration >(), head_block_time() );
+   });
+   add_task( "clear_expired_orders", [this](){ clear_expired_orders(); }, [this]()
+   {
+      return maintenance::is_head_due( get_index< limit_order_index, by_expiration >(), head_block_time() );
+   });
+   add_task( "clear_expired_delegations", [this](){ clear_expired_delegations(); }, [this]()
+   {
+      return maintenance::is_head_due( get_index< vesting_delegation_expiration_index, by_expiration >(), head_block_time() );
+   });
+   add_task( "update_witness_schedule", [this](){ update_witness_schedule( *this ); } );
+
+   add_task( "update_median_feed", [this](){ update_median_feed(); } );
+   add_task( "update_virtual_supply", [this](){ update_virtual_supply(); } );
+
+   add_task( "clear_null_account_balance", [this](){ clear_null_account_balance(); } );
+   add_task( "process_funds", [this](){ process_funds(); } );
+   add_task( "process_conversions", [this](){ process_conversions(); }, [this]()
+   {
+      return maintenance::is_head_due( get_index< convert_request_index, by_conversion_date >(), head_block_time() );
+   });
+   add_task( "process_comment_cashout", [this](){ process_comment_cashout(); } );
+   add_task( "process_vesting_withdrawals", [this](){ process_vesting_withdrawals(); }, [this]()
+   {
+      return maintenance::is_head_due( get_index< account_index, by_next_vesting_withdrawal >(), head_block_time() );
+   });
+   add_task( "process_savings_withdraws", [this](){ process_savings_withdraws(); }, [this]()
+   {
+      return maintenance::is_head_due( get_index< savings_withdraw_index, by_complete_from_rid >(), head_block_time() );
+   });
+   add_task( "update_virtual_supply", [this](){ update_virtual_supply(); } );
+
+   add_task( "account_recovery_processing", [this](){ account_recovery_processing(); }, [this]()
+   {
+      auto now = head_block_time();
+      return maintenance::is_head_due( get_index< account_recovery_request_index, by_expiration >(), now )
+         || maintenance::is_head_due( get_index< owner_authority_history_index >().indices(), now )
+         || maintenance::is_head_due( get_index< change_recovery_account_request_index, by_effective_date >(), now );
+   });
+   add_task( "expire_escrow_ratification", [this](){ expire_escrow_ratification(); }, [this]()
+   {
+      const auto& idx = get_index< escrow_index, by_ratification_deadline >();
+      auto itr = idx.lower_bound( false );
+      return itr != idx.end() && maintenance::is_due( *itr, head_block_time() );
+   });
+   add_task( "process_decline_voting_rights", [this](){ process_decline_voting_rights(); }, [this]()
+   {
+      return maintenance::is_head_due( get_index< decline_voting_rights_request_index, by_effective_date >(), head_block_time() );
+   });
+
+   add_task( "process_hardforks", [this](){ process_hardforks(); } );
+}
+
+void database::process_maintenance_tasks()
+{
+   for( const auto& task : _my->_maintenance_tasks )
+   {
+      if( task.is_due && !task.is_due() )
+         continue;
+
+      util::advanced_benchmark_dumper::scope timer( _benchmark_dumper );
+
+      task.apply();
+
+      timer.end( task.maintenance_name );
+   }
+}
+
 void database::clear_expired_transactions()
 {
    //Look for expired transactions in the deduplication list, and remove them.
    //Transactions must have expired by at least two forking windows in order to be removed.
    auto& transaction_idx = get_index< transaction_index >();
    const auto& dedupe_index = transaction_idx.indices().get< by_expiration >();
-   while( ( !dedupe_index.empty() ) && ( head_block_time() > dedupe_index.begin()->expiration ) )
+   while( maintenance::is_head_due( dedupe_index, head_block_time() ) )
       remove( *dedupe_index.begin() );
 }
 
@@ -3409,7 +3847,7 @@ void database::clear_expired_orders()
    auto now = head_block_time();
    const auto& orders_by_exp = get_index<limit_order_index>().indices().get<by_expiration>();
    auto itr = orders_by_exp.begin();
-   while( itr != orders_by_exp.end() && itr->expiration < now )
+   while( itr != orders_by_exp.end() && maintenance::is_due( *itr, now ) )
    {
       cancel_order( *itr );
       itr = orders_by_exp.begin();
@@ -3421,7 +3859,7 @@ void database::clear_expired_delegations()
    auto now = head_block_time();
    const auto& delegations_by_exp = get_index< vesting_delegation_expiration_index, by_expiration >();
    auto itr = delegations_by_exp.begin();
-   while( itr != delegations_by_exp.end() && itr->expiration < now )
+   while( itr != delegations_by_exp.end() && maintenance::is_due( *itr, now ) )
    {
       modify( get_account( itr->delegator ), [&]( account_object& a )
       {
@@ -16,6 +16,11 @@ namespace steem { namespace chain {
 
    using steem::protocol::authority;
 
+   /**
+    * Balances, voting and reward state of an account. It is modified by most operations, so it
+    * owns no memory outside of itself and is undone through deltas. Profile data that is rarely
+    * touched lives in account_metadata_object.
+    */
    class account_object : public object< account_object_type, account_object >
    {
       account_object() = delete;
@@ -23,7 +28,6 @@ namespace steem { namespace chain {
       public:
          template<typename Constructor, typename Allocator>
          account_object( Constructor&& c, allocator< Allocator > a )
-            :json_metadata( a )
          {
             c(*this);
          };
@@ -32,7 +36,6 @@ namespace steem { namespace chain {
 
          account_name_type name;
          public_key_type   memo_key;
-         shared_string     json_metadata;
          account_name_type proxy;
 
          time_point_sec    last_account_update;
@@ -122,6 +125,23 @@ namespace steem { namespace chain {
          }
    };
 
+   class account_metadata_object : public object< account_metadata_object_type, account_metadata_object >
+   {
+      account_metadata_object() = delete;
+
+      public:
+         template< typename Constructor, typename Allocator >
+         account_metadata_object( Constructor&& c, allocator< Allocator > a )
+            : json_metadata( a )
+         {
+            c( *this );
+         }
+
+         id_type           id;
+         account_id_type   account;
+         shared_string     json_metadata;
+   };
+
    class account_authority_object : public object< account_authority_object_type, account_authority_object >
    {
       account_authority_object() = delete;
@@ -265,6 +285,17 @@ namespace steem { namespace chain {
 
    struct by_account;
 
+   typedef multi_index_container <
+      account_metadata_object,
+      indexed_by <
+         ordered_unique< tag< by_id >,
+            member< account_metadata_object, account_metadata_id_type, &account_metadata_object::id > >,
+         ordered_unique< tag< by_account >,
+            member< account_metadata_object, account_id_type, &account_metadata_object::account > >
+      >,
+      allocator< account_metadata_object >
+   > account_metadata_index;
+
    typedef multi_index_container <
       owner_authority_history_object,
       indexed_by <
@@ -402,7 +433,7 @@ namespace steem { namespace chain {
 } }
 
 FC_REFLECT( steem::chain::account_object,
-             (id)(name)(memo_key)(json_metadata)(proxy)(last_account_update)
+             (id)(name)(memo_key)(proxy)(last_account_update)
              (created)(mined)
              (recovery_account)(last_account_recovery)(reset_account)
              (comment_count)(lifetime_vote_count)(post_count)(can_vote)(voting_power)(last_vote_time)
@@ -421,6 +452,12 @@ FC_REFLECT( steem::chain::account_object,
           )
 
 CHAINBASE_SET_INDEX_TYPE( steem::chain::account_object, steem::chain::account_index )
+CHAINBASE_SET_HASHED_UNDO( steem::chain::account_object )
+CHAINBASE_SET_UNDO_BY_DELTA( steem::chain::account_object )
+
+FC_REFLECT( steem::chain::account_metadata_object,
+             (id)(account)(json_metadata) )
+CHAINBASE_SET_INDEX_TYPE( steem::chain::account_metadata_object, steem::chain::account_metadata_index )
 
 FC_REFLECT( steem::chain::account_authority_object,
              (id)(account)(owner)(active)(posting)(last_owner_update)
@@ -430,6 +467,7 @@ CHAINBASE_SET_INDEX_TYPE( steem::chain::account_authority_object, steem::chain::
 FC_REFLECT( steem::chain::vesting_delegation_object,
             (id)(delegator)(delegatee)(vesting_shares)(min_delegation_time) )
 CHAINBASE_SET_INDEX_TYPE( steem::chain::vesting_delegation_object, steem::chain::vesting_delegation_index )
+CHAINBASE_SET_UNDO_BY_DELTA( steem::chain::vesting_delegation_object )
 
 FC_REFLECT( steem::chain::vesting_delegation_expiration_object,
             (id)(delegator)(vesting_shares)(expiration) )
@@ -31,6 +31,17 @@ namespace steem { namespace chain {
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
     * linear scan of the main file.
+    *
+    * A block log can optionally be compressed. A compressed log starts with an 8 byte magic number and
+    * every block is stored as a zlib stream preceded by its packed and compressed sizes. The trailing
+    * positions and the index file are unchanged, so blocks remain randomly accessible by number and
+    * only the requested block is decompressed.
+    *
+    * +-------+------------+-------------+------------------+----------------+-----+
+    * | Magic | Block Size | Packed Size | Packed Block 1   | Pos of Block 1 | ... |
+    * +-------+------------+-------------+------------------+----------------+-----+
+    *
+    * The format of an existing log is detected when it is opened.
     */
 
    class block_log {
@@ -38,15 +49,27 @@ namespace steem { namespace chain {
          block_log();
          ~block_log();
 
-         void open( const fc::path& file );
+         /**
+          * Opens or creates the log. A new log is compressed if compress is true, an existing log
+          * keeps the format it was created with.
+          */
+         void open( const fc::path& file, bool compress = false );
          void close();
          bool is_open()const;
+         bool is_compressed()const;
 
          uint64_t append( const signed_block& b );
          void flush();
          std::pair< signed_block, uint64_t > read_block( uint64_t file_pos )const;
          optional< signed_block > read_block_by_num( uint32_t block_num )const;
 
+         /**
+          * Reads up to count consecutive blocks starting at first_block_num with a single sequential
+          * pass over the log. The result stops early at the head of the log and is empty if
+          * first_block_num is not in the log.
+          */
+         vector< signed_block > read_block_range( uint32_t first_block_num, uint32_t count )const;
+
          /**
           * Return offset of block in file, or block_log::npos if it does not exist.
           */
@@ -66,6 +89,7 @@ namespace steem { namespace chain {
          void construct_index();
 
          std::pair< signed_block, uint64_t > read_block_helper( uint64_t file_pos )const;
+         uint64_t next_block_pos( uint64_t file_pos )const;
          uint64_t get_block_pos_helper( uint32_t block_num ) const;
 
          std::unique_ptr<detail::block_log_impl> my;
@@ -12,6 +12,12 @@ struct block_notification
       block_num = block_header::num_from_id( block_id );
    }
 
+   block_notification( const steem::protocol::signed_block& b, const steem::protocol::block_id_type& id ) : block(b)
+   {
+      block_id = id;
+      block_num = block_header::num_from_id( block_id );
+   }
+
    steem::protocol::block_id_type          block_id;
    uint32_t                                block_num = 0;
    const steem::protocol::signed_block&    block;
@@ -0,0 +1,70 @@
+#pragma once
+#include <steem/chain/steem_object_types.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <string>
+
+namespace steem { namespace chain {
+
+   struct comment_content
+   {
+      std::string title;
+      std::string body;
+      std::string json_metadata;
+   };
+
+   /* The comment content store keeps the title, body and json_metadata of irreversible comments outside
+    * of the shared memory file. Consensus never reads them, so only the content of reversible comments
+    * has to stay in comment_content_index where it can be undone, see database::migrate_irreversible_content().
+    *
+    * Content is appended to a log and located through an index file holding the position of the latest
+    * content of every comment at 8 * comment id. A position of 0 marks a comment without content, the log
+    * starts with a magic number so no content is stored there. Edits append the whole content again,
+    * the previous content stays in the log.
+    *
+    * +-------+--------------+-------------------+--------------+-------------------+-----+
+    * | Magic | Content Size | Packed Content    | Content Size | Packed Content    | ... |
+    * +-------+--------------+-------------------+--------------+-------------------+-----+
+    *
+    * +------------------------+------------------------+-----+
+    * | Pos of Comment 0       | Pos of Comment 1       | ... |
+    * +------------------------+------------------------+-----+
+    *
+    * Writes happen under the database write lock. Content is written before its position is published
+    * in the index, so readers without a lock never see partial content.
+    */
+   class comment_content_store
+   {
+      public:
+         comment_content_store() = default;
+         ~comment_content_store();
+
+         comment_content_store( const comment_content_store& ) = delete;
+         comment_content_store& operator=( const comment_content_store& ) = delete;
+
+         /// Opens or creates the store in dir
+         void open( const fc::path& dir );
+         void close();
+         bool is_open()const { return _log_fd >= 0; }
+
+         void append( comment_id_type comment, const comment_content& content );
+         fc::optional< comment_content > read( comment_id_type comment )const;
+
+         /// Writes the store to disk
+         void flush();
+
+         static bool exists( const fc::path& dir );
+         static void remove( const fc::path& dir );
+
+      private:
+         int      _log_fd = -1;
+         int      _index_fd = -1;
+         uint64_t _log_size = 0;
+   };
+
+} } // steem::chain
+
+FC_REFLECT( steem::chain::comment_content, (title)(body)(json_metadata) )
@@ -6,6 +6,8 @@
 #include <steem/chain/steem_object_types.hpp>
 #include <steem/chain/witness_objects.hpp>
 
+#include <fc/crypto/city.hpp>
+
 #include <boost/multi_index/composite_key.hpp>
 
 
@@ -41,6 +43,37 @@ namespace steem { namespace chain {
          }
    };
 
+   /// The hash comments are keyed on in by_permlink, and the permlink table in by_hash
+   inline uint64_t permlink_hash( const string& permlink )
+   {
+      return fc::city_hash64( permlink.c_str(), permlink.size() );
+   }
+
+   /**
+    * A parent permlink or category string stored once and shared by every comment that refers to it.
+    * Comments hold the id of the string, so by_parent compares fixed width keys and the parent_permlink
+    * and category of a reply do not allocate another copy of the string.
+    * Strings are not removed when the comments referring to them are deleted. Only comments without
+    * replies can be deleted, so few strings are left unused, and no reply has to modify a reference count.
+    */
+   class comment_permlink_object : public object< comment_permlink_object_type, comment_permlink_object >
+   {
+      comment_permlink_object() = delete;
+
+      public:
+         template< typename Constructor, typename Allocator >
+         comment_permlink_object( Constructor&& c, allocator< Allocator > a )
+            :value( a )
+         {
+            c( *this );
+         }
+
+         id_type           id;
+
+         uint64_t          hash = 0;
+         shared_string     value;
+   };
+
    class comment_object : public object < comment_object_type, comment_object >
    {
       comment_object() = delete;
@@ -48,17 +81,18 @@ namespace steem { namespace chain {
       public:
          template< typename Constructor, typename Allocator >
          comment_object( Constructor&& c, allocator< Allocator > a )
-            :category( a ), parent_permlink( a ), permlink( a ), beneficiaries( a )
+            :permlink( a ), beneficiaries( a )
          {
             c( *this );
          }
 
          id_type           id;
 
-         shared_string     category;
+         comment_permlink_id_type category;
          account_name_type parent_author;
-         shared_string     parent_permlink;
+         comment_permlink_id_type parent_permlink;
          account_name_type author;
+         uint64_t          permlink_hash = 0; ///< permlink_hash() of permlink, keys by_permlink
          shared_string     permlink;
 
          time_point_sec    last_update;
@@ -103,6 +137,10 @@ namespace steem { namespace chain {
          t_beneficiaries   beneficiaries;
    };
 
+   /**
+    * With the comment content store enabled only the content written in reversible blocks is kept here,
+    * it is moved to the store once block_num becomes irreversible, see database::get_comment_content().
+    */
    class comment_content_object : public object< comment_content_object_type, comment_content_object >
    {
       comment_content_object() = delete;
@@ -118,12 +156,35 @@ namespace steem { namespace chain {
          id_type           id;
 
          comment_id_type   comment;
+         uint32_t          block_num = 0;    ///< Block that last wrote the content
 
          shared_string     title;
          shared_string     body;
          shared_string     json_metadata;
    };
 
+   /**
+    * Orders comments by their last update for the APIs. The orderings are kept out of comment_index
+    * because consensus never reads them, so a replay leaves this index empty and builds it from
+    * comment_index once all blocks are applied, see database::set_deferred_index_builder().
+    */
+   class comment_last_update_object : public object< comment_last_update_object_type, comment_last_update_object >
+   {
+      public:
+         template< typename Constructor, typename Allocator >
+         comment_last_update_object( Constructor&& c, allocator< Allocator > a )
+         {
+            c( *this );
+         }
+
+         id_type           id;
+
+         comment_id_type   comment;
+         account_name_type parent_author;
+         account_name_type author;
+         time_point_sec    last_update;
+   };
+
    /**
     * This index maintains the set of voter/comment pairs that have been used, voters cannot
     * vote on the same comment more than once per payout period.
@@ -172,11 +233,9 @@ namespace steem { namespace chain {
 
 
    struct by_cashout_time; /// cashout_time
-   struct by_permlink; /// author, perm
+   struct by_permlink; /// author, permlink hash, perm
    struct by_root;
    struct by_parent;
-   struct by_last_update; /// parent_auth, last_update
-   struct by_author_last_update;
 
    /**
     * @ingroup object_index
@@ -195,9 +254,10 @@ namespace steem { namespace chain {
          ordered_unique< tag< by_permlink >, /// used by consensus to find posts referenced in ops
             composite_key< comment_object,
                member< comment_object, account_name_type, &comment_object::author >,
+               member< comment_object, uint64_t, &comment_object::permlink_hash >,
                member< comment_object, shared_string, &comment_object::permlink >
             >,
-            composite_key_compare< std::less< account_name_type >, strcmp_less >
+            composite_key_compare< std::less< account_name_type >, std::less< uint64_t >, strcmp_less >
          >,
          ordered_unique< tag< by_root >,
             composite_key< comment_object,
@@ -208,42 +268,72 @@ namespace steem { namespace chain {
          ordered_unique< tag< by_parent >, /// used by consensus to find posts referenced in ops
             composite_key< comment_object,
                member< comment_object, account_name_type, &comment_object::parent_author >,
-               member< comment_object, shared_string, &comment_object::parent_permlink >,
+               member< comment_object, comment_permlink_id_type, &comment_object::parent_permlink >,
                member< comment_object, comment_id_type, &comment_object::id >
+            >
+         >
+      >,
+      allocator< comment_object >
+   > comment_index;
+
+   struct by_hash; /// hash, value
+
+   typedef multi_index_container<
+      comment_permlink_object,
+      indexed_by<
+         ordered_unique< tag< by_id >, member< comment_permlink_object, comment_permlink_id_type, &comment_permlink_object::id > >,
+         ordered_unique< tag< by_hash >,
+            composite_key< comment_permlink_object,
+               member< comment_permlink_object, uint64_t, &comment_permlink_object::hash >,
+               member< comment_permlink_object, shared_string, &comment_permlink_object::value >
             >,
-            composite_key_compare< std::less< account_name_type >, strcmp_less, std::less< comment_id_type > >
+            composite_key_compare< std::less< uint64_t >, strcmp_less >
          >
-         /// NON_CONSENSUS INDICIES - used by APIs
-#ifndef IS_LOW_MEM
-         ,
+      >,
+      allocator< comment_permlink_object >
+   > comment_permlink_index;
+
+   struct by_comment;
+   struct by_block; /// block_num, comment
+   struct by_last_update; /// parent_auth, last_update
+   struct by_author_last_update;
+
+   typedef multi_index_container<
+      comment_last_update_object,
+      indexed_by<
+         ordered_unique< tag< by_id >, member< comment_last_update_object, comment_last_update_id_type, &comment_last_update_object::id > >,
+         ordered_unique< tag< by_comment >, member< comment_last_update_object, comment_id_type, &comment_last_update_object::comment > >,
          ordered_unique< tag< by_last_update >,
-            composite_key< comment_object,
-               member< comment_object, account_name_type, &comment_object::parent_author >,
-               member< comment_object, time_point_sec, &comment_object::last_update >,
-               member< comment_object, comment_id_type, &comment_object::id >
+            composite_key< comment_last_update_object,
+               member< comment_last_update_object, account_name_type, &comment_last_update_object::parent_author >,
+               member< comment_last_update_object, time_point_sec, &comment_last_update_object::last_update >,
+               member< comment_last_update_object, comment_id_type, &comment_last_update_object::comment >
             >,
             composite_key_compare< std::less< account_name_type >, std::greater< time_point_sec >, std::less< comment_id_type > >
          >,
          ordered_unique< tag< by_author_last_update >,
-            composite_key< comment_object,
-               member< comment_object, account_name_type, &comment_object::author >,
-               member< comment_object, time_point_sec, &comment_object::last_update >,
-               member< comment_object, comment_id_type, &comment_object::id >
+            composite_key< comment_last_update_object,
+               member< comment_last_update_object, account_name_type, &comment_last_update_object::author >,
+               member< comment_last_update_object, time_point_sec, &comment_last_update_object::last_update >,
+               member< comment_last_update_object, comment_id_type, &comment_last_update_object::comment >
             >,
             composite_key_compare< std::less< account_name_type >, std::greater< time_point_sec >, std::less< comment_id_type > >
          >
-#endif
       >,
-      allocator< comment_object >
-   > comment_index;
-
-   struct by_comment;
+      allocator< comment_last_update_object >
+   > comment_last_update_index;
 
    typedef multi_index_container<
       comment_content_object,
       indexed_by<
          ordered_unique< tag< by_id >, member< comment_content_object, comment_content_id_type, &comment_content_object::id > >,
-         ordered_unique< tag< by_comment >, member< comment_content_object, comment_id_type, &comment_content_object::comment > >
+         ordered_unique< tag< by_comment >, member< comment_content_object, comment_id_type, &comment_content_object::comment > >,
+         ordered_unique< tag< by_block >,
+            composite_key< comment_content_object,
+               member< comment_content_object, uint32_t, &comment_content_object::block_num >,
+               member< comment_content_object, comment_id_type, &comment_content_object::comment >
+            >
+         >
       >,
       allocator< comment_content_object >
    > comment_content_index;
@@ -251,7 +341,7 @@ namespace steem { namespace chain {
 } } // steem::chain
 
 FC_REFLECT( steem::chain::comment_object,
-             (id)(author)(permlink)
+             (id)(author)(permlink_hash)(permlink)
              (category)(parent_author)(parent_permlink)
              (last_update)(created)(active)(last_payout)
              (depth)(children)
@@ -262,15 +352,27 @@ FC_REFLECT( steem::chain::comment_object,
              (beneficiaries)
           )
 CHAINBASE_SET_INDEX_TYPE( steem::chain::comment_object, steem::chain::comment_index )
+CHAINBASE_SET_HASHED_UNDO( steem::chain::comment_object )
+
+FC_REFLECT( steem::chain::comment_permlink_object,
+            (id)(hash)(value) )
+CHAINBASE_SET_INDEX_TYPE( steem::chain::comment_permlink_object, steem::chain::comment_permlink_index )
 
 FC_REFLECT( steem::chain::comment_content_object,
-            (id)(comment)(title)(body)(json_metadata) )
+            (id)(comment)(block_num)(title)(body)(json_metadata) )
 CHAINBASE_SET_INDEX_TYPE( steem::chain::comment_content_object, steem::chain::comment_content_index )
 
+FC_REFLECT( steem::chain::comment_last_update_object,
+            (id)(comment)(parent_author)(author)(last_update) )
+CHAINBASE_SET_INDEX_TYPE( steem::chain::comment_last_update_object, steem::chain::comment_last_update_index )
+CHAINBASE_SET_UNDO_BY_DELTA( steem::chain::comment_last_update_object )
+
 FC_REFLECT( steem::chain::comment_vote_object,
              (id)(voter)(comment)(weight)(rshares)(vote_percent)(last_update)(num_changes)
           )
 CHAINBASE_SET_INDEX_TYPE( steem::chain::comment_vote_object, steem::chain::comment_vote_index )
+CHAINBASE_SET_UNDO_BY_DELTA( steem::chain::comment_vote_object )
+CHAINBASE_SET_HASHED_UNDO( steem::chain::comment_vote_object )
 
 namespace helpers
 {
@@ -292,8 +394,6 @@ namespace helpers
          {
             for(const auto& o : index)
             {
-               info._item_additional_allocation += o.category.capacity()*sizeof(shared_string::value_type);
-               info._item_additional_allocation += o.parent_permlink.capacity()*sizeof(shared_string::value_type);
                info._item_additional_allocation += o.permlink.capacity()*sizeof(shared_string::value_type);
                info._item_additional_allocation += o.beneficiaries.capacity()*sizeof(t_beneficiaries::value_type);
             }
@@ -303,6 +403,27 @@ namespace helpers
       }
    };
 
+   template <>
+   class index_statistic_provider<steem::chain::comment_permlink_index>
+   {
+   public:
+      typedef steem::chain::comment_permlink_index IndexType;
+
+      index_statistic_info gather_statistics(const IndexType& index, bool onlyStaticInfo) const
+      {
+         index_statistic_info info;
+         gather_index_static_data(index, &info);
+
+         if(onlyStaticInfo == false)
+         {
+            for(const auto& o : index)
+               info._item_additional_allocation += o.value.capacity()*sizeof(shared_string::value_type);
+         }
+
+         return info;
+      }
+   };
+
    template <>
    class index_statistic_provider<steem::chain::comment_content_index>
    {
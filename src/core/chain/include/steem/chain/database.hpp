@@ -4,6 +4,7 @@
 #pragma once
 #include <steem/chain/block_log.hpp>
 #include <steem/chain/block_notification.hpp>
+#include <steem/chain/comment_content_store.hpp>
 #include <steem/chain/fork_database.hpp>
 #include <steem/chain/global_property_object.hpp>
 #include <steem/chain/hardfork_property_object.hpp>
@@ -24,6 +25,7 @@
 #include <fc/log/logger.hpp>
 
 #include <map>
+#include <unordered_set>
 
 namespace steem { namespace chain {
 
@@ -101,11 +103,17 @@ namespace steem { namespace chain {
             uint16_t shared_file_full_threshold = 0;
             uint16_t shared_file_scale_rate = 0;
             uint32_t chainbase_flags = 0;
+            chainbase::segment_options shared_file_options;
             bool do_validate_invariants = false;
             bool benchmark_is_enabled = false;
+            bool compress_block_log = false;       ///< Only applies when a new block log is created
+            fc::path load_snapshot;                ///< Loaded instead of the genesis state into an empty database
+            uint32_t snapshot_load_threads = 4;
+            bool comment_content_store = false;    ///< Keep the content of irreversible comments out of shared memory
 
             // The following fields are only used on reindexing
             uint32_t stop_replay_at = 0;
+            uint32_t replay_prefetch_depth = 1024;   ///< Blocks read ahead of the one being applied
             TBenchmark benchmark = TBenchmark(0, []( uint32_t, const abstract_index_cntr_t& ){});
          };
 
@@ -138,6 +146,43 @@ namespace steem { namespace chain {
          void wipe(const fc::path& data_dir, const fc::path& shared_mem_dir, bool include_blocks);
          void close(bool rewind = true);
 
+         /**
+          * @brief Write the state as of the head block to a portable snapshot, see state_snapshot.hpp
+          *
+          * Must be called while no undo session is active, i.e. after open() and before blocks are pushed,
+          * so that the snapshot matches the head block in the block log. Requires a read lock.
+          */
+         void export_snapshot( const fc::path& file )const;
+
+         /**
+          * @brief Rebuild the state into a fresh shared memory file, which drops the fragmentation of the old one
+          *
+          * Round-trips the state through a snapshot in the data directory, so the same restrictions as for
+          * export_snapshot() apply. The database is reopened with args when this function returns. The new
+          * file keeps at least the used size of the old one, grown by the shared file scale rate.
+          */
+         void compact( const open_args& args );
+
+         /**
+          * @brief Declare a non-consensus index that a replay builds once all blocks are applied
+          *
+          * While reindexing, is_index_deferred() is true for the index and the code maintaining it skips it.
+          * After the last block build is called to construct the index from the consensus state or from the
+          * primary index of a plugin. The deferred indices are built at the same time, each on its own thread
+          * under the write lock of the replay, so build may only write to the index it maintains.
+          */
+         template< typename MultiIndexType >
+         void set_deferred_index_builder( std::function< void() > build )
+         {
+            _deferred_index_builders[ MultiIndexType::value_type::type_id ] = build;
+         }
+
+         template< typename MultiIndexType >
+         bool is_index_deferred()const
+         {
+            return _deferring_indices && _deferred_index_builders.count( MultiIndexType::value_type::type_id );
+         }
+
          //////////////////// db_block.cpp ////////////////////
 
          /**
@@ -150,6 +195,12 @@ namespace steem { namespace chain {
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+
+         /**
+          *  Reads up to count irreversible blocks starting at first from the block log. Reversible blocks
+          *  are not returned. Only the block log is accessed, so no database lock is required.
+          */
+         vector<signed_block>       fetch_irreversible_block_range( uint32_t first, uint32_t count )const;
          const signed_transaction   get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
@@ -176,13 +227,20 @@ namespace steem { namespace chain {
          const account_object&  get_account(  const account_name_type& name )const;
          const account_object*  find_account( const account_name_type& name )const;
 
-         const comment_object&  get_comment(  const account_name_type& author, const shared_string& permlink )const;
-         const comment_object*  find_comment( const account_name_type& author, const shared_string& permlink )const;
+         const comment_object&  get_comment(  const account_name_type& author, comment_permlink_id_type permlink )const;
+         const comment_object*  find_comment( const account_name_type& author, comment_permlink_id_type permlink )const;
 
-#ifndef ENABLE_STD_ALLOCATOR
          const comment_object&  get_comment(  const account_name_type& author, const string& permlink )const;
          const comment_object*  find_comment( const account_name_type& author, const string& permlink )const;
-#endif
+
+         const comment_permlink_object* find_permlink( const string& permlink )const;
+         string                 get_permlink( comment_permlink_id_type permlink )const;
+
+         /// Returns the id of permlink in the permlink table, adding it if it is not there yet
+         comment_permlink_id_type intern_permlink( const string& permlink );
+
+         /// The title, body and json_metadata of a comment from comment_content_index or the comment content store
+         comment_content        get_comment_content( comment_id_type comment )const;
 
          const escrow_object&   get_escrow(  const account_name_type& name, uint32_t escrow_id )const;
          const escrow_object*   find_escrow( const account_name_type& name, uint32_t escrow_id )const;
@@ -406,11 +464,25 @@ namespace steem { namespace chain {
           */
          void validate_transaction( const signed_transaction& trx );
 
+         /**
+          *  Recovers the public keys of the transaction signatures into the signature key cache, so
+          *  that applying the transaction afterwards only has to walk the authorities. Does not touch
+          *  chain state and may be called from any thread without holding a database lock.
+          */
+         void precompute_signature_keys( const signed_transaction& trx )const;
+
+         /** @return the signature keys of trx, taken from the signature key cache when available */
+         flat_set< protocol::public_key_type > get_signature_keys( const signed_transaction& trx )const;
+
          /** when popping a block, the transactions that were removed get cached here so they
           * can be reapplied at the proper time */
          std::deque< signed_transaction >       _popped_tx;
          vector< signed_transaction >           _pending_tx;
 
+         /** ids of pending transactions whose operations passed validate(), they are not validated
+          * again when the pending transactions are reapplied after a block */
+         std::unordered_set< transaction_id_type > _validated_tx;
+
          bool apply_order( const limit_order_object& new_order_object );
          bool fill_order( const limit_order_object& order, const asset& pays, const asset& receives );
          void cancel_order( const limit_order_object& obj );
@@ -454,9 +526,13 @@ namespace steem { namespace chain {
          optional< chainbase::database::session > _pending_tx_session;
 
          void apply_block( const signed_block& next_block, uint32_t skip = skip_nothing );
-         void apply_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
-         void _apply_block( const signed_block& next_block );
+         /// trx_ids, when given, holds the ids of the transactions of next_block computed ahead of time
+         void apply_block( const signed_block& next_block, const block_id_type& next_block_id, uint32_t skip,
+            const vector< transaction_id_type >* trx_ids = nullptr );
+         void apply_transaction( const signed_transaction& trx, const transaction_id_type& trx_id, uint32_t skip = skip_nothing );
+         void _apply_block( const signed_block& next_block, const block_id_type& next_block_id, const vector< transaction_id_type >* trx_ids );
          void _apply_transaction( const signed_transaction& trx );
+         void _apply_transaction( const signed_transaction& trx, const transaction_id_type& trx_id );
          void apply_operation( const operation& op );
 
 
@@ -471,17 +547,27 @@ namespace steem { namespace chain {
          void update_global_dynamic_data( const signed_block& b );
          void update_signing_witness(const witness_object& signing_witness, const signed_block& new_block);
          void update_last_irreversible_block();
+         void migrate_irreversible_content();
          void clear_expired_transactions();
          void clear_expired_orders();
          void clear_expired_delegations();
          void process_header_extensions( const signed_block& next_block );
 
+         void initialize_maintenance_tasks();
+         void process_maintenance_tasks();
+
          void init_hardforks();
          void process_hardforks();
          void apply_hardfork( uint32_t hardfork );
 
          ///@}
 
+         /// Fills the empty indices from a snapshot written by export_snapshot(), reading up to threads indices at once
+         void load_snapshot( const fc::path& file, uint32_t threads );
+
+         /// Runs the builders registered with set_deferred_index_builder(), one thread each
+         void build_deferred_indices();
+
          void modify_balance( const account_object& a, const asset& delta, bool check_balance );
          void modify_reward_balance( const account_object& a, const asset& value_delta, const asset& share_delta, bool check_balance );
 
@@ -492,6 +578,7 @@ namespace steem { namespace chain {
          protocol::hardfork_version    _hardfork_versions[ STEEM_NUM_HARDFORKS + 1 ];
 
          block_log                     _block_log;
+         comment_content_store         _content_store;
 
          // this function needs access to _plugin_index_signal
          template< typename MultiIndexType >
@@ -520,6 +607,8 @@ namespace steem { namespace chain {
          uint16_t                      _shared_file_scale_rate = 0;
 
          flat_map< std::string, std::shared_ptr< custom_operation_interpreter > >   _custom_operation_interpreters;
+         flat_map< uint16_t, std::function< void() > >                              _deferred_index_builders;
+         bool                          _deferring_indices = false;
          std::string                   _json_schema;
 
          util::advanced_benchmark_dumper  _benchmark_dumper;
@@ -53,14 +53,35 @@ struct pending_transactions_restorer
 
    ~pending_transactions_restorer()
    {
+      // Operations are validated without looking at the state, so transactions that were validated
+      // when they entered the pending pool are not validated again. Ids of transactions that do not
+      // make it back into the pool are dropped.
+      auto validated_tx = std::move( _db._validated_tx );
+      _db._validated_tx.clear();
+      _db._validated_tx.reserve( validated_tx.size() );
+
+      auto reapply = [&]( const signed_transaction& tx )
+      {
+         // Expired transactions would fail in _apply_transaction, skip them without opening an undo session
+         if( tx.expiration <= _db.head_block_time() )
+            return;
+
+         auto id = tx.id();
+         if( _db.is_known_transaction( id ) )
+            return;
+
+         if( validated_tx.find( id ) != validated_tx.end() )
+            _db._validated_tx.insert( id );
+
+         // since push_transaction() takes a signed_transaction,
+         // the operation_results field will be ignored.
+         _db._push_transaction( tx );
+      };
+
       for( const auto& tx : _db._popped_tx )
       {
          try {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
-            }
+            reapply( tx );
          } catch ( const fc::exception&  ) {
          }
       }
@@ -69,11 +90,7 @@ struct pending_transactions_restorer
       {
          try
          {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
-            }
+            reapply( tx );
          }
          catch( const transaction_exception& e )
          {
@@ -145,3 +145,4 @@ FC_REFLECT( steem::chain::dynamic_global_property_object,
              (delegation_return_period)
           )
 CHAINBASE_SET_INDEX_TYPE( steem::chain::dynamic_global_property_object, steem::chain::dynamic_global_property_index )
+CHAINBASE_SET_UNDO_BY_DELTA( steem::chain::dynamic_global_property_object )
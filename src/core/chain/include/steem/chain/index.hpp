@@ -1,6 +1,7 @@
 #pragma once
 
 #include <steem/chain/database.hpp>
+#include <steem/chain/state_snapshot.hpp>
 
 namespace steem { namespace chain {
 
@@ -8,6 +9,7 @@ template< typename MultiIndexType >
 void _add_index_impl( database& db )
 {
    db.add_index< MultiIndexType >();
+   db.add_index_extension< MultiIndexType >( std::make_shared< snapshot_index_extension_impl< MultiIndexType > >( db ) );
 }
 
 template< typename MultiIndexType >
@@ -22,4 +24,12 @@ void add_plugin_index( database& db )
    db._plugin_index_signal.connect( [&db](){ _add_index_impl< MultiIndexType >(db); } );
 }
 
+/// Adds the index to a lock group whose readers do not take the database lock, see chainbase::database::set_lock_group()
+template< typename MultiIndexType >
+void add_plugin_index( database& db, const std::string& lock_group )
+{
+   db.set_lock_group< MultiIndexType >( lock_group );
+   add_plugin_index< MultiIndexType >( db );
+}
+
 } }
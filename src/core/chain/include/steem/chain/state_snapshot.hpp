@@ -0,0 +1,174 @@
+#pragma once
+#include <steem/protocol/types.hpp>
+
+#include <chainbase/chainbase.hpp>
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/interprocess/container.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace steem { namespace chain {
+
+   using steem::protocol::block_id_type;
+   using steem::protocol::chain_id_type;
+
+   /* A state snapshot holds the objects of every index as of a head block, serialized with fc::raw,
+    * so that a node can be started from it instead of replaying the block log. Unlike a copy of the
+    * shared memory file it does not depend on the boost version, compiler or allocator layout.
+    *
+    * +--------+----------------+---------+----------------+---------+-----+
+    * | Header | Index Header 1 | Objects | Index Header 2 | Objects | ... |
+    * +--------+----------------+---------+----------------+---------+-----+
+    *
+    * Every header and object is preceded by its packed size as a uint32. An index header holds the
+    * size and sha256 of the objects following it, so the indices can be located by skipping over
+    * them and loaded in parallel. The reflected member names of an object type are stored with its
+    * index and must match the loading build, a snapshot is rejected if an object layout changed.
+    */
+   struct snapshot_header
+   {
+      static constexpr uint64_t magic_number = 0x504e534d45455453; ///< "STEEMSNP"
+      static constexpr uint32_t current_version = 1;
+
+      uint64_t       magic = magic_number;
+      uint32_t       version = current_version;
+      chain_id_type  chain_id;
+      block_id_type  head_block_id;
+      uint32_t       index_count = 0;
+   };
+
+   struct snapshot_index_header
+   {
+      std::string    type_name;
+      std::string    fields;
+      int64_t        next_id = 0;
+      uint64_t       object_count = 0;
+      uint64_t       payload_size = 0;
+      fc::sha256     checksum;
+   };
+
+   /// Writes and reads the objects of one index, attached to every index by add_core_index() and add_plugin_index()
+   class snapshot_index_extension : public chainbase::index_extension
+   {
+      public:
+         virtual std::string type_name()const = 0;
+         virtual std::string fields()const = 0;
+
+         /// Writes the objects to out and returns their header. Requires a read lock.
+         virtual snapshot_index_header write_objects( std::ostream& out )const = 0;
+
+         /// Reads the objects of header from in into the empty index. Requires a write lock and no undo session.
+         virtual void read_objects( std::istream& in, const snapshot_index_header& header ) = 0;
+   };
+
+   namespace detail
+   {
+      struct snapshot_field_visitor
+      {
+         std::string& fields;
+
+         template< typename Member, class Class, Member (Class::*member) >
+         void operator()( const char* name )const
+         {
+            if( fields.size() )
+               fields += ',';
+            fields += name;
+         }
+      };
+   }
+
+   template< typename MultiIndexType >
+   class snapshot_index_extension_impl : public snapshot_index_extension
+   {
+      public:
+         typedef typename MultiIndexType::value_type value_type;
+
+         snapshot_index_extension_impl( chainbase::database& db ) : _db( db ) {}
+
+         virtual std::string type_name()const override
+         {
+            return fc::get_typename< value_type >::name();
+         }
+
+         virtual std::string fields()const override
+         {
+            std::string result;
+            fc::reflector< value_type >::visit( detail::snapshot_field_visitor{ result } );
+            return result;
+         }
+
+         virtual snapshot_index_header write_objects( std::ostream& out )const override
+         {
+            const auto& idx = _db.get_index< MultiIndexType >();
+
+            snapshot_index_header header;
+            header.type_name = type_name();
+            header.fields = fields();
+            header.next_id = idx.next_id()._id;
+
+            fc::sha256::encoder enc;
+            std::vector< char > data;
+
+            for( const auto& obj : idx.indices() )
+            {
+               data = fc::raw::pack_to_vector( obj );
+               uint32_t size = data.size();
+
+               enc.write( (const char*)&size, sizeof( size ) );
+               enc.write( data.data(), size );
+               out.write( (const char*)&size, sizeof( size ) );
+               out.write( data.data(), size );
+
+               ++header.object_count;
+               header.payload_size += sizeof( size ) + size;
+            }
+
+            FC_ASSERT( out.good(), "Error writing ${t} to the snapshot", ("t", header.type_name) );
+            header.checksum = enc.result();
+            return header;
+         }
+
+         virtual void read_objects( std::istream& in, const snapshot_index_header& header ) override
+         {
+            auto& idx = _db.get_mutable_index< MultiIndexType >();
+            FC_ASSERT( idx.indices().empty(), "Cannot load ${t} from a snapshot into a non-empty index", ("t", header.type_name) );
+            FC_ASSERT( header.fields == fields(), "The layout of ${t} does not match the snapshot",
+               ("t", header.type_name)("snapshot", header.fields)("expected", fields()) );
+
+            fc::sha256::encoder enc;
+            std::vector< char > data;
+
+            for( uint64_t i = 0; i < header.object_count; ++i )
+            {
+               uint32_t size = 0;
+               in.read( (char*)&size, sizeof( size ) );
+               FC_ASSERT( in.good() && size <= header.payload_size, "Truncated ${t} in the snapshot", ("t", header.type_name) );
+
+               data.resize( size );
+               in.read( data.data(), size );
+               FC_ASSERT( in.good(), "Truncated ${t} in the snapshot", ("t", header.type_name) );
+
+               enc.write( (const char*)&size, sizeof( size ) );
+               enc.write( data.data(), size );
+
+               fc::datastream< const char* > ds( data.data(), data.size() );
+               idx.restore( [&]( value_type& v ) { fc::raw::unpack( ds, v ); } );
+            }
+
+            FC_ASSERT( enc.result() == header.checksum, "Checksum mismatch in ${t} of the snapshot", ("t", header.type_name) );
+            idx.set_next_id( header.next_id );
+         }
+
+      private:
+         chainbase::database& _db;
+   };
+
+} } // steem::chain
+
+FC_REFLECT( steem::chain::snapshot_header, (magic)(version)(chain_id)(head_block_id)(index_count) )
+FC_REFLECT( steem::chain::snapshot_index_header, (type_name)(fields)(next_id)(object_count)(payload_size)(checksum) )
@@ -64,7 +64,10 @@ enum object_type
    block_stats_object_type,
    reward_fund_object_type,
    vesting_delegation_object_type,
-   vesting_delegation_expiration_object_type
+   vesting_delegation_expiration_object_type,
+   comment_last_update_object_type,
+   account_metadata_object_type,
+   comment_permlink_object_type
 };
 
 class dynamic_global_property_object;
@@ -95,6 +98,9 @@ class block_stats_object;
 class reward_fund_object;
 class vesting_delegation_object;
 class vesting_delegation_expiration_object;
+class comment_last_update_object;
+class account_metadata_object;
+class comment_permlink_object;
 
 typedef oid< dynamic_global_property_object         > dynamic_global_property_id_type;
 typedef oid< account_object                         > account_id_type;
@@ -124,6 +130,9 @@ typedef oid< block_stats_object                     > block_stats_id_type;
 typedef oid< reward_fund_object                     > reward_fund_id_type;
 typedef oid< vesting_delegation_object              > vesting_delegation_id_type;
 typedef oid< vesting_delegation_expiration_object   > vesting_delegation_expiration_id_type;
+typedef oid< comment_last_update_object             > comment_last_update_id_type;
+typedef oid< account_metadata_object                > account_metadata_id_type;
+typedef oid< comment_permlink_object                > comment_permlink_id_type;
 
 enum bandwidth_type
 {
@@ -185,6 +194,24 @@ namespace fc
    }
 }
 
+namespace chainbase
+{
+   // fc::raw packs the ids inside reflected objects with these, the overloads above are declared after fc::raw is defined
+   template< typename S, typename T >
+   inline fc::datastream< S >& operator<<( fc::datastream< S >& ds, const oid< T >& id )
+   {
+      ds.write( (const char*)&id._id, sizeof( id._id ) );
+      return ds;
+   }
+
+   template< typename S, typename T >
+   inline fc::datastream< S >& operator>>( fc::datastream< S >& ds, oid< T >& id )
+   {
+      ds.read( (char*)&id._id, sizeof( id._id ) );
+      return ds;
+   }
+}
+
 FC_REFLECT_ENUM( steem::chain::object_type,
                  (dynamic_global_property_object_type)
                  (account_object_type)
@@ -214,6 +241,9 @@ FC_REFLECT_ENUM( steem::chain::object_type,
                  (reward_fund_object_type)
                  (vesting_delegation_object_type)
                  (vesting_delegation_expiration_object_type)
+                 (comment_last_update_object_type)
+                 (account_metadata_object_type)
+                 (comment_permlink_object_type)
                )
 
 #ifndef ENABLE_STD_ALLOCATOR
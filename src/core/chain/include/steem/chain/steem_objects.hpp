@@ -392,6 +392,7 @@ namespace steem { namespace chain {
 FC_REFLECT( steem::chain::limit_order_object,
              (id)(created)(expiration)(seller)(orderid)(for_sale)(sell_price) )
 CHAINBASE_SET_INDEX_TYPE( steem::chain::limit_order_object, steem::chain::limit_order_index )
+CHAINBASE_SET_UNDO_BY_DELTA( steem::chain::limit_order_object )
 
 FC_REFLECT( steem::chain::feed_history_object,
              (id)(current_median_history)(price_history) )
@@ -400,6 +401,7 @@ CHAINBASE_SET_INDEX_TYPE( steem::chain::feed_history_object, steem::chain::feed_
 FC_REFLECT( steem::chain::convert_request_object,
              (id)(owner)(requestid)(amount)(conversion_date) )
 CHAINBASE_SET_INDEX_TYPE( steem::chain::convert_request_object, steem::chain::convert_request_index )
+CHAINBASE_SET_UNDO_BY_DELTA( steem::chain::convert_request_object )
 
 FC_REFLECT( steem::chain::withdraw_vesting_route_object,
              (id)(from_account)(to_account)(percent)(auto_vest) )
@@ -433,3 +435,4 @@ FC_REFLECT( steem::chain::reward_fund_object,
             (curation_reward_curve)
          )
 CHAINBASE_SET_INDEX_TYPE( steem::chain::reward_fund_object, steem::chain::reward_fund_index )
+CHAINBASE_SET_UNDO_BY_DELTA( steem::chain::reward_fund_object )
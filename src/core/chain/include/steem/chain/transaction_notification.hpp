@@ -11,6 +11,9 @@ struct transaction_notification
       transaction_id = tx.id();
    }
 
+   transaction_notification( const steem::protocol::signed_transaction& tx, const steem::protocol::transaction_id_type& id )
+      : transaction_id(id), transaction(tx) {}
+
    steem::protocol::transaction_id_type          transaction_id;
    const steem::protocol::signed_transaction&    transaction;
 };
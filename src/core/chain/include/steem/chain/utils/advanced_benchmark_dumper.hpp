@@ -9,6 +9,7 @@
 #include <sys/time.h>
 
 #include <utility>
+#include <vector>
 
 namespace steem { namespace chain { namespace util {
 
@@ -72,7 +73,8 @@ class advanced_benchmark_dumper
       uint32_t flush_cnt = 0;
       uint32_t flush_max = 500000;
 
-      uint64_t time_begin = 0;
+      /// Start times of the open measurements, the innermost last
+      std::vector< uint64_t > time_begin;
 
       std::string file_name;
 
@@ -100,9 +102,47 @@ class advanced_benchmark_dumper
       void set_enabled( bool val ) { enabled = val; }
       bool is_enabled() { return enabled; }
 
+      /**
+       * Measurements nest: the time of a measurement includes the measurements begun inside it, such as
+       * plugin handlers of virtual operations pushed during a maintenance task. The total only counts the
+       * outermost ones, so nested time is not counted twice.
+       */
       void begin();
       template< bool APPLY_CONTEXT = false >
       void end( const std::string& str );
+      /// Drops the innermost open measurement without recording it
+      void cancel();
+
+      /**
+       * Begins a measurement if the dumper is enabled and cancels it on destruction unless end() was called,
+       * so that a measured call that throws does not leave its measurement open.
+       */
+      class scope
+      {
+         public:
+            explicit scope( advanced_benchmark_dumper& dumper ) : _dumper( dumper.is_enabled() ? &dumper : nullptr )
+            {
+               if( _dumper )
+                  _dumper->begin();
+            }
+
+            ~scope()
+            {
+               if( _dumper )
+                  _dumper->cancel();
+            }
+
+            template< bool APPLY_CONTEXT = false >
+            void end( const std::string& str )
+            {
+               if( _dumper )
+                  _dumper->end< APPLY_CONTEXT >( str );
+               _dumper = nullptr;
+            }
+
+         private:
+            advanced_benchmark_dumper* _dumper;
+      };
 
       void dump();
 };
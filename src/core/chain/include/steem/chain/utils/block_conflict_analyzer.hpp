@@ -0,0 +1,42 @@
+#pragma once
+
+#include <steem/protocol/block.hpp>
+
+#include <fc/reflect/reflect.hpp>
+
+#include <vector>
+
+namespace steem { namespace chain { namespace util {
+
+/**
+ * Partition of the transactions of a block into groups that touch disjoint state. Transactions of
+ * different groups could be applied in any order, transactions of one group have to be applied in
+ * block order.
+ */
+struct block_conflict_analysis
+{
+   /// Group of every transaction, groups are numbered in the order of their first transaction
+   std::vector< uint32_t > transaction_groups;
+   uint32_t                group_count = 0;
+   /// Number of transactions in the largest group, the lower bound of serial work for the block
+   uint32_t                largest_group = 0;
+   /// Number of transactions writing global objects such as the dynamic global properties
+   uint32_t                global_transactions = 0;
+};
+
+/**
+ * Computes the conflict groups of the transactions of block without looking at the state.
+ *
+ * Transactions conflict when they share an impacted account (see operation_get_impacted_accounts),
+ * which covers the comments, votes and other objects owned by those accounts, or when they write the
+ * same global object: the dynamic global properties, the order book or the witness vote tallies.
+ * Operations creating vesting also count as writing the witness vote tallies, since the new vests
+ * are added to the votes of the account's proxy chain.
+ * State only known while applying, such as the root of a reply or the witnesses of a proxy, and
+ * plugin state written by custom operations are not considered.
+ */
+block_conflict_analysis analyze_block_conflicts( const protocol::signed_block& block );
+
+} } } // steem::chain::util
+
+FC_REFLECT( steem::chain::util::block_conflict_analysis, (transaction_groups)(group_count)(largest_group)(global_transactions) )
@@ -269,6 +269,7 @@ CHAINBASE_SET_INDEX_TYPE( steem::chain::witness_object, steem::chain::witness_in
 
 FC_REFLECT( steem::chain::witness_vote_object, (id)(witness)(account) )
 CHAINBASE_SET_INDEX_TYPE( steem::chain::witness_vote_object, steem::chain::witness_vote_index )
+CHAINBASE_SET_UNDO_BY_DELTA( steem::chain::witness_vote_object )
 
 FC_REFLECT( steem::chain::witness_schedule_object,
              (id)(current_virtual_time)(next_shuffle_block_num)(current_shuffled_witnesses)(num_scheduled_witnesses)
@@ -0,0 +1,194 @@
+#include <steem/chain/database.hpp>
+#include <steem/chain/global_property_object.hpp>
+#include <steem/chain/state_snapshot.hpp>
+
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace steem { namespace chain {
+
+namespace detail {
+
+   template< typename T >
+   void write_packed( std::ostream& out, const T& value )
+   {
+      auto data = fc::raw::pack_to_vector( value );
+      uint32_t size = data.size();
+      out.write( (const char*)&size, sizeof( size ) );
+      out.write( data.data(), size );
+   }
+
+   template< typename T >
+   void read_packed( std::istream& in, T& value )
+   {
+      uint32_t size = 0;
+      in.read( (char*)&size, sizeof( size ) );
+      FC_ASSERT( in.good() && size < MAX_ARRAY_ALLOC_SIZE, "Truncated snapshot header" );
+
+      std::vector< char > data( size );
+      in.read( data.data(), size );
+      FC_ASSERT( in.good(), "Truncated snapshot header" );
+
+      fc::datastream< const char* > ds( data.data(), data.size() );
+      fc::raw::unpack( ds, value );
+   }
+
+   std::map< std::string, snapshot_index_extension* > get_snapshot_extensions( const chainbase::database& db )
+   {
+      std::map< std::string, snapshot_index_extension* > result;
+
+      for( const auto* idx : db.get_abstract_index_cntr() )
+      {
+         for( const auto& ext : idx->get_index_extensions() )
+         {
+            auto snapshot_ext = std::dynamic_pointer_cast< snapshot_index_extension >( ext );
+            if( snapshot_ext )
+               result[ snapshot_ext->type_name() ] = snapshot_ext.get();
+         }
+      }
+
+      return result;
+   }
+
+   struct snapshot_section
+   {
+      snapshot_index_extension*  extension = nullptr;
+      snapshot_index_header      header;
+      std::streamoff             payload_pos = 0;
+   };
+
+} // detail
+
+void database::export_snapshot( const fc::path& file )const
+{ try {
+   auto start = fc::time_point::now();
+   auto extensions = detail::get_snapshot_extensions( *this );
+   auto temp_file = file.generic_string() + ".tmp";
+
+   std::ofstream out( temp_file, std::ios::out | std::ios::binary | std::ios::trunc );
+   FC_ASSERT( out.good(), "Could not create ${f}", ("f", temp_file) );
+
+   snapshot_header header;
+   header.chain_id = get_chain_id();
+   header.head_block_id = head_block_id();
+   header.index_count = extensions.size();
+   detail::write_packed( out, header );
+
+   for( const auto& item : extensions )
+   {
+      // The header is written again once the size and checksum of the objects are known, it keeps its size
+      snapshot_index_header index_header;
+      index_header.type_name = item.second->type_name();
+      index_header.fields = item.second->fields();
+
+      auto header_pos = out.tellp();
+      detail::write_packed( out, index_header );
+
+      index_header = item.second->write_objects( out );
+      auto end_pos = out.tellp();
+
+      out.seekp( header_pos );
+      detail::write_packed( out, index_header );
+      out.seekp( end_pos );
+
+      ilog( "Exported ${n} objects of ${t}", ("n", index_header.object_count)("t", index_header.type_name) );
+   }
+
+   out.close();
+   FC_ASSERT( !out.fail(), "Error writing ${f}", ("f", temp_file) );
+   fc::rename( temp_file, file );
+
+   ilog( "Exported state at block ${b} in ${t} sec", ("b", head_block_num())("t", double( ( fc::time_point::now() - start ).count() ) / 1000000.0) );
+} FC_CAPTURE_AND_RETHROW( (file) ) }
+
+void database::load_snapshot( const fc::path& file, uint32_t threads )
+{ try {
+   auto start = fc::time_point::now();
+   auto extensions = detail::get_snapshot_extensions( *this );
+
+   std::ifstream in( file.generic_string(), std::ios::in | std::ios::binary );
+   FC_ASSERT( in.good(), "Could not open ${f}", ("f", file) );
+
+   snapshot_header header;
+   detail::read_packed( in, header );
+   FC_ASSERT( header.magic == snapshot_header::magic_number, "${f} is not a state snapshot", ("f", file) );
+   FC_ASSERT( header.version == snapshot_header::current_version, "Unsupported snapshot version ${v}", ("v", header.version) );
+   FC_ASSERT( header.chain_id == get_chain_id(), "The snapshot belongs to a different chain", ("chain_id", header.chain_id) );
+
+   // Locate every index first so that each can be read by its own stream
+   std::vector< detail::snapshot_section > sections;
+   for( uint32_t i = 0; i < header.index_count; ++i )
+   {
+      detail::snapshot_section section;
+      detail::read_packed( in, section.header );
+      section.payload_pos = in.tellg();
+      in.seekg( section.header.payload_size, std::ios::cur );
+
+      auto itr = extensions.find( section.header.type_name );
+      if( itr == extensions.end() )
+      {
+         wlog( "Skipping ${t} in the snapshot, its plugin is not enabled", ("t", section.header.type_name) );
+         continue;
+      }
+
+      section.extension = itr->second;
+      extensions.erase( itr );
+      sections.push_back( std::move( section ) );
+   }
+
+   FC_ASSERT( in.good(), "Truncated snapshot ${f}", ("f", file) );
+
+   for( const auto& item : extensions )
+      wlog( "The snapshot does not contain ${t}, the index is left empty", ("t", item.first) );
+
+   std::atomic< size_t > next_section( 0 );
+   std::exception_ptr    error;
+   std::mutex            error_mutex;
+
+   auto load_sections = [&]()
+   {
+      try
+      {
+         std::ifstream section_in( file.generic_string(), std::ios::in | std::ios::binary );
+         FC_ASSERT( section_in.good(), "Could not open ${f}", ("f", file) );
+
+         for( size_t i = next_section++; i < sections.size(); i = next_section++ )
+         {
+            section_in.seekg( sections[i].payload_pos );
+            sections[i].extension->read_objects( section_in, sections[i].header );
+            ilog( "Loaded ${n} objects of ${t}", ("n", sections[i].header.object_count)("t", sections[i].header.type_name) );
+         }
+      }
+      catch( ... )
+      {
+         std::lock_guard< std::mutex > guard( error_mutex );
+         if( !error )
+            error = std::current_exception();
+         next_section = sections.size();
+      }
+   };
+
+   std::vector< std::thread > workers;
+   for( uint32_t i = 1; i < std::min< size_t >( threads, sections.size() ); ++i )
+      workers.emplace_back( load_sections );
+
+   load_sections();
+
+   for( auto& worker : workers )
+      worker.join();
+
+   if( error )
+      std::rethrow_exception( error );
+
+   FC_ASSERT( find< dynamic_global_property_object >() && head_block_id() == header.head_block_id,
+      "The snapshot does not contain the state of its head block" );
+   set_revision( head_block_num() );
+
+   ilog( "Loaded state at block ${b} in ${t} sec", ("b", head_block_num())("t", double( ( fc::time_point::now() - start ).count() ) / 1000000.0) );
+} FC_CAPTURE_AND_RETHROW( (file)(threads) ) }
+
+} } // steem::chain
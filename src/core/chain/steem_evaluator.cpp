@@ -285,11 +285,16 @@ void account_create_evaluator::do_apply( const account_create_operation& o )
    const auto& new_account = _db.create< account_object >( [&]( account_object& acc )
    {
       initialize_account_object( acc, o.new_account_name, o.memo_key, props, false /*mined*/, o.creator, _db.get_hardfork() );
-      #ifndef IS_LOW_MEM
-         from_string( acc.json_metadata, o.json_metadata );
-      #endif
    });
 
+   #ifndef IS_LOW_MEM
+      _db.create< account_metadata_object >( [&]( account_metadata_object& meta )
+      {
+         meta.account = new_account.id;
+         from_string( meta.json_metadata, o.json_metadata );
+      });
+   #endif
+
    _db.create< account_authority_object >( [&]( account_authority_object& auth )
    {
       auth.account = o.new_account_name;
@@ -365,12 +370,16 @@ void account_create_with_delegation_evaluator::do_apply( const account_create_wi
    {
       initialize_account_object( acc, o.new_account_name, o.memo_key, props, false /*mined*/, o.creator, _db.get_hardfork() );
       acc.received_vesting_shares = o.delegation;
-
-      #ifndef IS_LOW_MEM
-         from_string( acc.json_metadata, o.json_metadata );
-      #endif
    });
 
+   #ifndef IS_LOW_MEM
+      _db.create< account_metadata_object >( [&]( account_metadata_object& meta )
+      {
+         meta.account = new_account.id;
+         from_string( meta.json_metadata, o.json_metadata );
+      });
+   #endif
+
    _db.create< account_authority_object >( [&]( account_authority_object& auth )
    {
       auth.account = o.new_account_name;
@@ -434,13 +443,31 @@ void account_update_evaluator::do_apply( const account_update_operation& o )
             acc.memo_key = o.memo_key;
 
       acc.last_account_update = _db.head_block_time();
-
-      #ifndef IS_LOW_MEM
-        if ( o.json_metadata.size() > 0 )
-            from_string( acc.json_metadata, o.json_metadata );
-      #endif
    });
 
+   #ifndef IS_LOW_MEM
+      if( o.json_metadata.size() > 0 )
+      {
+         auto meta = _db.find< account_metadata_object, by_account >( account.id );
+
+         if( meta == nullptr )
+         {
+            _db.create< account_metadata_object >( [&]( account_metadata_object& m )
+            {
+               m.account = account.id;
+               from_string( m.json_metadata, o.json_metadata );
+            });
+         }
+         else
+         {
+            _db.modify( *meta, [&]( account_metadata_object& m )
+            {
+               from_string( m.json_metadata, o.json_metadata );
+            });
+         }
+      }
+   #endif
+
    if( o.active || o.posting )
    {
       _db.modify( account_auth, [&]( account_authority_object& auth)
@@ -496,6 +523,15 @@ void delete_comment_evaluator::do_apply( const delete_comment_operation& o )
       }
    }
 
+#ifndef IS_LOW_MEM
+   if( !_db.is_index_deferred< comment_last_update_index >() )
+   {
+      const auto* last_update = _db.find< comment_last_update_object, by_comment >( comment.id );
+      if( last_update != nullptr )
+         _db.remove( *last_update );
+   }
+#endif
+
    _db.remove( comment );
 }
 
@@ -560,8 +596,7 @@ void comment_evaluator::do_apply( const comment_operation& o )
 { try {
    FC_ASSERT( o.title.size() + o.body.size() + o.json_metadata.size(), "Cannot update comment because nothing appears to be changing." );
 
-   const auto& by_permlink_idx = _db.get_index< comment_index >().indices().get< by_permlink >();
-   auto itr = by_permlink_idx.find( boost::make_tuple( o.author, o.permlink ) );
+   auto itr = _db.find_comment( o.author, o.permlink );
 
    const auto& auth = _db.get_account( o.author ); /// prove it exists
 
@@ -578,7 +613,7 @@ void comment_evaluator::do_apply( const comment_operation& o )
 
    auto now = _db.head_block_time();
 
-   if ( itr == by_permlink_idx.end() )
+   if ( itr == nullptr )
    {
       if( o.parent_author != STEEM_ROOT_POST_PARENT )
       {
@@ -603,13 +638,17 @@ void comment_evaluator::do_apply( const comment_operation& o )
          a.post_count++;
       });
 
+      validate_permlink_0_1( o.parent_permlink );
+      validate_permlink_0_1( o.permlink );
+
+      auto parent_permlink = _db.intern_permlink( o.parent_permlink );
+
       const auto& new_comment = _db.create< comment_object >( [&]( comment_object& com )
       {
-         validate_permlink_0_1( o.parent_permlink );
-         validate_permlink_0_1( o.permlink );
-
          com.author = o.author;
+         com.permlink_hash = permlink_hash( o.permlink );
          from_string( com.permlink, o.permlink );
+         com.parent_permlink = parent_permlink;
          com.last_update = _db.head_block_time();
          com.created = com.last_update;
          com.active = com.last_update;
@@ -620,14 +659,12 @@ void comment_evaluator::do_apply( const comment_operation& o )
          if ( o.parent_author == STEEM_ROOT_POST_PARENT )
          {
             com.parent_author = "";
-            from_string( com.parent_permlink, o.parent_permlink );
-            from_string( com.category, o.parent_permlink );
+            com.category = parent_permlink;
             com.root_comment = com.id;
          }
          else
          {
             com.parent_author = parent->author;
-            com.parent_permlink = parent->permlink;
             com.depth = parent->depth + 1;
             com.category = parent->category;
             com.root_comment = parent->root_comment;
@@ -639,9 +676,21 @@ void comment_evaluator::do_apply( const comment_operation& o )
       id = new_comment.id;
 
    #ifndef IS_LOW_MEM
+      if( !_db.is_index_deferred< comment_last_update_index >() )
+      {
+         _db.create< comment_last_update_object >( [&]( comment_last_update_object& clu )
+         {
+            clu.comment = id;
+            clu.parent_author = new_comment.parent_author;
+            clu.author = new_comment.author;
+            clu.last_update = new_comment.last_update;
+         });
+      }
+
       _db.create< comment_content_object >( [&]( comment_content_object& con )
       {
          con.comment = id;
+         con.block_num = _db.head_block_num() + 1;
 
          from_string( con.title, o.title );
          if( o.body.size() < 1024*1024*128 )
@@ -672,6 +721,7 @@ void comment_evaluator::do_apply( const comment_operation& o )
    else // start edit case
    {
       const auto& comment = *itr;
+      const auto& parent_permlink = _db.get( comment.parent_permlink ).value;
 
       _db.modify( comment, [&]( comment_object& com )
       {
@@ -682,17 +732,42 @@ void comment_evaluator::do_apply( const comment_operation& o )
          if( !parent )
          {
             FC_ASSERT( com.parent_author == account_name_type(), "The parent of a comment cannot change." );
-            FC_ASSERT( equal( com.parent_permlink, o.parent_permlink ), "The permlink of a comment cannot change." );
+            FC_ASSERT( equal( parent_permlink, o.parent_permlink ), "The permlink of a comment cannot change." );
          }
          else
          {
             FC_ASSERT( com.parent_author == o.parent_author, "The parent of a comment cannot change." );
-            FC_ASSERT( equal( com.parent_permlink, o.parent_permlink ), "The permlink of a comment cannot change." );
+            FC_ASSERT( equal( parent_permlink, o.parent_permlink ), "The permlink of a comment cannot change." );
          }
       });
    #ifndef IS_LOW_MEM
-      _db.modify( _db.get< comment_content_object, by_comment >( comment.id ), [&]( comment_content_object& con )
+      const auto* last_update = _db.is_index_deferred< comment_last_update_index >() ? nullptr :
+         _db.find< comment_last_update_object, by_comment >( comment.id );
+      if( last_update != nullptr )
+      {
+         _db.modify( *last_update, [&]( comment_last_update_object& clu )
+         {
+            clu.last_update = comment.last_update;
+         });
+      }
+
+      const auto* content = _db.find< comment_content_object, by_comment >( comment.id );
+      if( content == nullptr )
+      {
+         // The content moved to the comment content store, edits are made in the state until they are irreversible
+         auto stored = _db.get_comment_content( comment.id );
+         content = &_db.create< comment_content_object >( [&]( comment_content_object& con )
+         {
+            con.comment = comment.id;
+            from_string( con.title, stored.title );
+            from_string( con.body, stored.body );
+            from_string( con.json_metadata, stored.json_metadata );
+         });
+      }
+
+      _db.modify( *content, [&]( comment_content_object& con )
       {
+         con.block_num = _db.head_block_num() + 1;
          if( o.title.size() )         from_string( con.title, o.title );
          if( o.json_metadata.size() )
             from_string( con.json_metadata, o.json_metadata );
@@ -1592,14 +1667,19 @@ void create_claimed_account_evaluator::do_apply( const create_claimed_account_op
       a.pending_claimed_accounts--;
    });
 
-   _db.create< account_object >( [&]( account_object& acc )
+   const auto& new_account = _db.create< account_object >( [&]( account_object& acc )
    {
       initialize_account_object( acc, o.new_account_name, o.memo_key, props, false /*mined*/, o.creator, _db.get_hardfork() );
-      #ifndef IS_LOW_MEM
-         from_string( acc.json_metadata, o.json_metadata );
-      #endif
    });
 
+   #ifndef IS_LOW_MEM
+      _db.create< account_metadata_object >( [&]( account_metadata_object& meta )
+      {
+         meta.account = new_account.id;
+         from_string( meta.json_metadata, o.json_metadata );
+      });
+   #endif
+
    _db.create< account_authority_object >( [&]( account_authority_object& auth )
    {
       auth.account = o.new_account_name;
@@ -25,20 +25,32 @@ namespace steem { namespace chain { namespace util {
 
    void advanced_benchmark_dumper::begin()
    {
-      time_begin = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::system_clock::now().time_since_epoch() ).count();
+      time_begin.push_back( std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::system_clock::now().time_since_epoch() ).count() );
+   }
+
+   void advanced_benchmark_dumper::cancel()
+   {
+      if( !time_begin.empty() )
+         time_begin.pop_back();
    }
 
    template< bool APPLY_CONTEXT >
    void advanced_benchmark_dumper::end( const std::string& str )
    {
+      if( time_begin.empty() )
+         return;
+
       uint64_t time = std::chrono::duration_cast<std::chrono::milliseconds>(
-         std::chrono::system_clock::now().time_since_epoch() ).count() - time_begin;
+         std::chrono::system_clock::now().time_since_epoch() ).count() - time_begin.back();
+      time_begin.pop_back();
+
       auto res = info.emplace( APPLY_CONTEXT ? (apply_context_name + str) : str, time );
 
       if( !res.second )
          res.first->inc( time );
 
-      info.inc( time );
+      if( time_begin.empty() )
+         info.inc( time );
 
       ++flush_cnt;
       if( flush_cnt >= flush_max )
@@ -0,0 +1,147 @@
+#include <steem/chain/utils/block_conflict_analyzer.hpp>
+#include <steem/chain/utils/impacted.hpp>
+
+#include <map>
+#include <string>
+
+namespace steem { namespace chain { namespace util {
+
+using namespace steem::protocol;
+
+namespace detail
+{
+   /// Global objects written by an operation, in addition to the objects of its impacted accounts
+   struct get_global_resources_visitor
+   {
+      typedef void result_type;
+
+      std::vector< std::string >& _resources;
+
+      get_global_resources_visitor( std::vector< std::string >& resources ) : _resources( resources ) {}
+
+      template< typename T >
+      void operator()( const T& )const {}
+
+      // Create vesting, which changes the supply and, through adjust_proxied_witness_votes, the tallies of
+      // the witnesses voted for by the account or its proxy chain, which are not impacted accounts
+      void operator()( const account_create_operation& )const { add_vesting_resources(); }
+      void operator()( const account_create_with_delegation_operation& )const { add_vesting_resources(); }
+      void operator()( const transfer_to_vesting_operation& )const { add_vesting_resources(); }
+      void operator()( const claim_reward_balance_operation& )const { add_vesting_resources(); }
+
+      // Change the supply
+      void operator()( const claim_account_operation& )const { _resources.push_back( "dynamic_global_properties" ); }
+
+      // Match against orders of any account
+      void operator()( const limit_order_create_operation& )const { _resources.push_back( "order_book" ); }
+      void operator()( const limit_order_create2_operation& )const { _resources.push_back( "order_book" ); }
+      void operator()( const limit_order_cancel_operation& )const { _resources.push_back( "order_book" ); }
+
+      // Adjust the votes of witnesses through proxies
+      void operator()( const account_witness_vote_operation& )const { _resources.push_back( "witness_votes" ); }
+      void operator()( const account_witness_proxy_operation& )const { _resources.push_back( "witness_votes" ); }
+
+      void add_vesting_resources()const
+      {
+         _resources.push_back( "dynamic_global_properties" );
+         _resources.push_back( "witness_votes" );
+      }
+   };
+
+   class disjoint_sets
+   {
+      public:
+         disjoint_sets( size_t size ) : _parent( size )
+         {
+            for( size_t i = 0; i < size; ++i )
+               _parent[i] = i;
+         }
+
+         uint32_t find( uint32_t i )
+         {
+            while( _parent[i] != i )
+            {
+               _parent[i] = _parent[ _parent[i] ];
+               i = _parent[i];
+            }
+
+            return i;
+         }
+
+         /// Keeps the smaller root so the root of a set is its first transaction
+         void join( uint32_t a, uint32_t b )
+         {
+            a = find( a );
+            b = find( b );
+            if( a < b )
+               _parent[b] = a;
+            else if( b < a )
+               _parent[a] = b;
+         }
+
+      private:
+         std::vector< uint32_t > _parent;
+   };
+}
+
+block_conflict_analysis analyze_block_conflicts( const signed_block& block )
+{
+   block_conflict_analysis result;
+   const auto trx_count = block.transactions.size();
+
+   detail::disjoint_sets sets( trx_count );
+   // First transaction touching each resource, accounts are prefixed to keep them apart from global objects
+   std::map< std::string, uint32_t > owners;
+   std::vector< std::string > resources;
+   fc::flat_set< account_name_type > accounts;
+
+   for( uint32_t i = 0; i < trx_count; ++i )
+   {
+      const auto& trx = block.transactions[i];
+
+      resources.clear();
+      accounts.clear();
+      steem::app::transaction_get_impacted_accounts( trx, accounts );
+
+      for( const auto& account : accounts )
+         resources.push_back( "@" + std::string( account ) );
+
+      auto global_begin = resources.size();
+      detail::get_global_resources_visitor visitor( resources );
+      for( const auto& op : trx.operations )
+         op.visit( visitor );
+
+      if( resources.size() > global_begin )
+         ++result.global_transactions;
+
+      for( const auto& resource : resources )
+      {
+         auto owner = owners.emplace( resource, i );
+         if( !owner.second )
+            sets.join( owner.first->second, i );
+      }
+   }
+
+   // Number the groups by their first transaction
+   std::map< uint32_t, uint32_t > group_of_root;
+   std::vector< uint32_t > group_sizes;
+   result.transaction_groups.resize( trx_count );
+
+   for( uint32_t i = 0; i < trx_count; ++i )
+   {
+      auto group = group_of_root.emplace( sets.find( i ), group_sizes.size() );
+      if( group.second )
+         group_sizes.push_back( 0 );
+
+      result.transaction_groups[i] = group.first->second;
+      ++group_sizes[ group.first->second ];
+   }
+
+   result.group_count = group_sizes.size();
+   for( auto size : group_sizes )
+      result.largest_group = std::max( result.largest_group, size );
+
+   return result;
+}
+
+} } } // steem::chain::util
@@ -1,8 +1,21 @@
 #include <chainbase/chainbase.hpp>
 #include <boost/array.hpp>
 
+#include <cerrno>
+#include <cstdio>
 #include <iostream>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/statfs.h>
+#include <sys/syscall.h>
+#endif
+
 namespace chainbase {
 
    struct environment_check {
@@ -30,6 +43,154 @@ namespace chainbase {
       bool                    windows = false;
    };
 
+   thread_local bool database::_reading_snapshot = false;
+
+#ifndef ENABLE_STD_ALLOCATOR
+   namespace
+   {
+      /// The image is written and loaded in blocks of this size, blocks that are all zero become holes
+      const size_t image_block_size = 1 << 20;
+
+      void throw_errno( const std::string& what )
+      {
+         BOOST_THROW_EXCEPTION( std::runtime_error( what + ": " + strerror( errno ) ) );
+      }
+
+      size_t round_to_page( size_t size )
+      {
+         size_t page_size = sysconf( _SC_PAGE_SIZE );
+         return ( size + page_size - 1 ) / page_size * page_size;
+      }
+
+      void* map_anonymous( size_t size )
+      {
+         void* base = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+         if( base == MAP_FAILED )
+            throw_errno( "could not map " + std::to_string( size ) + " bytes of anonymous memory" );
+         return base;
+      }
+
+      bool is_zero( const char* data, size_t size )
+      {
+         return size == 0 || ( data[0] == 0 && memcmp( data, data + 1, size - 1 ) == 0 );
+      }
+
+      void read_at( int fd, char* data, size_t size, off_t pos )
+      {
+         while( size )
+         {
+            ssize_t n = pread( fd, data, size, pos );
+            if( n < 0 && errno == EINTR )
+               continue;
+            if( n <= 0 )
+               throw_errno( "could not read the shared memory image" );
+            data += n;
+            size -= n;
+            pos += n;
+         }
+      }
+
+      /// Returns 0 or the errno of the failed write
+      int write_at( int fd, const char* data, size_t size, off_t pos ) noexcept
+      {
+         while( size )
+         {
+            ssize_t n = pwrite( fd, data, size, pos );
+            if( n < 0 && errno == EINTR )
+               continue;
+            if( n <= 0 )
+               return n < 0 ? errno : EIO;
+            data += n;
+            size -= n;
+            pos += n;
+         }
+         return 0;
+      }
+
+      /**
+       * Writes size bytes at base to temp_path front to back and renames it over image_path, so a crash
+       * while writing leaves the previous image intact. Blocks that are all zero are skipped and become
+       * holes, which keeps the image of a mostly free segment small.
+       *
+       * Returns 0 or the errno of the step that failed. It neither allocates nor throws, so that the
+       * forked image writer can call it although another thread may have held the heap lock at the fork.
+       */
+      int write_image_file( const char* base, size_t size, const char* temp_path, const char* image_path ) noexcept
+      {
+         int fd = ::open( temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+         if( fd < 0 )
+            return errno;
+
+         int error = 0;
+         for( size_t pos = 0; pos < size && !error; pos += image_block_size )
+         {
+            size_t block_size = std::min( image_block_size, size - pos );
+            if( !is_zero( base + pos, block_size ) )
+               error = write_at( fd, base + pos, block_size, pos );
+         }
+
+         if( !error && ftruncate( fd, size ) != 0 )
+            error = errno;
+         if( !error && fsync( fd ) != 0 )
+            error = errno;
+
+         ::close( fd );
+         if( !error && ::rename( temp_path, image_path ) != 0 )
+            error = errno;
+
+         return error;
+      }
+   }
+#endif
+
+#ifdef __linux__
+   namespace
+   {
+      const long hugetlbfs_magic = 0x958458f6;
+      const long tmpfs_magic = 0x01021994;
+
+      /// Bytes of the mapping starting at base that are backed by huge pages, from /proc/self/smaps
+      size_t get_huge_page_bytes( const void* base )
+      {
+         std::ifstream smaps( "/proc/self/smaps" );
+         std::string line;
+         bool in_mapping = false;
+         size_t kernel_page_kb = 0, rss_kb = 0, huge_kb = 0;
+
+         while( std::getline( smaps, line ) )
+         {
+            unsigned long start = 0, end = 0;
+            if( std::sscanf( line.c_str(), "%lx-%lx ", &start, &end ) == 2 && line.find( ':' ) > line.find( ' ' ) )
+            {
+               if( in_mapping )
+                  break;
+               in_mapping = ( start == reinterpret_cast< unsigned long >( base ) );
+               continue;
+            }
+
+            if( !in_mapping )
+               continue;
+
+            size_t kb = 0;
+            if( std::sscanf( line.c_str(), "KernelPageSize: %zu kB", &kb ) == 1 )
+               kernel_page_kb = kb;
+            else if( std::sscanf( line.c_str(), "Rss: %zu kB", &kb ) == 1 )
+               rss_kb = kb;
+            else if( std::sscanf( line.c_str(), "AnonHugePages: %zu kB", &kb ) == 1
+                  || std::sscanf( line.c_str(), "ShmemPmdMapped: %zu kB", &kb ) == 1
+                  || std::sscanf( line.c_str(), "FilePmdMapped: %zu kB", &kb ) == 1 )
+               huge_kb += kb;
+         }
+
+         // Every page of a hugetlbfs mapping is a huge page
+         if( kernel_page_kb > 4 )
+            huge_kb = rss_kb;
+
+         return huge_kb * 1024;
+      }
+   }
+#endif
+
    void database::open( const bfs::path& dir, uint32_t flags, size_t shared_file_size )
    {
       bfs::create_directories( dir );
@@ -40,6 +201,29 @@ namespace chainbase {
 #ifndef ENABLE_STD_ALLOCATOR
       auto abs_path = bfs::absolute( dir / "shared_memory.bin" );
 
+      _segment_info = segment_statistic_info();
+
+      if( _segment_options.anonymous )
+      {
+         open_anonymous( dir, shared_file_size );
+         apply_segment_options();
+         return;
+      }
+
+#ifdef __linux__
+      struct statfs fs;
+      if( statfs( dir.generic_string().c_str(), &fs ) == 0 )
+      {
+         _segment_info.page_size = fs.f_bsize;
+         _segment_info.hugetlbfs = ( long( fs.f_type ) == hugetlbfs_magic );
+         _segment_info.tmpfs = ( long( fs.f_type ) == tmpfs_magic );
+      }
+
+      // Files on hugetlbfs can only be sized in whole huge pages
+      if( _segment_info.hugetlbfs && shared_file_size % _segment_info.page_size )
+         shared_file_size += _segment_info.page_size - shared_file_size % _segment_info.page_size;
+#endif
+
       if( bfs::exists( abs_path ) )
       {
          _file_size = bfs::file_size( abs_path );
@@ -70,34 +254,403 @@ namespace chainbase {
       _flock = bip::file_lock( abs_path.generic_string().c_str() );
       if( !_flock.try_lock() )
          BOOST_THROW_EXCEPTION( std::runtime_error( "could not gain write access to the shared memory file" ) );
+
+      apply_segment_options();
 #endif
    }
 
+#ifndef ENABLE_STD_ALLOCATOR
+   void database::open_anonymous( const bfs::path& dir, size_t shared_file_size )
+   {
+      if( _anonymous_segment )
+      {
+         write_image();
+         unmap_anonymous();
+      }
+
+      // The image is replaced on every write, so the lock is held on a file of its own
+      auto lock_path = bfs::absolute( dir / "shared_memory.lock" );
+      if( !bfs::exists( lock_path ) )
+         std::ofstream( lock_path.generic_string() );
+
+      _flock = bip::file_lock( lock_path.generic_string().c_str() );
+      if( !_flock.try_lock() )
+         BOOST_THROW_EXCEPTION( std::runtime_error( "could not gain write access to the shared memory image" ) );
+
+      auto image_path = bfs::absolute( dir / "shared_memory.image" );
+      size_t image_size = bfs::exists( image_path ) ? bfs::file_size( image_path ) : 0;
+
+      _file_size = round_to_page( std::max( shared_file_size, image_size ) );
+      _anonymous_base = map_anonymous( _file_size );
+      _anonymous_size = _file_size;
+      _segment_info.page_size = sysconf( _SC_PAGE_SIZE );
+      _segment_info.anonymous = true;
+
+      try
+      {
+         if( image_size )
+         {
+            int fd = ::open( image_path.generic_string().c_str(), O_RDONLY );
+            if( fd < 0 )
+               throw_errno( "could not open " + image_path.generic_string() );
+
+            char* base = static_cast< char* >( _anonymous_base );
+            off_t pos = 0;
+
+            try
+            {
+               while( pos < off_t( image_size ) )
+               {
+                  // Holes are left untouched, they are already zero in a fresh anonymous mapping
+                  off_t begin = pos, end = image_size;
+#ifdef SEEK_DATA
+                  off_t data = lseek( fd, pos, SEEK_DATA );
+                  if( data < 0 && errno == ENXIO )
+                     break;
+
+                  // File systems without hole reporting are read as a whole
+                  if( data >= 0 )
+                  {
+                     begin = data;
+                     off_t hole = lseek( fd, data, SEEK_HOLE );
+                     if( hole >= 0 )
+                        end = std::min( hole, off_t( image_size ) );
+                  }
+#endif
+                  for( off_t block = begin; block < end; block += image_block_size )
+                     read_at( fd, base + block, std::min< size_t >( image_block_size, end - block ), block );
+
+                  pos = end;
+               }
+            }
+            catch( ... )
+            {
+               ::close( fd );
+               throw;
+            }
+
+            ::close( fd );
+
+            _anonymous_segment.reset( new managed_anonymous_buffer( bip::open_only, _anonymous_base, image_size ) );
+            if( _anonymous_size > image_size )
+               _anonymous_segment->grow( _anonymous_size - image_size );
+
+            auto env = _anonymous_segment->find< environment_check >( "environment" );
+            if( !env.first || !( *env.first == environment_check()) ) {
+               BOOST_THROW_EXCEPTION( std::runtime_error( "database created by a different compiler, build, or operating system" ) );
+            }
+         }
+         else
+         {
+            _anonymous_segment.reset( new managed_anonymous_buffer( bip::create_only, _anonymous_base, _anonymous_size ) );
+            _anonymous_segment->find_or_construct< environment_check >( "environment" )();
+         }
+      }
+      catch( ... )
+      {
+         unmap_anonymous();
+         throw;
+      }
+   }
+
+   void database::resize_anonymous( size_t new_shared_file_size )
+   {
+      size_t new_size = round_to_page( new_shared_file_size );
+      if( new_size <= _anonymous_size )
+         return;
+
+#ifdef __linux__
+      void* base = mremap( _anonymous_base, _anonymous_size, new_size, MREMAP_MAYMOVE );
+      if( base == MAP_FAILED )
+         throw_errno( "could not grow the anonymous memory to " + std::to_string( new_size ) + " bytes" );
+#else
+      void* base = map_anonymous( new_size );
+      for( size_t pos = 0; pos < _anonymous_size; pos += image_block_size )
+      {
+         const char* block = static_cast< const char* >( _anonymous_base ) + pos;
+         size_t size = std::min( image_block_size, _anonymous_size - pos );
+         if( !is_zero( block, size ) )
+            memcpy( static_cast< char* >( base ) + pos, block, size );
+      }
+      munmap( _anonymous_base, _anonymous_size );
+#endif
+
+      // The segment only holds offset pointers, so it can be reopened at the new address
+      _anonymous_segment.reset( new managed_anonymous_buffer( bip::open_only, base, _anonymous_size ) );
+      _anonymous_segment->grow( new_size - _anonymous_size );
+
+      _anonymous_base = base;
+      _anonymous_size = new_size;
+      _file_size = new_size;
+
+      apply_segment_options();
+   }
+
+   void database::write_image()const
+   {
+      reap_image_writer( true );
+      auto image_path = bfs::absolute( _data_dir / "shared_memory.image" ).generic_string();
+      errno = write_image_file( static_cast< const char* >( _anonymous_base ), _anonymous_size,
+         bfs::absolute( _data_dir / "shared_memory.image.tmp" ).generic_string().c_str(), image_path.c_str() );
+      if( errno )
+         throw_errno( "could not write " + image_path );
+   }
+
+   bool database::write_image_in_background()
+   {
+      if( reap_image_writer( false ) )
+         return false;
+
+      auto temp_path = bfs::absolute( _data_dir / "shared_memory.image.tmp" ).generic_string();
+      auto image_path = bfs::absolute( _data_dir / "shared_memory.image" ).generic_string();
+
+      pid_t pid = fork();
+      if( pid < 0 )
+         throw_errno( "could not fork the shared memory image writer" );
+
+      if( pid == 0 )
+      {
+         // The child sees the segment as it is now, the writes of the parent are copied on write.
+         // Only async signal safe calls are made here, the exit status is the errno of a failed write.
+         _exit( write_image_file( static_cast< const char* >( _anonymous_base ), _anonymous_size,
+            temp_path.c_str(), image_path.c_str() ) );
+      }
+
+      _image_writer_pid = pid;
+      return true;
+   }
+
+   bool database::reap_image_writer( bool wait )const
+   {
+      if( !_image_writer_pid )
+         return false;
+
+      int status = 0;
+      pid_t result = 0;
+      do
+      {
+         result = waitpid( _image_writer_pid, &status, wait ? 0 : WNOHANG );
+      } while( result < 0 && errno == EINTR );
+
+      if( result == 0 )
+         return true;
+
+      if( result < 0 )
+         std::cerr << "Could not wait for the shared memory image writer: " << strerror( errno ) << std::endl;
+      else if( WIFSIGNALED( status ) )
+         std::cerr << "The shared memory image writer was killed by signal " << WTERMSIG( status )
+                   << ", the previous image is kept" << std::endl;
+      else if( WIFEXITED( status ) && WEXITSTATUS( status ) != 0 )
+         std::cerr << "Writing the shared memory image in the background failed: " << strerror( WEXITSTATUS( status ) )
+                   << ", the previous image is kept" << std::endl;
+
+      _image_writer_pid = 0;
+      return false;
+   }
+
+   void database::unmap_anonymous()
+   {
+      _anonymous_segment.reset();
+      if( _anonymous_base )
+         munmap( _anonymous_base, _anonymous_size );
+      _anonymous_base = nullptr;
+      _anonymous_size = 0;
+   }
+
+   void* database::segment_address()const
+   {
+      if( _anonymous_segment )
+         return _anonymous_base;
+      return _segment ? _segment->get_address() : nullptr;
+   }
+#endif
+
+   void database::apply_segment_options()
+   {
+#if defined( __linux__ ) && !defined( ENABLE_STD_ALLOCATOR )
+      void* base = segment_address();
+      size_t size = _anonymous_segment ? _anonymous_size : _segment->get_size();
+
+      auto advise = [&]( bool enabled, int advice, const char* name )
+      {
+         if( !enabled )
+            return false;
+
+         if( madvise( base, size, advice ) != 0 )
+         {
+            std::cerr << "madvise( " << name << " ) on the shared memory file failed: " << strerror( errno ) << std::endl;
+            return false;
+         }
+
+         return true;
+      };
+
+      // Pages of a regular file come from the page cache, which ignores the NUMA policy of the mapping and
+      // backs writable shared mappings with small pages only. Anonymous and tmpfs pages follow both, the
+      // pages of a hugetlbfs file follow the NUMA policy and are huge already.
+      auto supported = [&]( bool enabled, bool on_hugetlbfs, const char* name )
+      {
+         if( !enabled || _segment_info.anonymous || _segment_info.tmpfs || ( on_hugetlbfs && _segment_info.hugetlbfs ) )
+            return enabled;
+
+         std::cerr << name << " has no effect on the shared memory file on this file system, ignoring it" << std::endl;
+         return false;
+      };
+
+      _segment_info.transparent_huge_pages = advise( supported( _segment_options.transparent_huge_pages, false, "MADV_HUGEPAGE" ), MADV_HUGEPAGE, "MADV_HUGEPAGE" );
+      _segment_info.random_access = advise( _segment_options.random_access, MADV_RANDOM, "MADV_RANDOM" );
+      _segment_info.prefault = advise( _segment_options.prefault, MADV_WILLNEED, "MADV_WILLNEED" );
+
+      if( supported( _segment_options.numa_policy != segment_options::numa_default, true, "The NUMA policy" ) )
+      {
+         // The largest node count the kernel supports
+         const size_t max_nodes = 1024;
+         const size_t bits = 8 * sizeof( unsigned long );
+         std::vector< unsigned long > mask( max_nodes / bits, 0 );
+
+         std::vector< uint32_t > nodes = _segment_options.numa_nodes;
+         if( nodes.empty() )
+         {
+            for( uint32_t node = 0; node < max_nodes && bfs::exists( "/sys/devices/system/node/node" + std::to_string( node ) ); ++node )
+               nodes.push_back( node );
+         }
+
+         for( uint32_t node : nodes )
+         {
+            if( node >= max_nodes )
+               BOOST_THROW_EXCEPTION( std::runtime_error( "NUMA node " + std::to_string( node ) + " is out of range" ) );
+            mask[ node / bits ] |= 1ul << ( node % bits );
+         }
+
+         int mode = _segment_options.numa_policy == segment_options::numa_interleave ? MPOL_INTERLEAVE : MPOL_BIND;
+         if( syscall( SYS_mbind, base, size, mode, mask.data(), max_nodes + 1, MPOL_MF_MOVE ) != 0 )
+            std::cerr << "mbind on the shared memory file failed: " << strerror( errno ) << std::endl;
+         else
+            _segment_info.numa_policy = _segment_options.numa_policy;
+      }
+#endif
+   }
+
+   segment_statistic_info database::get_segment_statistics()const
+   {
+      segment_statistic_info info = _segment_info;
+      info.file_size = _file_size;
+      info.free_memory = get_free_memory();
+
+#if defined( __linux__ ) && !defined( ENABLE_STD_ALLOCATOR )
+      if( segment_address() )
+         info.huge_page_bytes = get_huge_page_bytes( segment_address() );
+#endif
+
+      return info;
+   }
+
+   segment_fragmentation_info database::get_segment_fragmentation()const
+   {
+      CHAINBASE_REQUIRE_WRITE_LOCK( "get_segment_fragmentation", segment_fragmentation_info );
+
+      segment_fragmentation_info info;
+      info.free_memory = get_free_memory();
+
+#ifndef ENABLE_STD_ALLOCATOR
+      auto* manager = get_segment_manager();
+      std::vector< char* > blocks;
+
+      try
+      {
+         while( true )
+         {
+            // Asking for more than is free makes rbtree_best_fit hand out its largest free block whole
+            size_t received = manager->get_free_memory();
+            char* reuse = nullptr;
+            char* block = manager->allocation_command< char >( bip::allocate_new | bip::nothrow_allocation, 1, received, reuse );
+            if( !block )
+               break;
+
+            blocks.push_back( block );
+
+            size_t bucket = 0;
+            while( received >> ( bucket + 1 ) )
+               ++bucket;
+            if( info.free_block_histogram.size() <= bucket )
+               info.free_block_histogram.resize( bucket + 1 );
+
+            ++info.free_block_histogram[ bucket ];
+            info.largest_free_block = std::max( info.largest_free_block, received );
+         }
+      }
+      catch( ... )
+      {
+         for( char* block : blocks )
+            manager->deallocate( block );
+         throw;
+      }
+
+      for( char* block : blocks )
+         manager->deallocate( block );
+
+      info.free_block_count = blocks.size();
+#endif
+
+      return info;
+   }
+
    void database::flush() {
 #ifndef ENABLE_STD_ALLOCATOR
       if( _segment )
          _segment->flush();
       if( _meta )
          _meta->flush();
+      if( _anonymous_segment )
+         write_image();
+#endif
+   }
+
+   bool database::flush_in_background()
+   {
+#ifndef ENABLE_STD_ALLOCATOR
+      if( _anonymous_segment )
+      {
+         if( _meta )
+            _meta->flush();
+         return write_image_in_background();
+      }
+#endif
+      flush();
+      return true;
+   }
+
+   void database::wait_for_background_flush()const
+   {
+#ifndef ENABLE_STD_ALLOCATOR
+      reap_image_writer( true );
 #endif
    }
 
    void database::close()
    {
 #ifndef ENABLE_STD_ALLOCATOR
+      auto locks = lock_all_for_write();
+      flush();
       _segment.reset();
       _meta.reset();
+      unmap_anonymous();
       _data_dir = bfs::path();
 #endif
    }
 
    void database::wipe( const bfs::path& dir )
    {
+      auto locks = lock_all_for_write();
 #ifndef ENABLE_STD_ALLOCATOR
+      // A background image written after the files are removed would bring the state back
+      reap_image_writer( true );
       _segment.reset();
       _meta.reset();
+      unmap_anonymous();
       bfs::remove_all( dir / "shared_memory.bin" );
       bfs::remove_all( dir / "shared_memory.meta" );
+      bfs::remove_all( dir / "shared_memory.image" );
       _data_dir = bfs::path();
 #endif
       _index_list.clear();
@@ -109,10 +662,22 @@ namespace chainbase {
       if( _undo_session_count )
          BOOST_THROW_EXCEPTION( std::runtime_error( "Cannot resize shared memory file while undo session is active" ) );
 
-      _segment.reset();
-      _meta.reset();
+      // The snapshot indices live in the segment being remapped, wait for the snapshot and group readers to leave
+      auto locks = lock_all_for_write();
 
-      open( _data_dir, 0, new_shared_file_size );
+#ifndef ENABLE_STD_ALLOCATOR
+      if( _anonymous_segment )
+      {
+         resize_anonymous( new_shared_file_size );
+      }
+      else
+#endif
+      {
+         _segment.reset();
+         _meta.reset();
+
+         open( _data_dir, 0, new_shared_file_size );
+      }
 
       _index_list.clear();
       _index_map.clear();
@@ -123,6 +688,43 @@ namespace chainbase {
       }
    }
 
+   std::vector< write_lock > database::lock_all_for_write()
+   {
+      std::vector< write_lock > locks;
+      locks.reserve( _lock_groups.size() + 1 );
+
+      // Always in this order, the snapshot lock first and then the groups by name
+      locks.emplace_back( _snapshot_lock );
+      for( auto& group : _lock_groups )
+      {
+         if( !group.second->held )
+            locks.emplace_back( group.second->mutex );
+      }
+
+      return locks;
+   }
+
+   database::lock_group_hold database::hold_lock_groups()
+   {
+      CHAINBASE_REQUIRE_WRITE_LOCK( "hold_lock_groups", lock_group );
+
+      lock_group_hold hold;
+      hold._groups.reserve( _lock_groups.size() );
+      hold._locks.reserve( _lock_groups.size() );
+
+      for( auto& group : _lock_groups )
+      {
+         if( group.second->held )
+            continue;
+
+         hold._locks.emplace_back( group.second->mutex );
+         hold._groups.push_back( group.second.get() );
+         group.second->held = true;
+      }
+
+      return hold;
+   }
+
    void database::set_require_locking( bool enable_require_locking )
    {
 #ifdef CHAINBASE_CHECK_LOCKING
@@ -171,6 +773,43 @@ namespace chainbase {
       }
    }
 
+   void database::enable_snapshots()
+   {
+      _snapshots_enabled = true;
+
+      write_lock lock( _snapshot_lock );
+      for( auto& index_type : _index_types )
+      {
+         index_type->add_snapshot( *this );
+      }
+   }
+
+   bool database::publish_snapshot( uint64_t wait_micro )
+   {
+      if( !_snapshots_enabled )
+         return true;
+
+      write_lock lock( _snapshot_lock, boost::defer_lock_t() );
+
+      if( !wait_micro )
+      {
+         if( !lock.try_lock() )
+            return false;
+      }
+      else
+      {
+         if( !lock.timed_lock( boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( wait_micro ) ) )
+            return false;
+      }
+
+      for( auto& item : _index_list )
+      {
+         item->publish_snapshot();
+      }
+
+      return true;
+   }
+
    database::session database::start_undo_session()
    {
       vector< std::unique_ptr<abstract_session> > _sub_sessions;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <boost/interprocess/managed_mapped_file.hpp>
+#include <boost/interprocess/managed_external_buffer.hpp>
 #include <boost/interprocess/containers/map.hpp>
 #include <boost/interprocess/containers/set.hpp>
 #include <boost/interprocess/containers/flat_map.hpp>
@@ -21,16 +22,23 @@
 #include <boost/throw_exception.hpp>
 
 #include <chainbase/allocators.hpp>
+#include <chainbase/utils/id_hash_map.hpp>
 #include <chainbase/utils/object_id.hpp>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <bitset>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <map>
 #include <stdexcept>
 #include <typeindex>
 #include <typeinfo>
 
+#include <sys/types.h>
+
 #ifndef CHAINBASE_NUM_RW_LOCKS
    #define CHAINBASE_NUM_RW_LOCKS 10
 #endif
@@ -143,24 +151,157 @@ namespace chainbase {
    template<typename Constructor, typename Allocator> \
    OBJECT_TYPE( Constructor&& c, Allocator&&  ) { c(*this); }
 
+   /**
+    * Objects that own no memory outside of themselves (no shared_string or interprocess containers)
+    * can opt in to delta undo with CHAINBASE_SET_UNDO_BY_DELTA. The undo state then keeps only the
+    * words of the object that were changed by modify() instead of a full copy of it.
+    */
+   template<typename T>
+   struct undo_by_delta { static const bool value = false; };
+
+   /**
+    *  This macro must be used at global scope and OBJECT_TYPE must be fully qualified
+    */
+   #define CHAINBASE_SET_UNDO_BY_DELTA( OBJECT_TYPE ) \
+   namespace chainbase { template<> struct undo_by_delta<OBJECT_TYPE> { static const bool value = true; }; }
+
+   /**
+    * By default the undo state of an index keeps its entries in interprocess maps and sets, which
+    * allocate a node per entry. Indexes whose objects are modified in bulk by every transaction
+    * can select open addressing tables instead with CHAINBASE_SET_HASHED_UNDO.
+    */
+   template<typename T>
+   struct hashed_undo { static const bool value = false; };
+
+   /**
+    *  This macro must be used at global scope and OBJECT_TYPE must be fully qualified
+    */
+   #define CHAINBASE_SET_HASHED_UNDO( OBJECT_TYPE ) \
+   namespace chainbase { template<> struct hashed_undo<OBJECT_TYPE> { static const bool value = true; }; }
+
+   /**
+    * The original value of the 8 byte words of an object that changed during an undo session.
+    * A word is saved the first time it changes, so every word that is not saved still holds
+    * its value from the start of the session.
+    */
+   template< typename value_type >
+   class undo_delta
+   {
+      public:
+         static constexpr size_t num_words = ( sizeof( value_type ) + sizeof( uint64_t ) - 1 ) / sizeof( uint64_t );
+
+         template<typename T>
+         undo_delta( allocator<T> al )
+         :_words( allocator< uint64_t >( al ) ){}
+
+         /// Saves the words that differ between before and after and are not saved yet
+         void record( const value_type& before, const value_type& after )
+         {
+            const char* b = reinterpret_cast< const char* >( &before );
+            const char* a = reinterpret_cast< const char* >( &after );
+
+            for( size_t i = 0; i < num_words; ++i )
+            {
+               if( is_saved( i ) || std::memcmp( b + offset( i ), a + offset( i ), word_size( i ) ) == 0 )
+                  continue;
+
+               _words.insert( _words.begin() + rank( i ), read_word( b, i ) );
+               _mask[ i / 64 ] |= uint64_t(1) << ( i % 64 );
+            }
+         }
+
+         /**
+          * Combines this delta with the delta of the following session. Words saved here are older
+          * and win, words only saved by newer still held their value from the start of this session.
+          */
+         void merge_newer( const undo_delta& newer )
+         {
+            for( size_t i = 0; i < num_words; ++i )
+            {
+               if( !newer.is_saved( i ) || is_saved( i ) )
+                  continue;
+
+               _words.insert( _words.begin() + rank( i ), newer._words[ newer.rank( i ) ] );
+               _mask[ i / 64 ] |= uint64_t(1) << ( i % 64 );
+            }
+         }
+
+         /// Restores the saved words of v
+         void apply( value_type& v )const
+         {
+            char* dest = reinterpret_cast< char* >( &v );
+            size_t w = 0;
+
+            for( size_t i = 0; i < num_words; ++i )
+            {
+               if( !is_saved( i ) )
+                  continue;
+
+               std::memcpy( dest + offset( i ), &_words[ w++ ], word_size( i ) );
+            }
+         }
+
+         size_t size()const { return _words.size(); }
+
+      private:
+         static size_t offset( size_t i ) { return i * sizeof( uint64_t ); }
+         static size_t word_size( size_t i ) { return std::min( sizeof( uint64_t ), sizeof( value_type ) - offset( i ) ); }
+
+         static uint64_t read_word( const char* data, size_t i )
+         {
+            uint64_t word = 0;
+            std::memcpy( &word, data + offset( i ), word_size( i ) );
+            return word;
+         }
+
+         bool is_saved( size_t i )const { return _mask[ i / 64 ] & ( uint64_t(1) << ( i % 64 ) ); }
+
+         size_t rank( size_t i )const
+         {
+            size_t r = 0;
+            for( size_t m = 0; m < i / 64; ++m )
+               r += std::bitset< 64 >( _mask[ m ] ).count();
+            if( i % 64 )
+               r += std::bitset< 64 >( _mask[ i / 64 ] & ( ( uint64_t(1) << ( i % 64 ) ) - 1 ) ).count();
+            return r;
+         }
+
+         std::array< uint64_t, ( num_words + 63 ) / 64 > _mask = {};
+         t_vector< uint64_t >                                 _words;
+   };
+
    template< typename value_type >
    class undo_state
    {
       public:
          typedef typename value_type::id_type                      id_type;
+         typedef undo_delta< value_type >                          delta_type;
          typedef allocator< std::pair<const id_type, value_type> > id_value_allocator_type;
+         typedef allocator< std::pair<const id_type, delta_type> > id_delta_allocator_type;
          typedef allocator< id_type >                              id_allocator_type;
 
          template<typename T>
          undo_state( allocator<T> al )
          :old_values( id_value_allocator_type( al ) ),
+          old_deltas( id_delta_allocator_type( al ) ),
           removed_values( id_value_allocator_type( al ) ),
           new_ids( id_allocator_type( al ) ){}
 
-         typedef boost::interprocess::map< id_type, value_type, std::less<id_type>, id_value_allocator_type >  id_value_type_map;
-         typedef boost::interprocess::set< id_type, std::less<id_type>, id_allocator_type >                    id_type_set;
+         typedef typename std::conditional< hashed_undo< value_type >::value,
+            id_hash_map< id_type, value_type >,
+            boost::interprocess::map< id_type, value_type, std::less<id_type>, id_value_allocator_type >
+            >::type                                                                                          id_value_type_map;
+         typedef typename std::conditional< hashed_undo< value_type >::value,
+            id_hash_map< id_type, delta_type >,
+            boost::interprocess::map< id_type, delta_type, std::less<id_type>, id_delta_allocator_type >
+            >::type                                                                                          id_delta_type_map;
+         typedef typename std::conditional< hashed_undo< value_type >::value,
+            id_hash_set< id_type >,
+            boost::interprocess::set< id_type, std::less<id_type>, id_allocator_type >
+            >::type                                                                                          id_type_set;
 
          id_value_type_map            old_values;
+         id_delta_type_map            old_deltas;    ///< Used instead of old_values when undo_by_delta is set
          id_value_type_map            removed_values;
          id_type_set                  new_ids;
          id_type                      old_next_id = 0;
@@ -210,7 +351,7 @@ namespace chainbase {
          typedef undo_state< value_type >                              undo_state_type;
 
          generic_index( allocator<value_type> a )
-         :_stack(a),_indices( a ),_size_of_value_type( sizeof(typename MultiIndexType::value_type) ),_size_of_this(sizeof(*this)){}
+         :_stack(a),_indices( a ),_size_of_value_type( sizeof(typename MultiIndexType::value_type) ),_size_of_this(sizeof(*this)),_changed_ids( a ){}
 
          /**
           * Construct a new element in the multi_index_container.
@@ -232,18 +373,95 @@ namespace chainbase {
             }
 
             ++_next_id;
+            on_change( new_id );
             on_create( *insert_result.first );
             return *insert_result.first;
          }
 
+         /**
+          * Construct count elements in one batch, calling c( obj, i ) on the i-th one. The elements take
+          * consecutive ids, so each is placed at the end of the id index without searching for its position.
+          */
+         template<typename Constructor>
+         void bulk_emplace( size_t count, Constructor&& c ) {
+            for( size_t i = 0; i < count; ++i ) {
+               auto new_id = _next_id;
+
+               auto constructor = [&]( value_type& v ) {
+                  v.id = new_id;
+                  c( v, i );
+               };
+
+               auto size = _indices.size();
+               auto itr = _indices.emplace_hint( _indices.end(), constructor, _indices.get_allocator() );
+
+               if( _indices.size() == size ) {
+                  BOOST_THROW_EXCEPTION( std::logic_error("could not insert object, most likely a uniqueness constraint was violated") );
+               }
+
+               ++_next_id;
+               on_change( new_id );
+               on_create( *itr );
+            }
+         }
+
+         /**
+          * Construct an element whose id is set by the constructor, such as an object read back from
+          * a state snapshot. Nothing is recorded for undo, so no undo session may be active.
+          * Elements restored in id order are appended to the id index without a search.
+          */
+         template<typename Constructor>
+         const value_type& restore( Constructor&& c ) {
+            if( enabled() )
+               BOOST_THROW_EXCEPTION( std::logic_error( "cannot restore objects while an undo session is active" ) );
+
+            auto size = _indices.size();
+            auto itr = _indices.emplace_hint( _indices.end(), c, _indices.get_allocator() );
+
+            if( _indices.size() == size ) {
+               BOOST_THROW_EXCEPTION( std::logic_error("could not restore object, most likely a uniqueness constraint was violated") );
+            }
+
+            const auto& id = itr->id;
+            if( !( id < _next_id ) )
+               _next_id = typename value_type::id_type( id._id + 1 );
+
+            on_change( id );
+            return *itr;
+         }
+
+         typename value_type::id_type next_id()const { return _next_id; }
+
+         /// Sets the id of the next created object, which may only move forward
+         void set_next_id( typename value_type::id_type id ) {
+            if( id < _next_id )
+               BOOST_THROW_EXCEPTION( std::logic_error( "next id is lower than an existing object id" ) );
+            _next_id = id;
+         }
+
          template<typename Modifier>
          void modify( const value_type& obj, Modifier&& m ) {
-            on_modify( obj );
+            on_change( obj.id );
+
+            if constexpr( undo_by_delta< value_type >::value )
+            {
+               if( enabled() && !_stack.back().new_ids.count( obj.id ) )
+               {
+                  modify_with_delta( obj, m );
+                  return;
+               }
+            }
+            else
+            {
+               on_modify( obj );
+            }
+
             auto ok = _indices.modify( _indices.iterator_to( obj ), m );
             if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
          }
 
          void remove( const value_type& obj ) {
+            on_change( obj.id );
             on_remove( obj );
             _indices.erase( _indices.iterator_to( obj ) );
          }
@@ -326,6 +544,14 @@ namespace chainbase {
 
             const auto& head = _stack.back();
 
+            if( _track_changes )
+            {
+               for( const auto& item : head.old_values )     on_change( item.first );
+               for( const auto& item : head.old_deltas )     on_change( item.first );
+               for( const auto& id : head.new_ids )          on_change( id );
+               for( const auto& item : head.removed_values ) on_change( item.first );
+            }
+
             for( auto& item : head.old_values ) {
                auto ok = _indices.modify( _indices.find( item.second.id ), [&]( value_type& v ) {
                   v = std::move( item.second );
@@ -333,6 +559,13 @@ namespace chainbase {
                if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
             }
 
+            for( const auto& item : head.old_deltas ) {
+               auto ok = _indices.modify( _indices.find( item.first ), [&]( value_type& v ) {
+                  item.second.apply( v );
+               });
+               if( !ok ) BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
+            }
+
             for( const auto& id : head.new_ids )
             {
                _indices.erase( _indices.find( id ) );
@@ -425,6 +658,28 @@ namespace chainbase {
                prev_state.old_values.emplace( std::move(item) );
             }
 
+            // Deltas follow the same rules, except that upd+upd has to keep the words of the
+            // newer delta that the older one did not save.
+            for( const auto& item : state.old_deltas )
+            {
+               if( prev_state.new_ids.find( item.first ) != prev_state.new_ids.end() )
+               {
+                  // new+upd -> new, type A
+                  continue;
+               }
+               auto it = prev_state.old_deltas.find( item.first );
+               if( it != prev_state.old_deltas.end() )
+               {
+                  // upd(was=X) + upd(was=Y) -> upd(was=X)
+                  it->second.merge_newer( item.second );
+                  continue;
+               }
+               // del+upd -> N/A
+               assert( prev_state.removed_values.find( item.first ) == prev_state.removed_values.end() );
+               // nop+upd(was=Y) -> upd(was=Y), type B
+               prev_state.old_deltas.emplace( item );
+            }
+
             // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
             for( const auto& id : state.new_ids )
                prev_state.new_ids.insert(id);
@@ -446,6 +701,15 @@ namespace chainbase {
                   prev_state.old_values.erase(obj.second.id);
                   continue;
                }
+               auto dit = prev_state.old_deltas.find(obj.second.id);
+               if( dit != prev_state.old_deltas.end() )
+               {
+                  // upd(was=X) + del(was=Y) -> del(was=X), where X is Y with the words saved in prev_state restored
+                  dit->second.apply( obj.second );
+                  prev_state.removed_values.emplace( std::move(obj) );
+                  prev_state.old_deltas.erase( dit );
+                  continue;
+               }
                // del + del -> N/A
                assert( prev_state.removed_values.find( obj.second.id ) == prev_state.removed_values.end() );
                // nop + del(was=Y) -> del(was=Y)
@@ -482,9 +746,93 @@ namespace chainbase {
             _revision = revision;
          }
 
+         /**
+          * Records the ids of the objects created, modified, removed or restored by undo since the
+          * last publish() so that a snapshot of this index can be brought up to date incrementally.
+          */
+         void track_changes( bool enable )
+         {
+            _track_changes = enable;
+            _changed_ids.clear();
+         }
+
+         /// Replaces the contents of snapshot with a copy of this index
+         void copy_to( generic_index& snapshot )
+         {
+            snapshot._indices.clear();
+            for( const auto& obj : _indices )
+               snapshot._indices.insert( snapshot._indices.end(), obj );
+
+            snapshot._next_id = _next_id;
+            _changed_ids.clear();
+         }
+
+         /// Copies the objects changed since the last copy_to() or publish() to snapshot
+         void publish( generic_index& snapshot )
+         {
+            // Erase first so that the changed objects cannot collide with stale unique keys
+            for( const auto& id : _changed_ids )
+            {
+               auto itr = snapshot._indices.find( id );
+               if( itr != snapshot._indices.end() )
+                  snapshot._indices.erase( itr );
+            }
+
+            for( const auto& id : _changed_ids )
+            {
+               auto itr = _indices.find( id );
+               if( itr == _indices.end() )
+                  continue;
+
+               if( !snapshot._indices.insert( *itr ).second )
+                  BOOST_THROW_EXCEPTION( std::logic_error( "Could not publish object, most likely a uniqueness constraint was violated" ) );
+            }
+
+            snapshot._next_id = _next_id;
+            _changed_ids.clear();
+         }
+
       private:
          bool enabled()const { return _stack.size(); }
 
+         void on_change( const typename value_type::id_type& id ) {
+            if( _track_changes )
+               _changed_ids.insert( id );
+         }
+
+         template<typename Modifier>
+         void modify_with_delta( const value_type& obj, Modifier&& m ) {
+            auto& head = _stack.back();
+
+            // Byte image of the object before the modification. Objects with undo_by_delta set own
+            // no memory outside of themselves, so their bytes are their complete state.
+            typename std::aligned_storage< sizeof( value_type ), alignof( value_type ) >::type before;
+            std::memcpy( &before, &obj, sizeof( value_type ) );
+            const value_type& before_value = *reinterpret_cast< const value_type* >( &before );
+
+            auto id = obj.id;
+            auto ok = _indices.modify( _indices.iterator_to( obj ), m );
+            if( !ok )
+            {
+               // The container erased the object, record it as removed so undo restores it
+               value_type old_value( before_value );
+               auto itr = head.old_deltas.find( id );
+               if( itr != head.old_deltas.end() )
+               {
+                  itr->second.apply( old_value );
+                  head.old_deltas.erase( itr );
+               }
+               head.removed_values.emplace( id, std::move( old_value ) );
+               BOOST_THROW_EXCEPTION( std::logic_error( "Could not modify object, most likely a uniqueness constraint was violated" ) );
+            }
+
+            auto itr = head.old_deltas.find( id );
+            if( itr == head.old_deltas.end() )
+               itr = head.old_deltas.emplace( id, typename undo_state_type::delta_type( _indices.get_allocator() ) ).first;
+
+            itr->second.record( before_value, obj );
+         }
+
          void on_modify( const value_type& v ) {
             if( !enabled() ) return;
 
@@ -516,6 +864,15 @@ namespace chainbase {
                return;
             }
 
+            auto ditr = head.old_deltas.find( v.id );
+            if( ditr != head.old_deltas.end() ) {
+               value_type old_value( v );
+               ditr->second.apply( old_value );
+               head.removed_values.emplace( v.id, std::move( old_value ) );
+               head.old_deltas.erase( ditr );
+               return;
+            }
+
             if( head.removed_values.count( v.id ) )
                return;
 
@@ -542,8 +899,24 @@ namespace chainbase {
          index_type                      _indices;
          uint32_t                        _size_of_value_type = 0;
          uint32_t                        _size_of_this = 0;
+
+         bool                                                  _track_changes = false;
+         id_hash_set< typename value_type::id_type >           _changed_ids;
+   };
+
+   /// The lock of a group of indices, see database::set_lock_group()
+   struct lock_group
+   {
+      read_write_mutex mutex;
+      bool             held = false;   ///< Locked by database::hold_lock_groups(), the writes do not lock it again
    };
 
+   /// The lock a single write to an index of group takes, none while the group is held
+   inline write_lock lock_group_for_write( lock_group* group )
+   {
+      return group && !group->held ? write_lock( group->mutex ) : write_lock();
+   }
+
    class abstract_session {
       public:
          virtual ~abstract_session(){};
@@ -557,14 +930,20 @@ namespace chainbase {
    class session_impl : public abstract_session
    {
       public:
-         session_impl( SessionType&& s ):_session( std::move( s ) ){}
+         session_impl( SessionType&& s, lock_group* group = nullptr ):_session( std::move( s ) ),_lock_group( group ){}
 
          virtual void push() override  { _session.push();  }
          virtual void squash() override{ _session.squash(); }
-         virtual void undo() override  { _session.undo();  }
+         virtual void undo() override
+         {
+            // Undo changes objects, so it excludes the readers of the lock group like any other write
+            write_lock lock = lock_group_for_write( _lock_group );
+            _session.undo();
+         }
          virtual int64_t revision()const override  { return _session.revision();  }
       private:
-         SessionType _session;
+         SessionType       _session;
+         lock_group*       _lock_group = nullptr;
    };
 
    class index_extension
@@ -593,14 +972,28 @@ namespace chainbase {
          virtual void    undo_all()const = 0;
          virtual uint32_t type_id()const  = 0;
 
+         virtual void    track_changes( bool enable )const = 0;
+         virtual void    copy_to_snapshot()const = 0;
+         virtual void    publish_snapshot()const = 0;
+
          virtual statistic_info get_statistics(bool onlyStaticInfo) const = 0;
          virtual size_t size() const = 0;
 
          void add_index_extension( std::shared_ptr< index_extension > ext )  { _extensions.push_back( ext ); }
          const index_extensions& get_index_extensions()const  { return _extensions; }
          void* get()const { return _idx_ptr; }
+
+         /// The copy of the index read by database::with_snapshot_read(), if snapshots are enabled
+         void* get_snapshot()const { return _snapshot_ptr; }
+         void  set_snapshot( void* s ) { _snapshot_ptr = s; }
+
+         /// The lock taken by writes to the index in addition to the database lock, see database::set_lock_group()
+         lock_group* get_lock_group()const { return _lock_group; }
+         void        set_lock_group( lock_group* group ) { _lock_group = group; }
       private:
          void*              _idx_ptr;
+         void*              _snapshot_ptr = nullptr;
+         lock_group*        _lock_group = nullptr;
          index_extensions   _extensions;
    };
 
@@ -612,17 +1005,21 @@ namespace chainbase {
          index_impl( BaseIndex& base ):abstract_index( &base ),_base(base){}
 
          virtual unique_ptr<abstract_session> start_undo_session() override {
-            return unique_ptr<abstract_session>(new session_impl<typename BaseIndex::session>( _base.start_undo_session() ) );
+            return unique_ptr<abstract_session>(new session_impl<typename BaseIndex::session>( _base.start_undo_session(), get_lock_group() ) );
          }
 
          virtual void     set_revision( int64_t revision ) override { _base.set_revision( revision ); }
          virtual int64_t  revision()const  override { return _base.revision(); }
-         virtual void     undo()const  override { _base.undo(); }
+         virtual void     undo()const  override { write_lock lock = lock_group_for_write( get_lock_group() ); _base.undo(); }
          virtual void     squash()const  override { _base.squash(); }
          virtual void     commit( int64_t revision )const  override { _base.commit(revision); }
-         virtual void     undo_all() const override {_base.undo_all(); }
+         virtual void     undo_all() const override { write_lock lock = lock_group_for_write( get_lock_group() ); _base.undo_all(); }
          virtual uint32_t type_id()const override { return BaseIndex::value_type::type_id; }
 
+         virtual void     track_changes( bool enable )const override { _base.track_changes( enable ); }
+         virtual void     copy_to_snapshot()const override { _base.copy_to( *static_cast< BaseIndex* >( get_snapshot() ) ); }
+         virtual void     publish_snapshot()const override { _base.publish( *static_cast< BaseIndex* >( get_snapshot() ) ); }
+
          virtual statistic_info get_statistics(bool onlyStaticInfo) const override final
          {
             typedef typename BaseIndex::index_type index_type;
@@ -674,6 +1071,74 @@ namespace chainbase {
          std::atomic< uint32_t >                                    _current_lock;
    };
 
+   /**
+    * Hints for the memory mapping of the shared memory file, applied on open and resize. They are
+    * only supported on Linux. Hints the kernel refuses are ignored with a warning and are not
+    * reported as active by database::get_segment_statistics().
+    *
+    * The NUMA policy and transparent huge pages only apply to an anonymous segment or a file on tmpfs,
+    * and the NUMA policy also to a file on hugetlbfs. The page cache of a regular file ignores the NUMA
+    * policy of a mapping and uses small pages for a writable shared mapping, so both are ignored with a
+    * warning for such a file.
+    *
+    * Explicit huge pages are used by placing the shared memory file on a hugetlbfs mount, in which
+    * case the file size is rounded up to a multiple of the huge page size.
+    *
+    * An anonymous segment is not backed by shared_memory.bin. It is loaded from shared_memory.image
+    * on open and written back to it by flush() and close() in one sequential pass, so the kernel never
+    * writes back pages while the database runs. flush_in_background() writes the image from a forked
+    * child instead, which sees the segment as of the fork while the pages the parent changes meanwhile
+    * are copied. Changes made after the last image are lost when the process dies. The two formats are
+    * not interchangeable, switching modes requires a replay.
+    */
+   struct segment_options
+   {
+      enum numa_policy_type
+      {
+         numa_default,
+         numa_interleave,
+         numa_bind
+      };
+
+      bool                    transparent_huge_pages = false;   ///< madvise( MADV_HUGEPAGE )
+      bool                    random_access = false;            ///< madvise( MADV_RANDOM ), disables read ahead
+      bool                    prefault = false;                 ///< madvise( MADV_WILLNEED )
+      numa_policy_type        numa_policy = numa_default;
+      std::vector< uint32_t > numa_nodes;                       ///< All nodes when empty
+      bool                    anonymous = false;                ///< Keep the segment in anonymous memory
+   };
+
+   struct segment_statistic_info
+   {
+      size_t   file_size = 0;
+      size_t   free_memory = 0;
+      size_t   page_size = 0;                  ///< Page size of the file system, the huge page size on hugetlbfs
+      bool     hugetlbfs = false;
+      bool     tmpfs = false;
+      bool     transparent_huge_pages = false;
+      bool     random_access = false;
+      bool     prefault = false;
+      segment_options::numa_policy_type numa_policy = segment_options::numa_default;
+      size_t   huge_page_bytes = 0;            ///< Bytes of the mapping currently backed by huge pages
+      bool     anonymous = false;
+   };
+
+   struct segment_fragmentation_info
+   {
+      size_t                  free_memory = 0;
+      size_t                  free_block_count = 0;
+      size_t                  largest_free_block = 0;
+      std::vector< size_t >   free_block_histogram;   ///< Entry i counts the free blocks of [2^i, 2^(i+1)) bytes
+   };
+
+#ifndef ENABLE_STD_ALLOCATOR
+   /// Manages an anonymous segment with the segment manager of bip::managed_mapped_file, so both share chainbase::allocator
+   typedef bip::basic_managed_external_buffer< char, bip::rbtree_best_fit< bip::mutex_family >, bip::iset_index > managed_anonymous_buffer;
+
+   static_assert( std::is_same< managed_anonymous_buffer::segment_manager, bip::managed_mapped_file::segment_manager >::value,
+      "anonymous and file backed segments must use the same segment manager" );
+#endif
+
    struct lock_exception : public std::exception
    {
       explicit lock_exception() {}
@@ -695,6 +1160,7 @@ namespace chainbase {
                virtual ~abstract_index_type() {}
 
                virtual void add_index( database& db ) = 0;
+               virtual void add_snapshot( database& db ) = 0;
          };
 
          template< typename IndexType >
@@ -704,16 +1170,49 @@ namespace chainbase {
             {
                db.add_index_helper< IndexType >();
             }
+
+            virtual void add_snapshot( database& db ) override
+            {
+               db.add_snapshot_helper< IndexType >();
+            }
          };
 
       public:
          void open( const bfs::path& dir, uint32_t flags = 0, size_t shared_file_size = 0 );
+
+         /// Flushes the segment and unmaps it
          void close();
+
+         /// Syncs the shared memory file, or writes the image of an anonymous segment. Requires that no other thread writes.
          void flush();
+
+         /**
+          * Like flush(), but the image of an anonymous segment is written by a forked child process, so the
+          * caller only pays for the fork. Returns false, writing nothing, while the previous background image
+          * is still being written. The segment must be consistent when it is called.
+          */
+         bool flush_in_background();
+
+         /// Waits until the image started by flush_in_background(), if any, is written
+         void wait_for_background_flush()const;
          void wipe( const bfs::path& dir );
          void resize( size_t new_shared_file_size );
          void set_require_locking( bool enable_require_locking );
 
+         /// Takes effect on the next open or resize
+         void set_segment_options( const segment_options& options ) { _segment_options = options; }
+         segment_statistic_info get_segment_statistics()const;
+
+         /**
+          * Reports the free blocks of the segment. They are found by allocating the largest free block until
+          * none is left and are released again afterwards, so nothing else may allocate from the segment
+          * meanwhile. Requires the write lock: publishing snapshots and the undo state of plugins allocate
+          * from the same segment as the writer. Each free block costs an allocation and a deallocation in the
+          * tree of free blocks and writes the header page of the block, so the lock is held and pages are
+          * dirtied in proportion to the number of free blocks.
+          */
+         segment_fragmentation_info get_segment_fragmentation()const;
+
 #ifdef CHAINBASE_CHECK_LOCKING
          void require_lock_fail( const char* method, const char* lock_type, const char* tname )const;
 
@@ -723,7 +1222,7 @@ namespace chainbase {
                require_lock_fail(method, "read", tname);
          }
 
-         void require_write_lock( const char* method, const char* tname )
+         void require_write_lock( const char* method, const char* tname )const
          {
             if( BOOST_UNLIKELY( _enable_require_locking & (_write_lock_count <= 0) ) )
                require_lock_fail(method, "write", tname);
@@ -800,13 +1299,14 @@ namespace chainbase {
          template<typename MultiIndexType>
          void add_index()
          {
+            auto locks = lock_all_for_write();
             _index_types.push_back( unique_ptr< abstract_index_type >( new index_type_impl< MultiIndexType >() ) );
             _index_types.back()->add_index( *this );
          }
 
 #ifndef ENABLE_STD_ALLOCATOR
-         auto get_segment_manager() -> decltype( ((bip::managed_mapped_file*)nullptr)->get_segment_manager()) {
-            return _segment->get_segment_manager();
+         bip::managed_mapped_file::segment_manager* get_segment_manager()const {
+            return _anonymous_segment ? _anonymous_segment->get_segment_manager() : _segment->get_segment_manager();
          }
 #endif
          unsigned long long get_total_system_memory() const
@@ -825,7 +1325,7 @@ namespace chainbase {
 #ifdef ENABLE_STD_ALLOCATOR
             return get_total_system_memory();
 #else
-            return _segment->get_segment_manager()->get_free_memory();
+            return get_segment_manager()->get_free_memory();
 #endif
          }
 
@@ -855,7 +1355,7 @@ namespace chainbase {
                BOOST_THROW_EXCEPTION( std::runtime_error( "unable to find index for " + type_name + " in database" ) );
             }
 
-            return *index_type_ptr( _index_map[index_type::value_type::type_id]->get() );
+            return *index_type_ptr( get_readable_index( index_type::value_type::type_id ) );
          }
 
          template<typename MultiIndexType>
@@ -885,7 +1385,7 @@ namespace chainbase {
                BOOST_THROW_EXCEPTION( std::runtime_error( "unable to find index for " + type_name + " in database" ) );
             }
 
-            return index_type_ptr( _index_map[index_type::value_type::type_id]->get() )->indicies().template get<ByIndex>();
+            return index_type_ptr( get_readable_index( index_type::value_type::type_id ) )->indicies().template get<ByIndex>();
          }
 
          template<typename MultiIndexType>
@@ -949,7 +1449,9 @@ namespace chainbase {
          {
              CHAINBASE_REQUIRE_WRITE_LOCK("modify", ObjectType);
              typedef typename get_index_type<ObjectType>::type index_type;
-             get_mutable_index<index_type>().modify( obj, m );
+             auto& idx = get_mutable_index<index_type>();
+             write_lock lock = lock_group_for_write( ObjectType::type_id );
+             idx.modify( obj, m );
          }
 
          template<typename ObjectType>
@@ -957,7 +1459,9 @@ namespace chainbase {
          {
              CHAINBASE_REQUIRE_WRITE_LOCK("remove", ObjectType);
              typedef typename get_index_type<ObjectType>::type index_type;
-             return get_mutable_index<index_type>().remove( obj );
+             auto& idx = get_mutable_index<index_type>();
+             write_lock lock = lock_group_for_write( ObjectType::type_id );
+             return idx.remove( obj );
          }
 
          template<typename ObjectType, typename Constructor>
@@ -965,7 +1469,20 @@ namespace chainbase {
          {
              CHAINBASE_REQUIRE_WRITE_LOCK("create", ObjectType);
              typedef typename get_index_type<ObjectType>::type index_type;
-             return get_mutable_index<index_type>().emplace( std::forward<Constructor>(con) );
+             auto& idx = get_mutable_index<index_type>();
+             write_lock lock = lock_group_for_write( ObjectType::type_id );
+             return idx.emplace( std::forward<Constructor>(con) );
+         }
+
+         /// Creates count objects under a single lock, see generic_index::bulk_emplace()
+         template<typename ObjectType, typename Constructor>
+         void bulk_create( size_t count, Constructor&& con )
+         {
+             CHAINBASE_REQUIRE_WRITE_LOCK("bulk_create", ObjectType);
+             typedef typename get_index_type<ObjectType>::type index_type;
+             auto& idx = get_mutable_index<index_type>();
+             write_lock lock = lock_group_for_write( ObjectType::type_id );
+             idx.bulk_emplace( count, std::forward<Constructor>(con) );
          }
 
          template< typename ObjectType >
@@ -984,6 +1501,140 @@ namespace chainbase {
             read_lock lock( _rw_manager.current_lock(), boost::defer_lock_t() );
 #endif
 
+#ifdef CHAINBASE_CHECK_LOCKING
+            BOOST_ATTRIBUTE_UNUSED
+            int_incrementer ii( _read_lock_count );
+#endif
+
+            if( !wait_micro )
+            {
+               lock.lock();
+            }
+            else
+            {
+               if( !lock.timed_lock( boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( wait_micro ) ) )
+                  BOOST_THROW_EXCEPTION( lock_exception() );
+            }
+
+            return callback();
+         }
+
+         /**
+          * Snapshots let readers run concurrently with the writer. Every index keeps a second copy
+          * of its objects in the shared memory file which is only brought up to date by
+          * publish_snapshot(), so readers inside with_snapshot_read() see the state as of the last
+          * publish instead of waiting for the write lock. This doubles the memory used by the
+          * indices and adds the bookkeeping of changed ids to every write.
+          */
+         void enable_snapshots();
+         bool has_snapshots()const { return _snapshots_enabled; }
+
+         /**
+          * Copies the objects changed since the last publish to the snapshot. Must be called by the
+          * writer at a consistent state. Returns false, leaving the changes to the next publish, when
+          * readers hold the snapshot for longer than wait_micro.
+          */
+         bool publish_snapshot( uint64_t wait_micro = 0 );
+
+         template< typename Lambda >
+         auto with_snapshot_read( Lambda&& callback, uint64_t wait_micro = 1000000 ) -> decltype( (*(Lambda*)nullptr)() )
+         {
+#ifndef ENABLE_STD_ALLOCATOR
+            read_lock lock( _snapshot_lock, bip::defer_lock_type() );
+#else
+            read_lock lock( _snapshot_lock, boost::defer_lock_t() );
+#endif
+
+#ifdef CHAINBASE_CHECK_LOCKING
+            BOOST_ATTRIBUTE_UNUSED
+            int_incrementer ii( _read_lock_count );
+#endif
+
+            if( !wait_micro )
+            {
+               lock.lock();
+            }
+            else
+            {
+               if( !lock.timed_lock( boost::posix_time::microsec_clock::universal_time() + boost::posix_time::microseconds( wait_micro ) ) )
+                  BOOST_THROW_EXCEPTION( lock_exception() );
+            }
+
+            struct snapshot_reader
+            {
+               snapshot_reader() : _prev( _reading_snapshot ) { _reading_snapshot = true; }
+               ~snapshot_reader() { _reading_snapshot = _prev; }
+               bool _prev;
+            } reader;
+
+            return callback();
+         }
+
+         /**
+          * Lock groups let readers of indices that only a few writes touch, such as those of a plugin,
+          * run without the database lock. Writes to an index of a group take the write lock of the
+          * group for the duration of the single create, modify, remove or undo, so readers that only
+          * read indices of the group can use with_read_lock( group, ... ) instead of the database lock.
+          * Such readers see the group between two writes. Unless the writer holds the groups across a
+          * series of writes with hold_lock_groups(), that may be in the middle of a series that is undone
+          * again, so the reader sees objects that never become part of the state.
+          *
+          * Groups must be set before the index is added.
+          */
+         template<typename MultiIndexType>
+         void set_lock_group( const std::string& group )
+         {
+            const uint16_t type_id = generic_index<MultiIndexType>::value_type::type_id;
+
+            auto& lock = _lock_groups[ group ];
+            if( !lock )
+               lock.reset( new lock_group() );
+
+            _index_lock_groups[ type_id ] = lock.get();
+         }
+
+         /// Keeps the lock groups locked for write, see hold_lock_groups()
+         class lock_group_hold
+         {
+            public:
+               lock_group_hold( lock_group_hold&& ) = default;
+               lock_group_hold& operator=( const lock_group_hold& ) = delete;
+
+               ~lock_group_hold()
+               {
+                  for( lock_group* group : _groups )
+                     group->held = false;
+               }
+
+            private:
+               friend class database;
+               lock_group_hold() = default;
+
+               std::vector< lock_group* > _groups;
+               std::vector< write_lock >  _locks;
+         };
+
+         /**
+          * Locks every lock group for write until the returned object is destroyed. The writes made
+          * meanwhile, including the undo of an undo session started after this call, do not take the
+          * group locks again, so the readers of the groups see all of them or none. Groups that are
+          * already held are left to the outer hold. Requires the database write lock.
+          */
+         lock_group_hold hold_lock_groups();
+
+         template< typename Lambda >
+         auto with_read_lock( const std::string& group, Lambda&& callback, uint64_t wait_micro = 1000000 ) -> decltype( (*(Lambda*)nullptr)() )
+         {
+            auto itr = _lock_groups.find( group );
+            if( itr == _lock_groups.end() )
+               BOOST_THROW_EXCEPTION( std::runtime_error( "unknown lock group " + group ) );
+
+#ifndef ENABLE_STD_ALLOCATOR
+            read_lock lock( itr->second->mutex, bip::defer_lock_type() );
+#else
+            read_lock lock( itr->second->mutex, boost::defer_lock_t() );
+#endif
+
 #ifdef CHAINBASE_CHECK_LOCKING
             BOOST_ATTRIBUTE_UNUSED
             int_incrementer ii( _read_lock_count );
@@ -1049,6 +1700,38 @@ namespace chainbase {
             { return _index_list; }
 
       private:
+         void apply_segment_options();
+
+#ifndef ENABLE_STD_ALLOCATOR
+         void  open_anonymous( const bfs::path& dir, size_t shared_file_size );
+         void  resize_anonymous( size_t new_shared_file_size );
+         void  write_image()const;
+         bool  write_image_in_background();
+         /// Reaps a finished background image writer, or waits for it. True while it is still running.
+         bool  reap_image_writer( bool wait )const;
+         void  unmap_anonymous();
+         void* segment_address()const;
+#endif
+
+         /**
+          * Locks the snapshot and every lock group for write. Changes to the index list or the segment
+          * mapping (add_index, resize, wipe, close) take them so that snapshot and group readers, which
+          * do not take the database lock, never see them half done.
+          */
+         std::vector< write_lock > lock_all_for_write();
+
+         write_lock lock_group_for_write( uint16_t type_id )const
+         {
+            return chainbase::lock_group_for_write( _index_map[ type_id ]->get_lock_group() );
+         }
+
+         /// The index read by this thread, which is the snapshot inside with_snapshot_read()
+         void* get_readable_index( uint16_t type_id )const
+         {
+            const auto& idx = _index_map[ type_id ];
+            return _reading_snapshot && idx->get_snapshot() ? idx->get_snapshot() : idx->get();
+         }
+
          template<typename MultiIndexType>
          void add_index_helper() {
              const uint16_t type_id = generic_index<MultiIndexType>::value_type::type_id;
@@ -1063,7 +1746,7 @@ namespace chainbase {
 
              index_type* idx_ptr =  nullptr;
 #ifndef ENABLE_STD_ALLOCATOR
-             idx_ptr = _segment->find_or_construct< index_type >( type_name.c_str() )( index_alloc( _segment->get_segment_manager() ) );
+             idx_ptr = get_segment_manager()->find_or_construct< index_type >( type_name.c_str() )( index_alloc( get_segment_manager() ) );
 #else
              idx_ptr = new index_type( index_alloc() );
 #endif
@@ -1072,15 +1755,69 @@ namespace chainbase {
                 _index_map.resize( type_id + 1 );
 
              auto new_index = new index<index_type>( *idx_ptr );
+             auto group = _index_lock_groups.find( type_id );
+             if( group != _index_lock_groups.end() )
+                new_index->set_lock_group( group->second );
+
              _index_map[ type_id ].reset( new_index );
              _index_list.push_back( new_index );
+
+             // The snapshot of an index survives resize() but is rebuilt by enable_snapshots() on open
+             if( _snapshots_enabled )
+             {
+                add_snapshot_helper< MultiIndexType >( false );
+             }
+             else
+             {
+#ifndef ENABLE_STD_ALLOCATOR
+                get_segment_manager()->destroy< index_type >( ( type_name + " snapshot" ).c_str() );
+#endif
+                idx_ptr->track_changes( false );
+             }
+         }
+
+         template<typename MultiIndexType>
+         void add_snapshot_helper( bool copy = true ) {
+             const uint16_t type_id = generic_index<MultiIndexType>::value_type::type_id;
+             typedef generic_index<MultiIndexType>          index_type;
+             typedef typename index_type::allocator_type    index_alloc;
+
+             auto& idx = _index_map[ type_id ];
+             if( idx->get_snapshot() == nullptr )
+             {
+                std::string type_name = boost::core::demangle( typeid( typename index_type::value_type ).name() );
+                index_type* snapshot_ptr = nullptr;
+#ifndef ENABLE_STD_ALLOCATOR
+                snapshot_ptr = get_segment_manager()->find_or_construct< index_type >( ( type_name + " snapshot" ).c_str() )( index_alloc( get_segment_manager() ) );
+#else
+                snapshot_ptr = new index_type( index_alloc() );
+#endif
+                idx->set_snapshot( snapshot_ptr );
+             }
+
+             if( copy )
+             {
+                idx->track_changes( true );
+                idx->copy_to_snapshot();
+             }
          }
 
          read_write_mutex_manager                                    _rw_manager;
+         read_write_mutex                                            _snapshot_lock;
+         bool                                                        _snapshots_enabled = false;
+
+         std::map< std::string, std::unique_ptr< lock_group > >      _lock_groups;
+         std::map< uint16_t, lock_group* >                           _index_lock_groups;
+         static thread_local bool                                    _reading_snapshot;
 #ifndef ENABLE_STD_ALLOCATOR
          unique_ptr<bip::managed_mapped_file>                        _segment;
          unique_ptr<bip::managed_mapped_file>                        _meta;
          bip::file_lock                                              _flock;
+
+         unique_ptr<managed_anonymous_buffer>                        _anonymous_segment;
+         void*                                                       _anonymous_base = nullptr;
+         mutable pid_t                                               _image_writer_pid = 0;
+         size_t                                                      _anonymous_size = 0;
 #endif
 
          /**
@@ -1103,6 +1840,9 @@ namespace chainbase {
 
          int32_t                                                     _undo_session_count = 0;
          size_t                                                      _file_size = 0;
+
+         segment_options                                             _segment_options;
+         segment_statistic_info                                      _segment_info;    ///< The options in effect
    };
 
    template<typename Object, typename... Args>
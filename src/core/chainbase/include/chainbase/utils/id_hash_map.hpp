@@ -0,0 +1,190 @@
+#pragma once
+
+#include <chainbase/allocators.hpp>
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace chainbase
+{
+
+namespace detail
+{
+
+template< typename Entry >
+struct id_hash_key_of
+{
+   template< typename K >
+   static const K& get( const K& k ) { return k; }
+};
+
+template< typename K, typename V >
+struct id_hash_key_of< std::pair< K, V > >
+{
+   static const K& get( const std::pair< K, V >& p ) { return p.first; }
+};
+
+/**
+ * Open addressing table of object ids. The entries are stored densely in a vector and the
+ * table only holds their positions, so both live in the segment allocator without a node
+ * allocation per entry. Lookups use linear probing and erase moves the last entry into the
+ * hole, so the iteration order is not the order of the ids.
+ */
+template< typename Key, typename Entry >
+class id_hash_table
+{
+   public:
+      typedef Entry                                            value_type;
+      typedef typename t_vector< Entry >::iterator             iterator;
+      typedef typename t_vector< Entry >::const_iterator       const_iterator;
+
+      template< typename T >
+      id_hash_table( allocator< T > al )
+      :_entries( allocator< Entry >( al ) ), _slots( allocator< uint32_t >( al ) ){}
+
+      iterator       begin()       { return _entries.begin(); }
+      iterator       end()         { return _entries.end(); }
+      const_iterator begin()const  { return _entries.begin(); }
+      const_iterator end()const    { return _entries.end(); }
+
+      size_t size()const  { return _entries.size(); }
+      bool   empty()const { return _entries.empty(); }
+
+      iterator find( const Key& k )
+      {
+         size_t slot = find_slot( k );
+         return _slots.empty() || _slots[ slot ] == empty_slot ? end() : begin() + _slots[ slot ];
+      }
+
+      const_iterator find( const Key& k )const
+      {
+         size_t slot = find_slot( k );
+         return _slots.empty() || _slots[ slot ] == empty_slot ? end() : begin() + _slots[ slot ];
+      }
+
+      size_t count( const Key& k )const { return find( k ) != end(); }
+
+      template< typename... Args >
+      std::pair< iterator, bool > emplace( Args&&... args )
+      {
+         reserve_slot();
+         _entries.emplace_back( std::forward< Args >( args )... );
+
+         size_t slot = find_slot( key_of( _entries.back() ) );
+         if( _slots[ slot ] != empty_slot )
+         {
+            _entries.pop_back();
+            return std::make_pair( begin() + _slots[ slot ], false );
+         }
+
+         _slots[ slot ] = uint32_t( _entries.size() - 1 );
+         return std::make_pair( end() - 1, true );
+      }
+
+      std::pair< iterator, bool > insert( const Entry& e ) { return emplace( e ); }
+
+      size_t erase( const Key& k )
+      {
+         auto itr = find( k );
+         if( itr == end() )
+            return 0;
+
+         erase( itr );
+         return 1;
+      }
+
+      void erase( iterator itr )
+      {
+         size_t pos = itr - begin();
+         erase_slot( find_slot( key_of( *itr ) ) );
+
+         if( pos + 1 != _entries.size() )
+         {
+            _slots[ find_slot( key_of( _entries.back() ) ) ] = uint32_t( pos );
+            _entries[ pos ] = std::move( _entries.back() );
+         }
+
+         _entries.pop_back();
+      }
+
+      void clear()
+      {
+         _entries.clear();
+         _slots.clear();
+      }
+
+   private:
+      static constexpr uint32_t empty_slot = std::numeric_limits< uint32_t >::max();
+
+      static const Key& key_of( const Entry& e ) { return id_hash_key_of< Entry >::get( e ); }
+
+      size_t home( const Key& k )const
+      {
+         // Fibonacci hashing spreads the sequential ids of an index over the table
+         return size_t( ( uint64_t( size_t( k ) ) * 0x9E3779B97F4A7C15ull ) >> ( 64 - _bits ) );
+      }
+
+      /// The slot holding k, or the empty slot where it would be inserted
+      size_t find_slot( const Key& k )const
+      {
+         if( _slots.empty() )
+            return 0;
+
+         size_t mask = _slots.size() - 1;
+         size_t slot = home( k );
+         while( _slots[ slot ] != empty_slot && !( key_of( _entries[ _slots[ slot ] ] ) == k ) )
+            slot = ( slot + 1 ) & mask;
+
+         return slot;
+      }
+
+      /// Removes the slot and shifts the following entries of its probe sequence back
+      void erase_slot( size_t slot )
+      {
+         size_t mask = _slots.size() - 1;
+         size_t next = ( slot + 1 ) & mask;
+
+         while( _slots[ next ] != empty_slot )
+         {
+            size_t h = home( key_of( _entries[ _slots[ next ] ] ) );
+            if( ( ( next - h ) & mask ) >= ( ( next - slot ) & mask ) )
+            {
+               _slots[ slot ] = _slots[ next ];
+               slot = next;
+            }
+            next = ( next + 1 ) & mask;
+         }
+
+         _slots[ slot ] = empty_slot;
+      }
+
+      /// Keeps the load factor at or below one half
+      void reserve_slot()
+      {
+         if( ( _entries.size() + 1 ) * 2 <= _slots.size() )
+            return;
+
+         _bits = _slots.empty() ? 4 : _bits + 1;
+         _slots.assign( size_t( 1 ) << _bits, empty_slot );
+
+         for( size_t i = 0; i < _entries.size(); ++i )
+            _slots[ find_slot( key_of( _entries[ i ] ) ) ] = uint32_t( i );
+      }
+
+      t_vector< Entry >    _entries;
+      t_vector< uint32_t > _slots;
+      uint32_t             _bits = 0;
+};
+
+} // detail
+
+/// Drop in replacement for the bip::map of an undo_state, see detail::id_hash_table
+template< typename Key, typename Value >
+using id_hash_map = detail::id_hash_table< Key, std::pair< Key, Value > >;
+
+/// Drop in replacement for the bip::set of an undo_state, see detail::id_hash_table
+template< typename Key >
+using id_hash_set = detail::id_hash_table< Key, Key >;
+
+} // chainbase
@@ -4,9 +4,15 @@
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/member.hpp>
+#include <boost/multi_index/composite_key.hpp>
 #include <boost/interprocess/exceptions.hpp>
 
+#include <array>
+#include <chrono>
 #include <iostream>
+#include <random>
+#include <string>
+#include <thread>
 
 using namespace chainbase;
 using namespace boost::multi_index;
@@ -36,6 +42,107 @@ typedef multi_index_container<
 
 CHAINBASE_SET_INDEX_TYPE( book, book_index )
 
+/// Same shape as book, but undone through deltas
+struct delta_book : public chainbase::object<1, delta_book> {
+
+   template<typename Constructor, typename Allocator>
+   delta_book( Constructor&& c, Allocator&& a )
+   {
+      c( *this );
+   }
+
+   id_type id;
+   int a = 0;
+   int b = 1;
+   std::array< int64_t, 9 > pages = {};
+};
+
+typedef multi_index_container<
+   delta_book,
+   indexed_by<
+      ordered_unique< member<delta_book,delta_book::id_type,&delta_book::id> >,
+      ordered_non_unique< BOOST_MULTI_INDEX_MEMBER(delta_book,int,a) >,
+      ordered_non_unique< BOOST_MULTI_INDEX_MEMBER(delta_book,int,b) >
+   >,
+   chainbase::allocator<delta_book>
+> delta_book_index;
+
+CHAINBASE_SET_INDEX_TYPE( delta_book, delta_book_index )
+CHAINBASE_SET_UNDO_BY_DELTA( delta_book )
+
+/// Same shape as book plus a string, but with an open addressing undo state
+struct hashed_book : public chainbase::object<2, hashed_book> {
+
+   template<typename Constructor, typename Allocator>
+   hashed_book( Constructor&& c, Allocator&& a )
+   :title( a )
+   {
+      c( *this );
+   }
+
+   id_type        id;
+   int            a = 0;
+   int            b = 1;
+   shared_string  title;
+};
+
+typedef multi_index_container<
+   hashed_book,
+   indexed_by<
+      ordered_unique< member<hashed_book,hashed_book::id_type,&hashed_book::id> >,
+      ordered_non_unique< BOOST_MULTI_INDEX_MEMBER(hashed_book,int,a) >,
+      ordered_non_unique< BOOST_MULTI_INDEX_MEMBER(hashed_book,int,b) >
+   >,
+   chainbase::allocator<hashed_book>
+> hashed_book_index;
+
+CHAINBASE_SET_INDEX_TYPE( hashed_book, hashed_book_index )
+CHAINBASE_SET_HASHED_UNDO( hashed_book )
+
+/// An owner and a name, indexed both by the name and by a hash of it, the way comments are keyed
+struct named_book : public chainbase::object<3, named_book> {
+
+   template<typename Constructor, typename Allocator>
+   named_book( Constructor&& c, Allocator&& a )
+   :name( a )
+   {
+      c( *this );
+   }
+
+   id_type        id;
+   uint64_t       owner = 0;
+   uint64_t       name_hash = 0;
+   shared_string  name;
+};
+
+struct by_name;
+struct by_name_hash;
+
+typedef multi_index_container<
+   named_book,
+   indexed_by<
+      ordered_unique< member<named_book,named_book::id_type,&named_book::id> >,
+      ordered_unique< tag< by_name >,
+         composite_key< named_book,
+            member< named_book, uint64_t, &named_book::owner >,
+            member< named_book, shared_string, &named_book::name >
+         >,
+         composite_key_compare< std::less< uint64_t >, strcmp_less >
+      >,
+      ordered_unique< tag< by_name_hash >,
+         composite_key< named_book,
+            member< named_book, uint64_t, &named_book::owner >,
+            member< named_book, uint64_t, &named_book::name_hash >,
+            member< named_book, shared_string, &named_book::name >
+         >,
+         composite_key_compare< std::less< uint64_t >, std::less< uint64_t >, strcmp_less >
+      >
+   >,
+   chainbase::allocator<named_book>
+> named_book_index;
+
+CHAINBASE_SET_INDEX_TYPE( named_book, named_book_index )
+
 BOOST_AUTO_TEST_SUITE( chainbase_database )
 
 BOOST_AUTO_TEST_CASE( database_open_create_and_undo )
@@ -135,4 +242,719 @@ BOOST_AUTO_TEST_CASE( database_open_create_and_undo )
    }
 }
 
+BOOST_AUTO_TEST_CASE( undo_state_variants )
+{
+   boost::filesystem::path temp = boost::filesystem::unique_path();
+
+   try {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*8 );
+      db.add_index< book_index >();
+      db.add_index< delta_book_index >();
+      db.add_index< hashed_book_index >();
+
+      // Apply the same random changes to a fully copied, a delta undone and a hashed undo state
+      // index and check they agree after every undo, squash and commit.
+      auto check_equal = [&]()
+      {
+         const auto& books = db.get_index< book_index >().indices();
+         const auto& delta_books = db.get_index< delta_book_index >().indices();
+         const auto& hashed_books = db.get_index< hashed_book_index >().indices();
+         BOOST_REQUIRE_EQUAL( books.size(), delta_books.size() );
+         BOOST_REQUIRE_EQUAL( books.size(), hashed_books.size() );
+
+         auto itr = books.begin();
+         auto ditr = delta_books.begin();
+         auto hitr = hashed_books.begin();
+         for( ; itr != books.end(); ++itr, ++ditr, ++hitr )
+         {
+            BOOST_REQUIRE_EQUAL( itr->id._id, hitr->id._id );
+            BOOST_REQUIRE_EQUAL( itr->a, hitr->a );
+            BOOST_REQUIRE_EQUAL( itr->b, hitr->b );
+            BOOST_REQUIRE_EQUAL( std::to_string( itr->b ), hitr->title.c_str() );
+            BOOST_REQUIRE_EQUAL( itr->id._id, ditr->id._id );
+            BOOST_REQUIRE_EQUAL( itr->a, ditr->a );
+            BOOST_REQUIRE_EQUAL( itr->b, ditr->b );
+            BOOST_REQUIRE_EQUAL( itr->b, int( ditr->pages[ ditr->id._id % 9 ] ) );
+         }
+      };
+
+      uint32_t seed = 1;
+      auto next = [&]() { seed = seed * 1103515245 + 12345; return ( seed >> 16 ) & 0x7fff; };
+
+      auto random_change = [&]()
+      {
+         const auto& books = db.get_index< book_index >().indices();
+         uint32_t op = next() % 4;
+
+         if( op == 0 || books.size() < 4 )
+         {
+            int a = next(), b = next();
+            db.create< book >( [&]( book& o ) { o.a = a; o.b = b; } );
+            db.create< delta_book >( [&]( delta_book& o ) { o.a = a; o.b = b; o.pages[ o.id._id % 9 ] = b; } );
+            db.create< hashed_book >( [&]( hashed_book& o ) { o.a = a; o.b = b; o.title = std::to_string( b ).c_str(); } );
+            return;
+         }
+
+         int64_t id = next() % db.get_index< book_index >().indices().rbegin()->id._id;
+         const book* bk = db.find< book >( book::id_type( id ) );
+         const delta_book* dbk = db.find< delta_book >( delta_book::id_type( id ) );
+         const hashed_book* hbk = db.find< hashed_book >( hashed_book::id_type( id ) );
+         BOOST_REQUIRE_EQUAL( bk == nullptr, dbk == nullptr );
+         BOOST_REQUIRE_EQUAL( bk == nullptr, hbk == nullptr );
+         if( bk == nullptr )
+            return;
+
+         if( op == 3 )
+         {
+            db.remove( *bk );
+            db.remove( *dbk );
+            db.remove( *hbk );
+            return;
+         }
+
+         // Alternate between changing a and b so that sessions save different words
+         int v = next();
+         if( op == 1 )
+         {
+            db.modify( *bk, [&]( book& o ) { o.a = v; } );
+            db.modify( *dbk, [&]( delta_book& o ) { o.a = v; } );
+            db.modify( *hbk, [&]( hashed_book& o ) { o.a = v; } );
+         }
+         else
+         {
+            db.modify( *bk, [&]( book& o ) { o.b = v; } );
+            db.modify( *dbk, [&]( delta_book& o ) { o.b = v; o.pages[ o.id._id % 9 ] = v; } );
+            db.modify( *hbk, [&]( hashed_book& o ) { o.b = v; o.title = std::to_string( v ).c_str(); } );
+         }
+      };
+
+      for( int i = 0; i < 16; ++i )
+         random_change();
+
+      for( int round = 0; round < 200; ++round )
+      {
+         auto outer = db.start_undo_session();
+         for( int i = 0; i < 8; ++i )
+            random_change();
+
+         {
+            auto inner = db.start_undo_session();
+            for( int i = 0; i < 8; ++i )
+               random_change();
+
+            if( next() % 2 )
+               inner.squash();
+         }
+         check_equal();
+
+         {
+            auto inner = db.start_undo_session();
+            for( int i = 0; i < 8; ++i )
+               random_change();
+            inner.squash();
+         }
+         check_equal();
+
+         if( next() % 3 )
+         {
+            outer.undo();
+         }
+         else
+         {
+            outer.push();
+            db.commit( db.revision() );
+         }
+         check_equal();
+      }
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+   bfs::remove_all( temp );
+}
+
+BOOST_AUTO_TEST_CASE( snapshot_reads )
+{
+   boost::filesystem::path temp = boost::filesystem::unique_path();
+
+   try {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*8 );
+      db.add_index< book_index >();
+      db.add_index< hashed_book_index >();
+
+      for( int i = 0; i < 10; ++i )
+         db.create< book >( [&]( book& o ) { o.a = 10; o.b = i; } );
+
+      db.enable_snapshots();
+
+      auto snapshot_sum = [&]()
+      {
+         return db.with_snapshot_read( [&]()
+         {
+            int sum = 0;
+            for( const auto& b : db.get_index< book_index >().indices() )
+               sum += b.a;
+            return sum;
+         });
+      };
+
+      BOOST_REQUIRE_EQUAL( snapshot_sum(), 100 );
+
+      {
+         auto session = db.start_undo_session();
+         db.modify( db.get( book::id_type( 1 ) ), [&]( book& o ) { o.a = 20; } );
+         db.remove( db.get( book::id_type( 2 ) ) );
+         db.create< book >( [&]( book& o ) { o.a = 5; } );
+
+         BOOST_TEST_MESSAGE( "Readers do not see unpublished changes" );
+         BOOST_REQUIRE_EQUAL( snapshot_sum(), 100 );
+         BOOST_REQUIRE( db.with_snapshot_read( [&]() { return db.find< book >( book::id_type( 10 ) ) == nullptr; } ) );
+
+         BOOST_REQUIRE( db.publish_snapshot() );
+         BOOST_REQUIRE_EQUAL( snapshot_sum(), 105 );
+         BOOST_REQUIRE_EQUAL( db.with_snapshot_read( [&]() { return db.get( book::id_type( 1 ) ).a; } ), 20 );
+         BOOST_REQUIRE( db.with_snapshot_read( [&]() { return db.find< book >( book::id_type( 2 ) ) == nullptr; } ) );
+      }
+
+      BOOST_TEST_MESSAGE( "Undone changes are published as well" );
+      BOOST_REQUIRE( db.publish_snapshot() );
+      BOOST_REQUIRE_EQUAL( snapshot_sum(), 100 );
+      BOOST_REQUIRE_EQUAL( db.with_snapshot_read( [&]() { return db.get( book::id_type( 2 ) ).b; } ), 2 );
+      BOOST_REQUIRE_EQUAL( db.get_index< book_index >().indices().size(), db.with_snapshot_read( [&]() { return db.get_index< book_index >().indices().size(); } ) );
+
+      BOOST_TEST_MESSAGE( "Readers see consistent states while the writer proceeds" );
+      std::atomic< bool > done( false );
+      std::atomic< int > bad_reads( 0 );
+      std::thread reader( [&]()
+      {
+         while( !done )
+            if( snapshot_sum() != 100 )
+               ++bad_reads;
+      });
+
+      for( int i = 0; i < 2000; ++i )
+      {
+         // Moves one unit between two books, the sum only holds once both are modified
+         db.modify( db.get( book::id_type( i % 10 ) ), [&]( book& o ) { o.a -= 1; } );
+         db.modify( db.get( book::id_type( ( i + 1 ) % 10 ) ), [&]( book& o ) { o.a += 1; } );
+         db.publish_snapshot();
+      }
+
+      done = true;
+      reader.join();
+      BOOST_REQUIRE_EQUAL( bad_reads.load(), 0 );
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+   bfs::remove_all( temp );
+}
+
+BOOST_AUTO_TEST_CASE( snapshot_resize )
+{
+   boost::filesystem::path temp = boost::filesystem::unique_path();
+
+   try {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*8 );
+      db.add_index< book_index >();
+
+      for( int i = 0; i < 10; ++i )
+         db.create< book >( [&]( book& o ) { o.a = 10; o.b = i; } );
+
+      db.enable_snapshots();
+
+      auto sum_books = [&]()
+      {
+         int sum = 0;
+         for( const auto& b : db.get_index< book_index >().indices() )
+            sum += b.a;
+         return sum;
+      };
+
+      auto snapshot_sum = [&]()
+      {
+         return db.with_snapshot_read( [&]() { return sum_books(); } );
+      };
+
+      BOOST_TEST_MESSAGE( "Resizing waits for the snapshot reader" );
+      std::atomic< bool > reading( false );
+      std::atomic< bool > read_done( false );
+      int read_sum = 0;
+      std::thread reader( [&]()
+      {
+         db.with_snapshot_read( [&]()
+         {
+            reading = true;
+            std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+            read_sum = sum_books();
+            read_done = true;
+         });
+      });
+
+      while( !reading )
+         std::this_thread::yield();
+
+      db.resize( 1024*1024*16 );
+      BOOST_REQUIRE( read_done );
+      reader.join();
+      BOOST_REQUIRE_EQUAL( read_sum, 100 );
+
+      BOOST_TEST_MESSAGE( "The snapshot is found again in the resized segment" );
+      BOOST_REQUIRE_EQUAL( snapshot_sum(), 100 );
+
+      db.modify( db.get( book::id_type( 1 ) ), [&]( book& o ) { o.a = 20; } );
+      BOOST_REQUIRE_EQUAL( snapshot_sum(), 100 );
+      BOOST_REQUIRE( db.publish_snapshot() );
+      BOOST_REQUIRE_EQUAL( snapshot_sum(), 110 );
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+   bfs::remove_all( temp );
+}
+
+BOOST_AUTO_TEST_CASE( lock_groups )
+{
+   boost::filesystem::path temp = boost::filesystem::unique_path();
+
+   try {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*8 );
+      db.set_lock_group< hashed_book_index >( "hashed_books" );
+      db.add_index< book_index >();
+      db.add_index< hashed_book_index >();
+
+      db.create< hashed_book >( [&]( hashed_book& o ) { o.a = 1; } );
+
+      BOOST_REQUIRE_THROW( db.with_read_lock( "books", [&]() {} ), std::runtime_error );
+
+      db.with_write_lock( [&]()
+      {
+         auto session = db.start_undo_session();
+         db.modify( db.get( hashed_book::id_type( 0 ) ), [&]( hashed_book& o ) { o.a = 2; } );
+         db.create< book >( [&]( book& o ) { o.a = 1; } );
+
+         BOOST_TEST_MESSAGE( "Readers of a lock group do not wait for the database write lock" );
+         bool group_read = false;
+         bool database_read = false;
+         std::thread reader( [&]()
+         {
+            group_read = db.with_read_lock( "hashed_books", [&]() { return db.get( hashed_book::id_type( 0 ) ).a == 2; }, 100000 );
+            try
+            {
+               db.with_read_lock( [&]() {}, 100000 );
+               database_read = true;
+            }
+            catch( const chainbase::lock_exception& ) {}
+         });
+         reader.join();
+
+         BOOST_REQUIRE( group_read );
+         BOOST_REQUIRE( !database_read );
+
+         BOOST_TEST_MESSAGE( "Undo takes the lock group" );
+         session.undo();
+         BOOST_REQUIRE_EQUAL( db.with_read_lock( "hashed_books", [&]() { return db.get( hashed_book::id_type( 0 ) ).a; } ), 1 );
+
+         BOOST_TEST_MESSAGE( "Writes undone while the lock groups are held are never seen by their readers" );
+         {
+            auto hold = db.hold_lock_groups();
+            auto temp_session = db.start_undo_session();
+            db.modify( db.get( hashed_book::id_type( 0 ) ), [&]( hashed_book& o ) { o.a = 3; } );
+
+            bool blocked = false;
+            std::thread reader( [&]()
+            {
+               try
+               {
+                  db.with_read_lock( "hashed_books", [&]() {}, 100000 );
+               }
+               catch( const chainbase::lock_exception& )
+               {
+                  blocked = true;
+               }
+            });
+            reader.join();
+
+            BOOST_REQUIRE( blocked );
+         }
+         BOOST_REQUIRE_EQUAL( db.with_read_lock( "hashed_books", [&]() { return db.get( hashed_book::id_type( 0 ) ).a; } ), 1 );
+      });
+
+      BOOST_TEST_MESSAGE( "Resizing waits for the readers of a lock group" );
+      std::atomic< bool > reading( false );
+      std::atomic< bool > read_done( false );
+      int read_a = 0;
+      std::thread reader( [&]()
+      {
+         db.with_read_lock( "hashed_books", [&]()
+         {
+            reading = true;
+            std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+            read_a = db.get( hashed_book::id_type( 0 ) ).a;
+            read_done = true;
+         });
+      });
+
+      while( !reading )
+         std::this_thread::yield();
+
+      db.resize( 1024*1024*16 );
+      BOOST_REQUIRE( read_done );
+      reader.join();
+      BOOST_REQUIRE_EQUAL( read_a, 1 );
+      BOOST_REQUIRE_EQUAL( db.with_read_lock( "hashed_books", [&]() { return db.get( hashed_book::id_type( 0 ) ).a; } ), 1 );
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+   bfs::remove_all( temp );
+}
+
+BOOST_AUTO_TEST_CASE( segment_statistics )
+{
+   boost::filesystem::path temp = boost::filesystem::unique_path();
+
+   try {
+      chainbase::database db;
+      chainbase::segment_options options;
+      options.random_access = true;
+      options.prefault = true;
+      db.set_segment_options( options );
+      db.open( temp, 0, 1024*1024*8 );
+      db.add_index< book_index >();
+
+      auto info = db.get_segment_statistics();
+      BOOST_REQUIRE_EQUAL( info.file_size, 1024*1024*8 );
+      BOOST_REQUIRE_EQUAL( info.free_memory, db.get_free_memory() );
+#ifdef __linux__
+      BOOST_REQUIRE( info.page_size > 0 );
+      BOOST_REQUIRE( info.random_access );
+      BOOST_REQUIRE( info.prefault );
+#endif
+      BOOST_REQUIRE( !info.transparent_huge_pages );
+      BOOST_REQUIRE( info.numa_policy == chainbase::segment_options::numa_default );
+
+      BOOST_TEST_MESSAGE( "Options are applied again on resize" );
+      db.resize( 1024*1024*16 );
+      info = db.get_segment_statistics();
+      BOOST_REQUIRE_EQUAL( info.file_size, 1024*1024*16 );
+#ifdef __linux__
+      BOOST_REQUIRE( info.random_access );
+#endif
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+   bfs::remove_all( temp );
+}
+
+BOOST_AUTO_TEST_CASE( segment_fragmentation )
+{
+   boost::filesystem::path temp = boost::filesystem::unique_path();
+
+   try {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*8 );
+      db.add_index< book_index >();
+
+      std::vector< const book* > books;
+      for( int i = 0; i < 1000; ++i )
+         books.push_back( &db.create< book >( [i]( book& b ) { b.a = i; } ) );
+
+      for( size_t i = 0; i < books.size(); i += 2 )
+         db.remove( *books[i] );
+
+      auto free_memory = db.get_free_memory();
+      auto info = db.get_segment_fragmentation();
+
+      BOOST_TEST_MESSAGE( "The probe returns every block it took" );
+      BOOST_REQUIRE_EQUAL( db.get_free_memory(), free_memory );
+      BOOST_REQUIRE_EQUAL( info.free_memory, free_memory );
+
+      BOOST_TEST_MESSAGE( "Removing every other book leaves holes behind" );
+      BOOST_REQUIRE( info.free_block_count > 1 );
+      BOOST_REQUIRE( info.largest_free_block < free_memory );
+
+      size_t counted = 0;
+      for( size_t count : info.free_block_histogram )
+         counted += count;
+      BOOST_REQUIRE_EQUAL( counted, info.free_block_count );
+      BOOST_REQUIRE_EQUAL( info.free_block_histogram.size(), 64 - __builtin_clzll( info.largest_free_block ) );
+
+      BOOST_REQUIRE_EQUAL( db.get_segment_fragmentation().free_block_count, info.free_block_count );
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+   bfs::remove_all( temp );
+}
+
+BOOST_AUTO_TEST_CASE( anonymous_segment )
+{
+   boost::filesystem::path temp = boost::filesystem::unique_path();
+
+   try {
+      chainbase::segment_options options;
+      options.anonymous = true;
+
+      {
+         chainbase::database db;
+         db.set_segment_options( options );
+         db.open( temp, 0, 1024*1024*8 );
+         db.add_index< book_index >();
+         BOOST_REQUIRE( !bfs::exists( temp / "shared_memory.bin" ) );
+         BOOST_REQUIRE( db.get_segment_statistics().anonymous );
+
+         for( int i = 0; i < 100; ++i )
+            db.create< book >( [&]( book& b ) { b.a = i; b.b = -i; } );
+
+         BOOST_TEST_MESSAGE( "Flushing writes the image" );
+         db.flush();
+         BOOST_REQUIRE_EQUAL( bfs::file_size( temp / "shared_memory.image" ), 1024*1024*8 );
+
+         BOOST_TEST_MESSAGE( "Resizing keeps the objects" );
+         db.resize( 1024*1024*16 );
+         BOOST_REQUIRE_EQUAL( db.get_segment_statistics().file_size, 1024*1024*16 );
+         BOOST_REQUIRE_EQUAL( db.get< book >( book::id_type( 42 ) ).a, 42 );
+
+         BOOST_TEST_MESSAGE( "A background image holds the state as of the fork" );
+         BOOST_REQUIRE( db.flush_in_background() );
+         db.modify( db.get< book >( book::id_type( 42 ) ), [&]( book& b ) { b.b = 0; } );
+         db.wait_for_background_flush();
+
+         auto copy = boost::filesystem::unique_path();
+         bfs::create_directories( copy );
+         bfs::copy_file( temp / "shared_memory.image", copy / "shared_memory.image" );
+         {
+            chainbase::database image_db;
+            image_db.set_segment_options( options );
+            image_db.open( copy, 0, 1024*1024*8 );
+            image_db.add_index< book_index >();
+            BOOST_REQUIRE_EQUAL( image_db.get< book >( book::id_type( 42 ) ).b, -42 );
+            image_db.wipe( copy );
+         }
+         bfs::remove_all( copy );
+
+         db.modify( db.get< book >( book::id_type( 42 ) ), [&]( book& b ) { b.b = -42; } );
+         db.create< book >( [&]( book& b ) { b.a = 100; b.b = -100; } );
+         db.close();
+      }
+
+      BOOST_TEST_MESSAGE( "Closing saves the image and opening loads it" );
+      {
+         chainbase::database db;
+         db.set_segment_options( options );
+         db.open( temp, 0, 1024*1024*8 );
+         db.add_index< book_index >();
+
+         BOOST_REQUIRE_EQUAL( db.get_segment_statistics().file_size, 1024*1024*16 );
+         const auto& idx = db.get_index< book_index >().indices();
+         BOOST_REQUIRE_EQUAL( idx.size(), 101 );
+         for( const auto& b : idx )
+            BOOST_REQUIRE_EQUAL( b.b, -b.a );
+
+         db.create< book >( [&]( book& b ) { b.a = 101; } );
+         db.wipe( temp );
+         BOOST_REQUIRE( !bfs::exists( temp / "shared_memory.image" ) );
+      }
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+   bfs::remove_all( temp );
+}
+
+BOOST_AUTO_TEST_CASE( restore_objects )
+{
+   boost::filesystem::path temp = boost::filesystem::unique_path();
+
+   try {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*8 );
+      db.add_index< book_index >();
+      auto& idx = db.get_mutable_index< book_index >();
+
+      BOOST_TEST_MESSAGE( "Restoring keeps the ids set by the constructor" );
+      for( int i : { 4, 2, 7 } )
+         idx.restore( [&]( book& b ) { b.id = i; b.a = i; } );
+
+      BOOST_REQUIRE_EQUAL( db.get( book::id_type( 7 ) ).a, 7 );
+      BOOST_REQUIRE_EQUAL( idx.next_id()._id, 8 );
+
+      BOOST_CHECK_THROW( idx.restore( [&]( book& b ) { b.id = 2; } ), std::logic_error );
+      BOOST_CHECK_THROW( idx.set_next_id( 5 ), std::logic_error );
+
+      idx.set_next_id( 10 );
+      BOOST_REQUIRE_EQUAL( db.create< book >( []( book& ) {} ).id._id, 10 );
+
+      BOOST_TEST_MESSAGE( "Restoring is not undoable" );
+      auto session = db.start_undo_session();
+      BOOST_CHECK_THROW( idx.restore( [&]( book& b ) { b.id = 20; } ), std::logic_error );
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+   bfs::remove_all( temp );
+}
+
+BOOST_AUTO_TEST_CASE( bulk_create )
+{
+   boost::filesystem::path temp = boost::filesystem::unique_path();
+
+   try {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*8 );
+      db.add_index< book_index >();
+      const auto& by_a = db.get_index< book_index >().indices().get< 1 >();
+
+      db.create< book >( []( book& b ) { b.a = -1; } );
+      db.bulk_create< book >( 100, [&]( book& b, size_t i ) { b.a = 100 - i; b.b = i; } );
+
+      BOOST_REQUIRE_EQUAL( db.get_index< book_index >().indices().size(), 101u );
+      BOOST_REQUIRE_EQUAL( db.get( book::id_type( 1 ) ).a, 100 );
+      BOOST_REQUIRE_EQUAL( db.get( book::id_type( 100 ) ).b, 99 );
+      BOOST_REQUIRE_EQUAL( by_a.begin()->a, -1 );
+      BOOST_REQUIRE_EQUAL( by_a.rbegin()->id._id, 1 );
+      BOOST_REQUIRE_EQUAL( db.create< book >( []( book& ) {} ).id._id, 101 );
+
+      BOOST_TEST_MESSAGE( "Bulk inserts are undone with the session" );
+      {
+         auto session = db.start_undo_session();
+         db.bulk_create< book >( 10, [&]( book& b, size_t i ) { b.a = 200 + i; } );
+         BOOST_REQUIRE_EQUAL( db.get_index< book_index >().indices().size(), 112u );
+      }
+      BOOST_REQUIRE_EQUAL( db.get_index< book_index >().indices().size(), 102u );
+      BOOST_REQUIRE_EQUAL( db.create< book >( []( book& ) {} ).id._id, 102 );
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+   bfs::remove_all( temp );
+}
+
+BOOST_AUTO_TEST_CASE( undo_state_benchmark )
+{
+   boost::filesystem::path temp = boost::filesystem::unique_path();
+
+   try {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*64 );
+      db.add_index< book_index >();
+      db.add_index< hashed_book_index >();
+
+      const int num_objects = 10000;
+      for( int i = 0; i < num_objects; ++i )
+      {
+         db.create< book >( [&]( book& o ) { o.a = i; } );
+         db.create< hashed_book >( [&]( hashed_book& o ) { o.a = i; } );
+      }
+
+      // A pending transaction session touching every object a few times, the way
+      // _push_transaction does, followed by creating and removing objects and an undo.
+      auto run = [&]( auto* tag ) -> int64_t
+      {
+         typedef typename std::remove_pointer< decltype( tag ) >::type object_type;
+         auto start = std::chrono::steady_clock::now();
+
+         for( int pass = 0; pass < 3; ++pass )
+         {
+            auto session = db.start_undo_session();
+            for( int round = 0; round < 3; ++round )
+               for( int i = 0; i < num_objects; i += 2 )
+                  db.modify( db.get< object_type >( typename object_type::id_type( i ) ), [&]( object_type& o ) { o.b = round; } );
+
+            for( int i = 0; i < num_objects / 10; ++i )
+               db.create< object_type >( [&]( object_type& o ) { o.a = -i; } );
+
+            for( int i = 1; i < num_objects; i += 10 )
+               db.remove( db.get< object_type >( typename object_type::id_type( i ) ) );
+
+            session.undo();
+         }
+
+         return std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now() - start ).count();
+      };
+
+      int64_t map_us = run( (book*)nullptr );
+      int64_t hashed_us = run( (hashed_book*)nullptr );
+      BOOST_TEST_MESSAGE( "map undo state: " << map_us << "us, hashed undo state: " << hashed_us << "us" );
+
+      BOOST_REQUIRE_EQUAL( db.get_index< book_index >().indices().size(), size_t( num_objects ) );
+      BOOST_REQUIRE_EQUAL( db.get_index< hashed_book_index >().indices().size(), size_t( num_objects ) );
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+   bfs::remove_all( temp );
+}
+
+
+BOOST_AUTO_TEST_CASE( string_key_benchmark )
+{
+   boost::filesystem::path temp = boost::filesystem::unique_path();
+
+   try {
+      chainbase::database db;
+      db.open( temp, 0, 1024*1024*64 );
+      db.add_index< named_book_index >();
+
+      // Names shaped like permlinks, replies share a long "re-" prefix with each other
+      const int num_owners = 100;
+      const int names_per_owner = 1000;
+      std::hash< std::string > hash;
+      std::vector< std::pair< uint64_t, std::string > > keys;
+
+      for( int owner = 0; owner < num_owners; ++owner )
+      {
+         for( int i = 0; i < names_per_owner; ++i )
+         {
+            std::string name = i % 2 ?
+               "re-author" + std::to_string( ( owner + i ) % num_owners ) + "-a-fairly-long-post-title-" + std::to_string( i / 2 ) + "-20180323t120000000z" :
+               "a-fairly-long-post-title-" + std::to_string( i / 2 );
+
+            db.create< named_book >( [&]( named_book& o )
+            {
+               o.owner = owner;
+               o.name_hash = hash( name );
+               o.name.assign( name.begin(), name.end() );
+            });
+            keys.emplace_back( owner, name );
+         }
+      }
+
+      std::mt19937 rng( 42 );
+      std::shuffle( keys.begin(), keys.end(), rng );
+
+      const auto& name_idx = db.get_index< named_book_index, by_name >();
+      const auto& hash_idx = db.get_index< named_book_index, by_name_hash >();
+      size_t found_by_name = 0;
+      size_t found_by_hash = 0;
+
+      auto start = std::chrono::steady_clock::now();
+      for( int pass = 0; pass < 5; ++pass )
+         for( const auto& key : keys )
+            found_by_name += name_idx.find( boost::make_tuple( key.first, key.second ) ) != name_idx.end();
+      auto name_us = std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now() - start ).count();
+
+      start = std::chrono::steady_clock::now();
+      for( int pass = 0; pass < 5; ++pass )
+         for( const auto& key : keys )
+            found_by_hash += hash_idx.find( boost::make_tuple( key.first, hash( key.second ), key.second ) ) != hash_idx.end();
+      auto hash_us = std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now() - start ).count();
+
+      BOOST_TEST_MESSAGE( "owner and name lookups: " << name_us << "us, owner, name hash and name lookups: " << hash_us << "us" );
+
+      BOOST_REQUIRE_EQUAL( found_by_name, keys.size() * 5 );
+      BOOST_REQUIRE_EQUAL( found_by_hash, keys.size() * 5 );
+   } catch ( ... ) {
+      bfs::remove_all( temp );
+      throw;
+   }
+   bfs::remove_all( temp );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
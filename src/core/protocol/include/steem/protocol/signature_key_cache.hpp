@@ -0,0 +1,73 @@
+#pragma once
+
+#include <steem/protocol/types.hpp>
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace steem { namespace protocol {
+
+/**
+ * Bounded, thread safe LRU of public keys recovered from compact signatures, keyed by
+ * (signature digest, signature).
+ *
+ * The same transaction is recovered several times during its lifetime: when it arrives
+ * from a peer, when it is applied to the pending state, when the pending state is restored
+ * after a block and finally when it is applied as part of a block. The cache turns every
+ * recovery after the first into a hash lookup.
+ */
+class signature_key_cache
+{
+   public:
+      explicit signature_key_cache( size_t max_size = default_max_size );
+
+      static constexpr size_t default_max_size = 1 << 16;
+
+      /// The process wide cache used by signed_transaction::get_signature_keys()
+      static signature_key_cache& instance();
+
+      /**
+       * Returns the keys of sigs over digest, in the same order as sigs. Cached keys are looked up
+       * under a single lock and the remaining signatures are recovered one by one outside of it.
+       */
+      vector< public_key_type > recover( const digest_type& digest, const vector< signature_type >& sigs );
+
+      void     set_max_size( size_t max_size );
+      size_t   max_size()const;
+      size_t   size()const;
+      uint64_t hits()const;
+      uint64_t misses()const;
+      void     clear();
+
+   private:
+      struct cache_key
+      {
+         digest_type    digest;
+         signature_type sig;
+
+         bool operator == ( const cache_key& other )const
+         {
+            return digest == other.digest && sig == other.sig;
+         }
+      };
+
+      struct cache_key_hash
+      {
+         size_t operator()( const cache_key& k )const;
+      };
+
+      typedef std::list< std::pair< cache_key, public_key_type > >                       lru_list_type;
+      typedef std::unordered_map< cache_key, lru_list_type::iterator, cache_key_hash >   lru_index_type;
+
+      void insert_locked( cache_key&& key, const public_key_type& pub_key );
+
+      mutable std::mutex   _mutex;
+      lru_list_type        _lru;
+      lru_index_type       _index;
+      size_t               _max_size = default_max_size;
+      uint64_t             _hits = 0;
+      uint64_t             _misses = 0;
+};
+
+} } // steem::protocol
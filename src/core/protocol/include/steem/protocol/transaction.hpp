@@ -78,6 +78,20 @@ namespace steem { namespace protocol {
          uint32_t max_account_auths = STEEM_MAX_SIG_CHECK_ACCOUNTS
          )const;
 
+      /**
+       * Same as above, but checks the authorities against an already recovered
+       * set of signature keys (see get_signature_keys) instead of recovering them.
+       */
+      void verify_authority(
+         const flat_set<public_key_type>& sigs,
+         const authority_getter& get_active,
+         const authority_getter& get_owner,
+         const authority_getter& get_posting,
+         uint32_t max_recursion/* = STEEM_MAX_SIG_CHECK_DEPTH*/,
+         uint32_t max_membership = STEEM_MAX_AUTHORITY_MEMBERSHIP,
+         uint32_t max_account_auths = STEEM_MAX_SIG_CHECK_ACCOUNTS
+         )const;
+
       set<public_key_type> minimize_required_signatures(
          const chain_id_type& chain_id,
          const flat_set<public_key_type>& available_keys,
@@ -0,0 +1,126 @@
+#include <steem/protocol/signature_key_cache.hpp>
+
+#include <cstring>
+
+namespace steem { namespace protocol {
+
+size_t signature_key_cache::cache_key_hash::operator()( const cache_key& k )const
+{
+   // The digest is a sha256 and the signature contains a uniformly distributed r value,
+   // so mixing a word of each is enough.
+   uint64_t r;
+   std::memcpy( &r, k.sig.begin() + 1, sizeof( r ) );
+   return size_t( k.digest._hash[0] ^ r );
+}
+
+signature_key_cache::signature_key_cache( size_t max_size ) : _max_size( max_size ) {}
+
+signature_key_cache& signature_key_cache::instance()
+{
+   static signature_key_cache cache;
+   return cache;
+}
+
+vector< public_key_type > signature_key_cache::recover( const digest_type& digest, const vector< signature_type >& sigs )
+{
+   vector< public_key_type > result( sigs.size() );
+   vector< size_t > missing;
+   vector< signature_type > missing_sigs;
+
+   {
+      std::lock_guard< std::mutex > guard( _mutex );
+
+      for( size_t i = 0; i < sigs.size(); ++i )
+      {
+         auto itr = _index.find( cache_key{ digest, sigs[i] } );
+         if( itr == _index.end() )
+         {
+            missing.push_back( i );
+            missing_sigs.push_back( sigs[i] );
+            continue;
+         }
+
+         // Move the entry to the front of the LRU
+         _lru.splice( _lru.begin(), _lru, itr->second );
+         result[i] = itr->second->second;
+      }
+
+      _hits += sigs.size() - missing.size();
+      _misses += missing.size();
+   }
+
+   if( missing.empty() )
+      return result;
+
+   for( size_t i = 0; i < missing.size(); ++i )
+      result[ missing[i] ] = fc::ecc::public_key( missing_sigs[i], digest );
+
+   std::lock_guard< std::mutex > guard( _mutex );
+
+   for( size_t i = 0; i < missing.size(); ++i )
+      insert_locked( cache_key{ digest, missing_sigs[i] }, result[ missing[i] ] );
+
+   return result;
+}
+
+void signature_key_cache::insert_locked( cache_key&& key, const public_key_type& pub_key )
+{
+   if( _max_size == 0 || _index.count( key ) )
+      return;
+
+   _lru.emplace_front( std::move( key ), pub_key );
+   _index.emplace( _lru.front().first, _lru.begin() );
+
+   while( _lru.size() > _max_size )
+   {
+      _index.erase( _lru.back().first );
+      _lru.pop_back();
+   }
+}
+
+void signature_key_cache::set_max_size( size_t max_size )
+{
+   std::lock_guard< std::mutex > guard( _mutex );
+   _max_size = max_size;
+
+   while( _lru.size() > _max_size )
+   {
+      _index.erase( _lru.back().first );
+      _lru.pop_back();
+   }
+}
+
+size_t signature_key_cache::max_size()const
+{
+   std::lock_guard< std::mutex > guard( _mutex );
+   return _max_size;
+}
+
+size_t signature_key_cache::size()const
+{
+   std::lock_guard< std::mutex > guard( _mutex );
+   return _lru.size();
+}
+
+uint64_t signature_key_cache::hits()const
+{
+   std::lock_guard< std::mutex > guard( _mutex );
+   return _hits;
+}
+
+uint64_t signature_key_cache::misses()const
+{
+   std::lock_guard< std::mutex > guard( _mutex );
+   return _misses;
+}
+
+void signature_key_cache::clear()
+{
+   std::lock_guard< std::mutex > guard( _mutex );
+   _lru.clear();
+   _index.clear();
+   _hits = 0;
+   _misses = 0;
+}
+
+} } // steem::protocol
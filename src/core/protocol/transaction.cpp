@@ -1,4 +1,5 @@
 
+#include <steem/protocol/signature_key_cache.hpp>
 #include <steem/protocol/transaction.hpp>
 #include <steem/protocol/transaction_util.hpp>
 
@@ -86,10 +87,10 @@ flat_set<public_key_type> signed_transaction::get_signature_keys( const chain_id
 { try {
    auto d = sig_digest( chain_id );
    flat_set<public_key_type> result;
-   for( const auto&  sig : signatures )
+   for( const auto& key : signature_key_cache::instance().recover( d, signatures ) )
    {
       STEEM_ASSERT(
-         result.insert( fc::ecc::public_key(sig,d) ).second,
+         result.insert( key ).second,
          tx_duplicate_sig,
          "Duplicate Signature detected" );
    }
@@ -211,10 +212,29 @@ void signed_transaction::verify_authority(
    uint32_t max_recursion,
    uint32_t max_membership,
    uint32_t max_account_auths )const
+{
+   verify_authority(
+      get_signature_keys( chain_id ),
+      get_active,
+      get_owner,
+      get_posting,
+      max_recursion,
+      max_membership,
+      max_account_auths );
+}
+
+void signed_transaction::verify_authority(
+   const flat_set<public_key_type>& sigs,
+   const authority_getter& get_active,
+   const authority_getter& get_owner,
+   const authority_getter& get_posting,
+   uint32_t max_recursion,
+   uint32_t max_membership,
+   uint32_t max_account_auths )const
 { try {
    steem::protocol::verify_authority(
       operations,
-      get_signature_keys( chain_id ),
+      sigs,
       get_active,
       get_owner,
       get_posting,
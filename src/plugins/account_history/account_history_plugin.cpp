@@ -48,66 +48,74 @@ class account_history_plugin_impl
 
 struct operation_visitor
 {
-   operation_visitor( database& db, const operation_notification& note, const operation_object*& n, account_name_type i, bool prune )
-      :_db(db), _note(note), new_obj(n), item(i), _prune(prune) {}
+   operation_visitor( database& db, const operation_notification& note, const vector< account_name_type >& i, bool prune )
+      :_db(db), _note(note), items(i), _prune(prune) {}
 
    typedef void result_type;
 
    database& _db;
    const operation_notification& _note;
-   const operation_object*& new_obj;
-   account_name_type item;
+   const vector< account_name_type >& items;
    bool _prune;
 
    template<typename Op>
    void operator()( Op&& )const
    {
       const auto& hist_idx = _db.get_index< chain::account_history_index >().indices().get< chain::by_account >();
-      if( !new_obj )
+      const auto& new_obj = _db.create<operation_object>( [&]( operation_object& obj )
       {
-         new_obj = &_db.create<operation_object>( [&]( operation_object& obj )
-         {
-            obj.trx_id       = _note.trx_id;
-            obj.block        = _note.block;
-            obj.trx_in_block = _note.trx_in_block;
-            obj.op_in_trx    = _note.op_in_trx;
-            obj.virtual_op   = _note.virtual_op;
-            obj.timestamp    = _db.head_block_time();
-            //fc::raw::pack( obj.serialized_op , _note.op);  //call to 'pack' is ambiguous
-            auto size = fc::raw::pack_size( _note.op );
-            obj.serialized_op.resize( size );
-            fc::datastream< char* > ds( obj.serialized_op.data(), size );
-            fc::raw::pack( ds, _note.op );
-         });
-      }
+         obj.trx_id       = _note.trx_id;
+         obj.block        = _note.block;
+         obj.trx_in_block = _note.trx_in_block;
+         obj.op_in_trx    = _note.op_in_trx;
+         obj.virtual_op   = _note.virtual_op;
+         obj.timestamp    = _db.head_block_time();
+         //fc::raw::pack( obj.serialized_op , _note.op);  //call to 'pack' is ambiguous
+         auto size = fc::raw::pack_size( _note.op );
+         obj.serialized_op.resize( size );
+         fc::datastream< char* > ds( obj.serialized_op.data(), size );
+         fc::raw::pack( ds, _note.op );
+      });
 
-      auto hist_itr = hist_idx.lower_bound( boost::make_tuple( item, uint32_t(-1) ) );
-      uint32_t sequence = 1;
-      if( hist_itr != hist_idx.end() && hist_itr->account == item )
-         sequence = hist_itr->sequence + 1;
+      // The impacted accounts are distinct, so every sequence can be looked up before any entry is added
+      vector< uint32_t > sequences;
+      sequences.reserve( items.size() );
+
+      for( const auto& item : items )
+      {
+         auto hist_itr = hist_idx.lower_bound( boost::make_tuple( item, uint32_t(-1) ) );
+         uint32_t sequence = 1;
+         if( hist_itr != hist_idx.end() && hist_itr->account == item )
+            sequence = hist_itr->sequence + 1;
+         sequences.push_back( sequence );
+      }
 
-      _db.create< chain::account_history_object >( [&]( chain::account_history_object& ahist )
+      _db.bulk_create< chain::account_history_object >( items.size(), [&]( chain::account_history_object& ahist, size_t i )
       {
-         ahist.account  = item;
-         ahist.sequence = sequence;
-         ahist.op       = new_obj->id;
+         ahist.account  = items[i];
+         ahist.sequence = sequences[i];
+         ahist.op       = new_obj.id;
       });
 
-      if( _prune )
+      if( !_prune )
+         return;
+
+      for( size_t i = 0; i < items.size(); ++i )
       {
          // Clean up accounts to last 30 days or 30 items, whichever is more.
+         const auto& item = items[i];
          const auto& seq_idx = _db.get_index< chain::account_history_index, chain::by_account >();
          auto seq_itr = seq_idx.lower_bound( boost::make_tuple( item, 0 ) );
          vector< const chain::account_history_object* > to_remove;
          auto now = _db.head_block_time();
 
          if( seq_itr == seq_idx.begin() )
-            return;
+            continue;
 
          --seq_itr;
 
          while( seq_itr->account == item
-               && sequence - seq_itr->sequence > 30
+               && sequences[i] - seq_itr->sequence > 30
                && now - _db.get< chain::operation_object >( seq_itr->op ).timestamp > fc::days(30) )
          {
             to_remove.push_back( &(*seq_itr) );
@@ -124,8 +132,8 @@ struct operation_visitor
 
 struct operation_visitor_filter : operation_visitor
 {
-   operation_visitor_filter( database& db, const operation_notification& note, const operation_object*& n, account_name_type i, const flat_set< string >& filter, bool p, bool blacklist ):
-      operation_visitor( db, note, n, i, p ), _filter( filter ), _blacklist( blacklist ) {}
+   operation_visitor_filter( database& db, const operation_notification& note, const vector< account_name_type >& i, const flat_set< string >& filter, bool p, bool blacklist ):
+      operation_visitor( db, note, i, p ), _filter( filter ), _blacklist( blacklist ) {}
 
    const flat_set< string >& _filter;
    bool _blacklist;
@@ -149,9 +157,10 @@ struct operation_visitor_filter : operation_visitor
 void account_history_plugin_impl::on_pre_apply_operation( const operation_notification& note )
 {
    flat_set<account_name_type> impacted;
+   vector< account_name_type > tracked;
 
-   const operation_object* new_obj = nullptr;
    app::operation_get_impacted_accounts( note.op, impacted );
+   tracked.reserve( impacted.size() );
 
    for( const auto& item : impacted ) {
       auto itr = _tracked_accounts.lower_bound( item );
@@ -182,16 +191,19 @@ void account_history_plugin_impl::on_pre_apply_operation( const operation_notifi
       }
 
       if( !_tracked_accounts.size() || (itr != _tracked_accounts.end() && itr->first <= item && item <= itr->second ) )
-      {
-         if(_filter_content)
-         {
-            note.op.visit( operation_visitor_filter( _db, note, new_obj, item, _op_list, _prune, _blacklist ) );
-         }
-         else
-         {
-            note.op.visit( operation_visitor( _db, note, new_obj, item, _prune ) );
-         }
-      }
+         tracked.push_back( item );
+   }
+
+   if( tracked.empty() )
+      return;
+
+   if(_filter_content)
+   {
+      note.op.visit( operation_visitor_filter( _db, note, tracked, _op_list, _prune, _blacklist ) );
+   }
+   else
+   {
+      note.op.visit( operation_visitor( _db, note, tracked, _prune ) );
    }
 }
 
@@ -16,6 +16,7 @@ class block_api_impl
       DECLARE_API_IMPL(
          (get_block_header)
          (get_block)
+         (get_block_range)
       )
 
       chain::database& _db;
@@ -68,9 +69,29 @@ DEFINE_API_IMPL( block_api_impl, get_block )
    return result;
 }
 
-DEFINE_READ_APIS( block_api,
+DEFINE_API_IMPL( block_api_impl, get_block_range )
+{
+   FC_ASSERT( args.count <= BLOCK_API_SINGLE_QUERY_LIMIT, "count cannot be greater than ${l}", ("l", BLOCK_API_SINGLE_QUERY_LIMIT) );
+
+   get_block_range_return result;
+   auto blocks = _db.fetch_irreversible_block_range( args.starting_block_num, args.count );
+
+   result.blocks.reserve( blocks.size() );
+   for( const auto& b : blocks )
+      result.blocks.emplace_back( b );
+
+   return result;
+}
+
+// Reversible blocks are read from the fork database, which snapshot reads do not cover
+DEFINE_LOCKED_READ_APIS( block_api,
    (get_block_header)
    (get_block)
 )
 
+// Served from the irreversible block log, which does not need the database lock
+DEFINE_LOCKLESS_APIS( block_api,
+   (get_block_range)
+)
+
 } } } // steem::plugins::block_api
@@ -35,6 +35,14 @@ class block_api
          * @return the referenced block, or null if no matching block was found
          */
          (get_block)
+
+         /**
+         * @brief Retrieve a range of full, signed blocks from the block log
+         * @param starting_block_num Height of the first block to be returned
+         * @param count Maximum number of blocks to return, at most BLOCK_API_SINGLE_QUERY_LIMIT
+         * @return the irreversible blocks in the range, stopping at the last irreversible block
+         */
+         (get_block_range)
       )
 
    private:
@@ -923,7 +923,7 @@ DEFINE_API_IMPL( database_api_impl, list_comments )
 
          if( author != account_name_type() || permlink.size() )
          {
-            auto comment = _db.find< chain::comment_object, chain::by_permlink >( boost::make_tuple( author, permlink ) );
+            auto comment = _db.find_comment( author, permlink );
             FC_ASSERT( comment != nullptr, "Could not find comment ${a}/${p}.", ("a", author)("p", permlink) );
             comment_id = comment->id;
          }
@@ -938,8 +938,10 @@ DEFINE_API_IMPL( database_api_impl, list_comments )
       case( by_permlink ):
       {
          auto key = args.start.as< std::pair< account_name_type, string > >();
+         uint64_t permlink_hash = key.second.size() ? chain::permlink_hash( key.second ) : 0;
+
          iterate_results< chain::comment_index, chain::by_permlink >(
-            boost::make_tuple( key.first, key.second ),
+            boost::make_tuple( key.first, permlink_hash, key.second ),
             result.comments,
             args.limit,
             [&]( const comment_object& c ){ return api_comment_object( c, _db ); } );
@@ -956,7 +958,7 @@ DEFINE_API_IMPL( database_api_impl, list_comments )
 
          if( root_author != account_name_type() || root_permlink.size() )
          {
-            auto root = _db.find< chain::comment_object, chain::by_permlink >( boost::make_tuple( root_author, root_permlink ) );
+            auto root = _db.find_comment( root_author, root_permlink );
             FC_ASSERT( root != nullptr, "Could not find comment ${a}/${p}.", ("a", root_author)("p", root_permlink) );
             root_id = root->id;
          }
@@ -967,7 +969,7 @@ DEFINE_API_IMPL( database_api_impl, list_comments )
 
          if( child_author != account_name_type() || child_permlink.size() )
          {
-            auto child = _db.find< chain::comment_object, chain::by_permlink >( boost::make_tuple( child_author, child_permlink ) );
+            auto child = _db.find_comment( child_author, child_permlink );
             FC_ASSERT( child != nullptr, "Could not find comment ${a}/${p}.", ("a", child_author)("p", child_permlink) );
             child_id = child->id;
          }
@@ -990,13 +992,23 @@ DEFINE_API_IMPL( database_api_impl, list_comments )
 
          if( child_author != account_name_type() || child_permlink.size() )
          {
-            auto child = _db.find< chain::comment_object, chain::by_permlink >( boost::make_tuple( child_author, child_permlink ) );
+            auto child = _db.find_comment( child_author, child_permlink );
             FC_ASSERT( child != nullptr, "Could not find comment ${a}/${p}.", ("a", child_author)("p", child_permlink) );
             child_id = child->id;
          }
 
+         auto parent_permlink = key[1].as< string >();
+         chain::comment_permlink_id_type parent_permlink_id;
+
+         if( parent_permlink.size() )
+         {
+            auto permlink = _db.find_permlink( parent_permlink );
+            FC_ASSERT( permlink != nullptr, "Could not find permlink ${p}.", ("p", parent_permlink) );
+            parent_permlink_id = permlink->id;
+         }
+
          iterate_results< chain::comment_index, chain::by_parent >(
-            boost::make_tuple( key[0].as< account_name_type >(), key[1].as< string >(), child_id ),
+            boost::make_tuple( key[0].as< account_name_type >(), parent_permlink_id, child_id ),
             result.comments,
             args.limit,
             [&]( const comment_object& c ){ return api_comment_object( c, _db ); } );
@@ -1014,16 +1026,16 @@ DEFINE_API_IMPL( database_api_impl, list_comments )
 
          if( child_author != account_name_type() || child_permlink.size() )
          {
-            auto child = _db.find< chain::comment_object, chain::by_permlink >( boost::make_tuple( child_author, child_permlink ) );
+            auto child = _db.find_comment( child_author, child_permlink );
             FC_ASSERT( child != nullptr, "Could not find comment ${a}/${p}.", ("a", child_author)("p", child_permlink) );
             child_id = child->id;
          }
 
-         iterate_results< chain::comment_index, chain::by_last_update >(
+         iterate_results< chain::comment_last_update_index, chain::by_last_update >(
             boost::make_tuple( key[0].as< account_name_type >(), key[1].as< fc::time_point_sec >(), child_id ),
             result.comments,
             args.limit,
-            [&]( const comment_object& c ){ return api_comment_object( c, _db ); } );
+            [&]( const chain::comment_last_update_object& c ){ return api_comment_object( _db.get( c.comment ), _db ); } );
          break;
       }
       case( by_author_last_update ):
@@ -1037,16 +1049,16 @@ DEFINE_API_IMPL( database_api_impl, list_comments )
 
          if( author != account_name_type() || permlink.size() )
          {
-            auto comment = _db.find< chain::comment_object, chain::by_permlink >( boost::make_tuple( author, permlink ) );
+            auto comment = _db.find_comment( author, permlink );
             FC_ASSERT( comment != nullptr, "Could not find comment ${a}/${p}.", ("a", author)("p", permlink) );
             comment_id = comment->id;
          }
 
-         iterate_results< chain::comment_index, chain::by_last_update >(
+         iterate_results< chain::comment_last_update_index, chain::by_author_last_update >(
             boost::make_tuple( key[0].as< account_name_type >(), key[1].as< fc::time_point_sec >(), comment_id ),
             result.comments,
             args.limit,
-            [&]( const comment_object& c ){ return api_comment_object( c, _db ); } );
+            [&]( const chain::comment_last_update_object& c ){ return api_comment_object( _db.get( c.comment ), _db ); } );
          break;
       }
 #endif
@@ -1065,7 +1077,7 @@ DEFINE_API_IMPL( database_api_impl, find_comments )
 
    for( auto& key: args.comments )
    {
-      auto comment = _db.find< chain::comment_object, chain::by_permlink >( boost::make_tuple( key.first, key.second ) );
+      auto comment = _db.find_comment( key.first, key.second );
 
       if( comment != nullptr )
          result.comments.push_back( api_comment_object( *comment, _db ) );
@@ -1117,7 +1129,7 @@ namespace last_votes_misc
 
       if( author != account_name_type() || permlink.size() )
       {
-         auto comment = _impl._db.find< chain::comment_object, chain::by_permlink >( boost::make_tuple( author, permlink ) );
+         auto comment = _impl._db.find_comment( author, permlink );
          FC_ASSERT( comment != nullptr, "Could not find comment ${a}/${p}.", ("a", author)("p", permlink) );
          comment_id = comment->id;
       }
@@ -1180,7 +1192,7 @@ DEFINE_API_IMPL( database_api_impl, find_votes )
 {
    find_votes_return result;
 
-   auto comment = _db.find< chain::comment_object, chain::by_permlink >( boost::make_tuple( args.author, args.permlink ) );
+   auto comment = _db.find_comment( args.author, args.permlink );
    FC_ASSERT( comment != nullptr, "Could not find comment ${a}/${p}", ("a", args.author)("p", args.permlink ) );
 
    const auto& vote_idx = _db.get_index< chain::comment_vote_index, chain::by_comment_voter >();
@@ -30,9 +30,9 @@ struct api_comment_object
 {
    api_comment_object( const comment_object& o, const database& db ):
       id( o.id ),
-      category( to_string( o.category ) ),
+      category( db.get_permlink( o.category ) ),
       parent_author( o.parent_author ),
-      parent_permlink( to_string( o.parent_permlink ) ),
+      parent_permlink( db.get_permlink( o.parent_permlink ) ),
       author( o.author ),
       permlink( to_string( o.permlink ) ),
       last_update( o.last_update ),
@@ -72,10 +72,10 @@ struct api_comment_object
          root_permlink = to_string( root->permlink );
       }
 #ifndef IS_LOW_MEM
-      const auto& con = db.get< chain::comment_content_object, chain::by_comment >( o.id );
-      title = to_string( con.title );
-      body = to_string( con.body );
-      json_metadata = to_string( con.json_metadata );
+      auto con = db.get_comment_content( o.id );
+      title = std::move( con.title );
+      body = std::move( con.body );
+      json_metadata = std::move( con.json_metadata );
 #endif
    }
 
@@ -162,7 +162,6 @@ struct api_account_object
       id( a.id ),
       name( a.name ),
       memo_key( a.memo_key ),
-      json_metadata( to_string( a.json_metadata ) ),
       proxy( a.proxy ),
       last_account_update( a.last_account_update ),
       created( a.created ),
@@ -215,6 +214,11 @@ struct api_account_object
       active = authority( auth.active );
       posting = authority( auth.posting );
       last_owner_update = auth.last_owner_update;
+#ifndef IS_LOW_MEM
+      const auto* meta = db.find< account_metadata_object, by_account >( id );
+      if( meta != nullptr )
+         json_metadata = to_string( meta->json_metadata );
+#endif
    }
 
 
@@ -33,6 +33,7 @@ class debug_node_api_impl
          (debug_set_hardfork)
          (debug_has_hardfork)
          (debug_get_json_schema)
+         (debug_get_segment_report)
       )
 
       chain::database& _db;
@@ -150,6 +151,43 @@ DEFINE_API_IMPL( debug_node_api_impl, debug_get_json_schema )
    return { _db.get_json_schema() };
 }
 
+DEFINE_API_IMPL( debug_node_api_impl, debug_get_segment_report )
+{
+   debug_get_segment_report_return result;
+
+   // Finding the free blocks allocates them all for a moment, nothing else may allocate meanwhile
+   _db.with_write_lock( [&]()
+   {
+      auto fragmentation = _db.get_segment_fragmentation();
+      result.file_size = _db.get_max_memory();
+      result.free_memory = fragmentation.free_memory;
+      result.free_block_count = fragmentation.free_block_count;
+      result.largest_free_block = fragmentation.largest_free_block;
+      result.free_block_histogram.assign( fragmentation.free_block_histogram.begin(), fragmentation.free_block_histogram.end() );
+   });
+
+   if( args.include_indices )
+   {
+      _db.with_read_lock( [&]()
+      {
+         for( const auto* idx : _db.get_abstract_index_cntr() )
+         {
+            auto info = idx->get_statistics( false );
+
+            debug_index_memory_info index_info;
+            index_info.type_name = info._value_type_name;
+            index_info.item_count = info._item_count;
+            index_info.item_sizeof = info._item_sizeof;
+            index_info.item_additional_allocation = info._item_additional_allocation;
+            index_info.additional_container_allocation = info._additional_container_allocation;
+            result.indices.push_back( std::move( index_info ) );
+         }
+      });
+   }
+
+   return result;
+}
+
 } // detail
 
 debug_node_api::debug_node_api(): my( new detail::debug_node_api_impl() )
@@ -169,6 +207,7 @@ DEFINE_LOCKLESS_APIS( debug_node_api,
    (debug_set_hardfork)
    (debug_has_hardfork)
    (debug_get_json_schema)
+   (debug_get_segment_report)
 )
 
 } } } // steem::plugins::debug_node
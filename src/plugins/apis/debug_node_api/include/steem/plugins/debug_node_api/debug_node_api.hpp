@@ -70,6 +70,30 @@ struct debug_get_json_schema_return
    std::string schema;
 };
 
+struct debug_get_segment_report_args
+{
+   bool include_indices = false;    ///< Visits every object to measure their allocations, slow on a full node
+};
+
+struct debug_index_memory_info
+{
+   std::string type_name;
+   uint64_t    item_count = 0;
+   uint64_t    item_sizeof = 0;
+   uint64_t    item_additional_allocation = 0;
+   uint64_t    additional_container_allocation = 0;
+};
+
+struct debug_get_segment_report_return
+{
+   uint64_t                               file_size = 0;
+   uint64_t                               free_memory = 0;
+   uint64_t                               free_block_count = 0;
+   uint64_t                               largest_free_block = 0;
+   std::vector< uint64_t >                free_block_histogram;   ///< Entry i counts the free blocks of [2^i, 2^(i+1)) bytes
+   std::vector< debug_index_memory_info > indices;
+};
+
 
 class debug_node_api
 {
@@ -103,6 +127,14 @@ class debug_node_api
          (debug_set_hardfork)
          (debug_has_hardfork)
          (debug_get_json_schema)
+
+         /*
+         * Report the free blocks of the shared memory segment and optionally the memory held by every index.
+         * The free blocks are found by allocating each of them and freeing them again under the write lock,
+         * so block application waits for one allocator tree operation per free block and the header page of
+         * every free block is written. The indices are measured afterwards under the read lock.
+         */
+         (debug_get_segment_report)
       )
 
    private:
@@ -131,3 +163,12 @@ FC_REFLECT( steem::plugins::debug_node::debug_has_hardfork_return,
 
 FC_REFLECT( steem::plugins::debug_node::debug_get_json_schema_return,
             (schema) )
+
+FC_REFLECT( steem::plugins::debug_node::debug_get_segment_report_args,
+            (include_indices) )
+
+FC_REFLECT( steem::plugins::debug_node::debug_index_memory_info,
+            (type_name)(item_count)(item_sizeof)(item_additional_allocation)(additional_container_allocation) )
+
+FC_REFLECT( steem::plugins::debug_node::debug_get_segment_report_return,
+            (file_size)(free_memory)(free_block_count)(largest_free_block)(free_block_histogram)(indices) )
@@ -302,15 +302,19 @@ follow_api::follow_api(): my( new detail::follow_api_impl() )
 follow_api::~follow_api() {}
 
 DEFINE_READ_APIS( follow_api,
-   (get_followers)
-   (get_following)
-   (get_follow_count)
    (get_feed_entries)
    (get_feed)
    (get_blog_entries)
    (get_blog)
    (get_account_reputations)
    (get_reblogged_by)
+)
+
+// Only read follow plugin indices
+DEFINE_LOCK_GROUP_READ_APIS( follow_api, STEEM_FOLLOW_PLUGIN_NAME,
+   (get_followers)
+   (get_following)
+   (get_follow_count)
    (get_blog_authors)
 )
 
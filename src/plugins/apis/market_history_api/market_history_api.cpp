@@ -196,10 +196,14 @@ DEFINE_READ_APIS( market_history_api,
    (get_ticker)
    (get_volume)
    (get_order_book)
+   (get_market_history_buckets)
+)
+
+// Only read market history plugin indices
+DEFINE_LOCK_GROUP_READ_APIS( market_history_api, STEEM_MARKET_HISTORY_PLUGIN_NAME,
    (get_trade_history)
    (get_recent_trades)
    (get_market_history)
-   (get_market_history_buckets)
 )
 
 } } } // steem::plugins::market_history
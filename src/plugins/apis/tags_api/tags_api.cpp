@@ -46,7 +46,7 @@ class tags_api_impl
 
       static bool filter_default( const database_api::api_comment_object& c ) { return false; }
       static bool exit_default( const database_api::api_comment_object& c )   { return false; }
-      static bool tag_exit_default( const tags::tag_object& c )               { return false; }
+      static bool tag_exit_default( const tags::tag_sort_object& c )               { return false; }
 
       template<typename Index, typename StartItr>
       discussion_query_result get_discussions( const discussion_query& q,
@@ -56,7 +56,7 @@ class tags_api_impl
                                                uint32_t truncate_body = 0,
                                                const std::function< bool( const database_api::api_comment_object& ) >& filter = &tags_api_impl::filter_default,
                                                const std::function< bool( const database_api::api_comment_object& ) >& exit   = &tags_api_impl::exit_default,
-                                               const std::function< bool( const tags::tag_object& ) >& tag_exit               = &tags_api_impl::tag_exit_default,
+                                               const std::function< bool( const tags::tag_sort_object& ) >& tag_exit               = &tags_api_impl::tag_exit_default,
                                                bool ignore_parent = false
                                                );
 
@@ -115,10 +115,9 @@ DEFINE_API_IMPL( tags_api_impl, get_tags_used_by_author )
 
 DEFINE_API_IMPL( tags_api_impl, get_discussion )
 {
-   const auto& by_permlink_idx = _db.get_index< chain::comment_index, chain::by_permlink >();
-   auto itr = by_permlink_idx.find( boost::make_tuple( args.author, args.permlink ) );
+   auto itr = _db.find_comment( args.author, args.permlink );
 
-   if( itr != by_permlink_idx.end() )
+   if( itr != nullptr )
    {
       get_discussion_return result( *itr, _db );
       set_pending_payout( result );
@@ -131,12 +130,16 @@ DEFINE_API_IMPL( tags_api_impl, get_discussion )
 
 DEFINE_API_IMPL( tags_api_impl, get_content_replies )
 {
-   const auto& by_permlink_idx = _db.get_index< chain::comment_index, chain::by_parent >();
-   auto itr = by_permlink_idx.find( boost::make_tuple( args.author, args.permlink ) );
-
    get_content_replies_return result;
 
-   while( itr != by_permlink_idx.end() && itr->parent_author == args.author && chain::to_string( itr->parent_permlink ) == args.permlink )
+   auto permlink = _db.find_permlink( args.permlink );
+   if( permlink == nullptr )
+      return result;
+
+   const auto& by_parent_idx = _db.get_index< chain::comment_index, chain::by_parent >();
+   auto itr = by_parent_idx.lower_bound( boost::make_tuple( args.author, permlink->id ) );
+
+   while( itr != by_parent_idx.end() && itr->parent_author == args.author && itr->parent_permlink == permlink->id )
    {
       result.discussions.push_back( discussion( *itr, _db ) );
       set_pending_payout( result.discussions.back() );
@@ -151,7 +154,7 @@ DEFINE_API_IMPL( tags_api_impl, get_post_discussions_by_payout )
    auto tag = fc::to_lower( args.tag );
    auto parent = chain::comment_id_type();
 
-   const auto& tidx = _db.get_index< tags::tag_index, tags::by_reward_fund_net_rshares >();
+   const auto& tidx = _db.get_index< tags::tag_sort_index, tags::by_reward_fund_net_rshares >();
    auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, true ) );
 
    return get_discussions( args, tag, parent, tidx, tidx_itr, args.truncate_body, []( const database_api::api_comment_object& c ){ return c.net_rshares <= 0; }, exit_default, tag_exit_default, true );
@@ -163,7 +166,7 @@ DEFINE_API_IMPL( tags_api_impl, get_comment_discussions_by_payout )
    auto tag = fc::to_lower( args.tag );
    auto parent = chain::comment_id_type( 1 );
 
-   const auto& tidx = _db.get_index< tags::tag_index, tags::by_reward_fund_net_rshares >();
+   const auto& tidx = _db.get_index< tags::tag_sort_index, tags::by_reward_fund_net_rshares >();
    auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, false ) );
 
    return get_discussions( args, tag, parent, tidx, tidx_itr, args.truncate_body, []( const database_api::api_comment_object& c ){ return c.net_rshares <= 0; }, exit_default, tag_exit_default, true );
@@ -175,7 +178,7 @@ DEFINE_API_IMPL( tags_api_impl, get_discussions_by_trending )
    auto tag = fc::to_lower( args.tag );
    auto parent = get_parent( args );
 
-   const auto& tidx = _db.get_index< tags::tag_index, tags::by_parent_trending >();
+   const auto& tidx = _db.get_index< tags::tag_sort_index, tags::by_parent_trending >();
    auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, parent, std::numeric_limits< double >::max() )  );
 
    return get_discussions( args, tag, parent, tidx, tidx_itr, args.truncate_body, []( const database_api::api_comment_object& c ) { return c.net_rshares <= 0; } );
@@ -187,7 +190,7 @@ DEFINE_API_IMPL( tags_api_impl, get_discussions_by_created )
    auto tag = fc::to_lower( args.tag );
    auto parent = get_parent( args );
 
-   const auto& tidx = _db.get_index< tags::tag_index, tags::by_parent_created >();
+   const auto& tidx = _db.get_index< tags::tag_sort_index, tags::by_parent_created >();
    auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, parent, fc::time_point_sec::maximum() )  );
 
    return get_discussions( args, tag, parent, tidx, tidx_itr, args.truncate_body );
@@ -199,7 +202,7 @@ DEFINE_API_IMPL( tags_api_impl, get_discussions_by_active )
    auto tag = fc::to_lower( args.tag );
    auto parent = get_parent( args );
 
-   const auto& tidx = _db.get_index< tags::tag_index, tags::by_parent_active >();
+   const auto& tidx = _db.get_index< tags::tag_sort_index, tags::by_parent_active >();
    auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, parent, fc::time_point_sec::maximum() )  );
 
    return get_discussions( args, tag, parent, tidx, tidx_itr, args.truncate_body );
@@ -213,7 +216,7 @@ DEFINE_API_IMPL( tags_api_impl, get_discussions_by_cashout )
    auto tag = fc::to_lower( args.tag );
    auto parent = get_parent( args );
 
-   const auto& tidx = _db.get_index< tags::tag_index, tags::by_cashout >();
+   const auto& tidx = _db.get_index< tags::tag_sort_index, tags::by_cashout >();
    auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, fc::time_point::now() - fc::minutes( 60 ) ) );
 
    return get_discussions( args, tag, parent, tidx, tidx_itr, args.truncate_body, []( const database_api::api_comment_object& c ){ return c.net_rshares < 0; });
@@ -225,7 +228,7 @@ DEFINE_API_IMPL( tags_api_impl, get_discussions_by_votes )
    auto tag = fc::to_lower( args.tag );
    auto parent = get_parent( args );
 
-   const auto& tidx = _db.get_index< tags::tag_index, tags::by_parent_net_votes >();
+   const auto& tidx = _db.get_index< tags::tag_sort_index, tags::by_parent_net_votes >();
    auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, parent, std::numeric_limits< int32_t >::max() )  );
 
    return get_discussions( args, tag, parent, tidx, tidx_itr, args.truncate_body );
@@ -237,7 +240,7 @@ DEFINE_API_IMPL( tags_api_impl, get_discussions_by_children )
    auto tag = fc::to_lower( args.tag );
    auto parent = get_parent( args );
 
-   const auto& tidx = _db.get_index< tags::tag_index, tags::by_parent_children >();
+   const auto& tidx = _db.get_index< tags::tag_sort_index, tags::by_parent_children >();
    auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, parent, std::numeric_limits< int32_t >::max() )  );
 
    return get_discussions( args, tag, parent, tidx, tidx_itr, args.truncate_body );
@@ -249,7 +252,7 @@ DEFINE_API_IMPL( tags_api_impl, get_discussions_by_hot )
    auto tag = fc::to_lower( args.tag );
    auto parent = get_parent( args );
 
-   const auto& tidx = _db.get_index< tags::tag_index, tags::by_parent_hot >();
+   const auto& tidx = _db.get_index< tags::tag_sort_index, tags::by_parent_hot >();
    auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, parent, std::numeric_limits< double >::max() )  );
 
    return get_discussions( args, tag, parent, tidx, tidx_itr, args.truncate_body, []( const database_api::api_comment_object& c ) { return c.net_rshares <= 0; } );
@@ -380,15 +383,14 @@ DEFINE_API_IMPL( tags_api_impl, get_discussions_by_comments )
    auto start_author = *( args.start_author );
    auto start_permlink = args.start_permlink ? *( args.start_permlink ) : "";
 
-   const auto& c_idx = _db.get_index< comment_index, by_permlink >();
-   const auto& t_idx = _db.get_index< comment_index, by_author_last_update >();
+   const auto& t_idx = _db.get_index< chain::comment_last_update_index, chain::by_author_last_update >();
    auto comment_itr = t_idx.lower_bound( start_author );
 
    if( start_permlink.size() )
    {
-      auto start_c = c_idx.find( boost::make_tuple( start_author, start_permlink ) );
-      FC_ASSERT( start_c != c_idx.end(), "Comment is not in account's comments" );
-      comment_itr = t_idx.iterator_to( *start_c );
+      auto start_c = _db.find_comment( start_author, start_permlink );
+      FC_ASSERT( start_c != nullptr, "Comment is not in account's comments" );
+      comment_itr = t_idx.iterator_to( _db.get< chain::comment_last_update_object, chain::by_comment >( start_c->id ) );
    }
 
    result.discussions.reserve( args.limit );
@@ -401,7 +403,7 @@ DEFINE_API_IMPL( tags_api_impl, get_discussions_by_comments )
       {
          try
          {
-            result.discussions.push_back( lookup_discussion( comment_itr->id ) );
+            result.discussions.push_back( lookup_discussion( comment_itr->comment ) );
          }
          catch( const fc::exception& e )
          {
@@ -421,10 +423,10 @@ DEFINE_API_IMPL( tags_api_impl, get_discussions_by_promoted )
    auto tag = fc::to_lower( args.tag );
    auto parent = get_parent( args );
 
-   const auto& tidx = _db.get_index< tags::tag_index, tags::by_parent_promoted >();
+   const auto& tidx = _db.get_index< tags::tag_sort_index, tags::by_parent_promoted >();
    auto tidx_itr = tidx.lower_bound( boost::make_tuple( tag, parent, share_type( STEEM_MAX_SHARE_SUPPLY ) )  );
 
-   return get_discussions( args, tag, parent, tidx, tidx_itr, args.truncate_body, filter_default, exit_default, []( const tags::tag_object& t ){ return t.promoted_balance == 0; }  );
+   return get_discussions( args, tag, parent, tidx, tidx_itr, args.truncate_body, filter_default, exit_default, []( const tags::tag_sort_object& t ){ return t.promoted_balance == 0; }  );
 }
 
 DEFINE_API_IMPL( tags_api_impl, get_replies_by_last_update )
@@ -433,14 +435,14 @@ DEFINE_API_IMPL( tags_api_impl, get_replies_by_last_update )
 
 #ifndef IS_LOW_MEM
    FC_ASSERT( args.limit <= 100 );
-   const auto& last_update_idx = _db.get_index< comment_index, by_last_update >();
+   const auto& last_update_idx = _db.get_index< chain::comment_last_update_index, chain::by_last_update >();
    auto itr = last_update_idx.begin();
    account_name_type parent_author = args.start_parent_author;
 
    if( args.start_permlink.size() )
    {
       const auto& comment = _db.get_comment( args.start_parent_author, args.start_permlink );
-      itr = last_update_idx.iterator_to( comment );
+      itr = last_update_idx.iterator_to( _db.get< chain::comment_last_update_object, chain::by_comment >( comment.id ) );
       parent_author = comment.parent_author;
    }
    else if( args.start_parent_author.size() )
@@ -452,9 +454,10 @@ DEFINE_API_IMPL( tags_api_impl, get_replies_by_last_update )
 
    while( itr != last_update_idx.end() && result.discussions.size() < args.limit && itr->parent_author == parent_author )
    {
-      result.discussions.push_back( discussion( *itr, _db ) );
+      const auto& comment = _db.get( itr->comment );
+      result.discussions.push_back( discussion( comment, _db ) );
       set_pending_payout( result.discussions.back() );
-      result.discussions.back().active_votes = get_active_votes( get_active_votes_args( { itr->author, chain::to_string( itr->permlink ) } ) ).votes;
+      result.discussions.back().active_votes = get_active_votes( get_active_votes_args( { comment.author, chain::to_string( comment.permlink ) } ) ).votes;
       ++itr;
    }
 
@@ -471,7 +474,7 @@ DEFINE_API_IMPL( tags_api_impl, get_discussions_by_author_before_date )
       FC_ASSERT( args.limit <= 100 );
       result.discussions.reserve( args.limit );
       uint32_t count = 0;
-      const auto& didx = _db.get_index< comment_index, by_author_last_update >();
+      const auto& didx = _db.get_index< chain::comment_last_update_index, chain::by_author_last_update >();
 
       auto before_date = args.before_date;
 
@@ -483,7 +486,7 @@ DEFINE_API_IMPL( tags_api_impl, get_discussions_by_author_before_date )
       {
          const auto& comment = _db.get_comment( args.author, args.start_permlink );
          if( comment.created < before_date )
-            itr = didx.iterator_to( comment );
+            itr = didx.iterator_to( _db.get< chain::comment_last_update_object, chain::by_comment >( comment.id ) );
       }
 
 
@@ -491,9 +494,10 @@ DEFINE_API_IMPL( tags_api_impl, get_discussions_by_author_before_date )
       {
          if( itr->parent_author.size() == 0 )
          {
-            result.discussions.push_back( discussion( *itr, _db ) );
+            const auto& comment = _db.get( itr->comment );
+            result.discussions.push_back( discussion( comment, _db ) );
             set_pending_payout( result.discussions.back() );
-            result.discussions.back().active_votes = get_active_votes( get_active_votes_args( { itr->author, chain::to_string( itr->permlink ) } ) ).votes;
+            result.discussions.back().active_votes = get_active_votes( get_active_votes_args( { comment.author, chain::to_string( comment.permlink ) } ) ).votes;
             ++count;
          }
          ++itr;
@@ -614,7 +618,7 @@ discussion_query_result tags_api_impl::get_discussions( const discussion_query&
                                                         uint32_t truncate_body,
                                                         const std::function< bool( const database_api::api_comment_object& ) >& filter,
                                                         const std::function< bool( const database_api::api_comment_object& ) >& exit,
-                                                        const std::function< bool( const tags::tag_object& ) >& tag_exit,
+                                                        const std::function< bool( const tags::tag_sort_object& ) >& tag_exit,
                                                         bool ignore_parent
                                                         )
 {
@@ -631,7 +635,9 @@ discussion_query_result tags_api_impl::get_discussions( const discussion_query&
       {
          if( itr->tag == tag )
          {
-            tidx_itr = tidx.iterator_to( *itr );
+            const auto* sort_keys = _db.find< tags::tag_sort_object, tags::by_tag_id >( itr->id );
+            if( sort_keys != nullptr )
+               tidx_itr = tidx.iterator_to( *sort_keys );
             break;
          }
          ++itr;
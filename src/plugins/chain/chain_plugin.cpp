@@ -1,4 +1,8 @@
 #include <steem/chain/database_exceptions.hpp>
+#include <steem/chain/utils/block_conflict_analyzer.hpp>
+#include <steem/chain/utils/signal.hpp>
+
+#include <steem/protocol/signature_key_cache.hpp>
 
 #include <steem/plugins/chain/chain_plugin.hpp>
 #include <steem/plugins/statsd/utility.hpp>
@@ -7,6 +11,7 @@
 
 #include <fc/string.hpp>
 
+#include <boost/algorithm/string.hpp>
 #include <boost/asio.hpp>
 #include <boost/optional.hpp>
 #include <boost/bind.hpp>
@@ -14,8 +19,10 @@
 #include <boost/thread/future.hpp>
 #include <boost/lockfree/queue.hpp>
 
+#include <atomic>
 #include <thread>
 #include <memory>
+#include <mutex>
 #include <iostream>
 
 namespace steem { namespace plugins { namespace chain {
@@ -59,12 +66,19 @@ namespace detail {
 class chain_plugin_impl
 {
    public:
-      chain_plugin_impl() : write_queue( 64 ) {}
-      ~chain_plugin_impl() { stop_write_processing(); }
+      chain_plugin_impl() :
+         write_queue( 64 ),
+         signature_pool_work( boost::asio::make_work_guard( signature_pool_ios ) )
+      {}
+      ~chain_plugin_impl() { stop_write_processing(); stop_signature_processing(); }
 
       void start_write_processing();
       void stop_write_processing();
 
+      void start_signature_processing();
+      void stop_signature_processing();
+      void precompute_signature_keys( const signed_block& block );
+
       uint64_t                         shared_memory_size = 0;
       uint16_t                         shared_file_full_threshold = 0;
       uint16_t                         shared_file_scale_rate = 0;
@@ -77,11 +91,23 @@ class chain_plugin_impl
       bool                             dump_memory_details = false;
       bool                             benchmark_is_enabled =false;
       bool                             statsd_on_replay = false;
+      bool                             compress_block_log = false;
+      bool                             api_snapshot_reads = false;
+      bool                             compact_shared_memory = false;
+      bool                             comment_content_store = false;
+      bool                             analyze_block_conflicts = false;
+      bfs::path                        export_snapshot;
+      bfs::path                        load_snapshot;
+      uint32_t                         snapshot_load_threads = 4;
+      chainbase::segment_options       shared_file_options;
       uint32_t                         stop_replay_at = 0;
       uint32_t                         benchmark_interval = 0;
       uint32_t                         flush_interval = 0;
       flat_map<uint32_t,block_id_type> loaded_checkpoints;
 
+      steem::utilities::benchmark_dumper::block_conflict_stats_t block_conflicts;
+      boost::signals2::connection      pre_apply_block_conn;
+
       uint32_t allow_future_time = 5;
 
       bool                             running = true;
@@ -89,6 +115,13 @@ class chain_plugin_impl
       boost::lockfree::queue< write_context* > write_queue;
       int16_t                          write_lock_hold_time = 500;
 
+      uint32_t                         signature_pool_size = 0;
+      bool                             signature_pool_running = false;
+      std::mutex                       signature_pool_mutex;
+      boost::thread_group              signature_pool;
+      appbase::io_service_t            signature_pool_ios;
+      boost::asio::executor_work_guard< appbase::io_service_t::executor_type > signature_pool_work;
+
       database  db;
 };
 
@@ -277,6 +310,86 @@ void chain_plugin_impl::stop_write_processing()
    write_processor_thread.reset();
 }
 
+void chain_plugin_impl::start_signature_processing()
+{
+   std::lock_guard< std::mutex > guard( signature_pool_mutex );
+
+   for( uint32_t i = 0; i < signature_pool_size; ++i )
+      signature_pool.create_thread( boost::bind( &appbase::io_service_t::run, &signature_pool_ios ) );
+
+   signature_pool_running = signature_pool_size > 0;
+}
+
+void chain_plugin_impl::stop_signature_processing()
+{
+   {
+      std::lock_guard< std::mutex > guard( signature_pool_mutex );
+      signature_pool_running = false;
+   }
+
+   // Let the workers drain the work already posted so no caller waits on a dropped handler
+   signature_pool_work.reset();
+   signature_pool.join_all();
+}
+
+/**
+ * Recovers the signature keys of every transaction in the block on the signature thread pool
+ * before the block is queued for the write thread. _apply_transaction then finds the keys in
+ * the signature key cache and only has to check authorities while holding the write lock.
+ */
+void chain_plugin_impl::precompute_signature_keys( const signed_block& block )
+{
+   const auto& trxs = block.transactions;
+   if( signature_pool_size == 0 || trxs.empty() )
+      return;
+
+   uint32_t num_workers = std::min< uint32_t >( signature_pool_size, trxs.size() );
+   std::atomic< size_t > next_trx( 0 );
+   std::vector< boost::promise< void > > done( num_workers );
+
+   {
+      std::lock_guard< std::mutex > guard( signature_pool_mutex );
+
+      if( signature_pool_running )
+      {
+         for( uint32_t i = 0; i < num_workers; ++i )
+         {
+            boost::asio::post( signature_pool_ios, [&, i]()
+            {
+               try
+               {
+                  for( size_t t = next_trx++; t < trxs.size(); t = next_trx++ )
+                     db.precompute_signature_keys( trxs[t] );
+
+                  done[i].set_value();
+               }
+               catch( ... )
+               {
+                  done[i].set_exception( boost::current_exception() );
+               }
+            });
+         }
+      }
+      else
+      {
+         num_workers = 0;
+      }
+   }
+
+   if( num_workers == 0 )
+   {
+      // The pool is not running (not started yet or shut down), recover on this thread instead
+      for( const auto& trx : trxs )
+         db.precompute_signature_keys( trx );
+
+      return;
+   }
+
+   // A failed worker only leaves keys out of the cache, they are recovered again when the block is applied
+   for( auto& d : done )
+      d.get_future().wait();
+}
+
 } // detail
 
 
@@ -301,17 +414,39 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
             "A 2 precision percentage (0-10000) that defines the threshold for when to autoscale the shared memory file. Setting this to 0 disables autoscaling. Recommended value for consensus node is 9500 (95%). Full node is 9900 (99%)" )
          ("shared-file-scale-rate", bpo::value<uint16_t>()->default_value(0),
             "A 2 precision percentage (0-10000) that defines how quickly to scale the shared memory file. When autoscaling occurs the file's size will be increased by this percent. Setting this to 0 disables autoscaling. Recommended value is between 1000-2000 (10-20%)" )
+         ("shared-file-madvise", bpo::value< vector< string > >()->composing(),
+            "Memory advice for the shared memory file: hugepage (transparent huge pages, anonymous or tmpfs only), random (no read ahead) or willneed (prefault). May be specified multiple times")
+         ("shared-file-numa-policy", bpo::value< string >(),
+            "NUMA placement of the shared memory file: interleave or bind, optionally followed by a node list, e.g. interleave:0,1. Ignored for a file that is not on tmpfs or hugetlbfs, unless shared-file-anonymous is set")
+         ("shared-file-anonymous", bpo::value<bool>()->default_value(false),
+            "Keep the state in anonymous memory instead of mapping the shared memory file. The state is saved to shared_memory.image on shutdown and every flush-state-interval blocks by a forked process, changes since the last save are lost on a crash")
          ("checkpoint,c", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
          ("flush-state-interval", bpo::value<uint32_t>(),
             "flush shared memory changes to disk every N blocks")
+         ("signature-recovery-threads", bpo::value<uint32_t>()->default_value(4),
+            "Number of threads recovering transaction signature keys of incoming blocks before they are applied. Setting this to 0 recovers them on the write thread")
+         ("signature-key-cache-size", bpo::value<uint32_t>()->default_value(steem::protocol::signature_key_cache::default_max_size),
+            "Number of recovered signature keys to cache. Transactions are recovered again when they are reapplied from the pending state or included in a block")
+         ("block-log-compression", bpo::value<bool>()->default_value(false),
+            "Compress blocks in a newly created block log. An existing block log keeps its format, use compress_block_log to convert it")
+         ("api-snapshot-reads", bpo::value<bool>()->default_value(false),
+            "Serve read APIs from a copy of the state as of the head block instead of waiting for the database read lock. Doubles the shared memory used by the indices")
+         ("snapshot-load-threads", bpo::value<uint32_t>()->default_value(4),
+            "Number of indices read at once when loading a state snapshot")
+         ("comment-content-store", bpo::value<bool>()->default_value(false),
+            "Keep the title, body and json_metadata of irreversible comments in blockchain/comment_content.log instead of the shared memory file. Disabling it again requires a replay")
          ;
    cli.add_options()
          ("replay-blockchain", bpo::bool_switch()->default_value(false), "clear chain database and replay all blocks" )
          ("resync-blockchain", bpo::bool_switch()->default_value(false), "clear chain database and block log" )
          ("stop-replay-at-block", bpo::value<uint32_t>(), "Stop and exit after reaching given block number")
+         ("load-snapshot", bpo::value<bfs::path>(), "clear chain database and load the state from the given snapshot instead of replaying the block log" )
+         ("export-snapshot", bpo::value<bfs::path>(), "write the state as of the head block to the given snapshot file after opening the database" )
+         ("compact-shared-memory", bpo::bool_switch()->default_value(false), "rebuild the shared memory file after opening the database to remove its fragmentation" )
          ("advanced-benchmark", "Make profiling for every plugin.")
          ("set-benchmark-interval", bpo::value<uint32_t>(), "Print time and memory usage every given number of blocks")
          ("dump-memory-details", bpo::bool_switch()->default_value(false), "Dump database objects memory usage info. Use set-benchmark-interval to set dump interval.")
+         ("analyze-block-conflicts", bpo::bool_switch()->default_value(false), "Partition the transactions of every block into conflict free groups and report the statistics. Use set-benchmark-interval to set the report interval.")
          ("check-locks", bpo::bool_switch()->default_value(false), "Check correctness of chainbase locking" )
          ("validate-database-invariants", bpo::bool_switch()->default_value(false), "Validate all supply invariants check out" )
 #ifdef IS_TEST_NET
@@ -340,8 +475,50 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
    if( options.count( "shared-file-scale-rate" ) )
       my->shared_file_scale_rate = options.at( "shared-file-scale-rate" ).as< uint16_t >();
 
+   if( options.count( "shared-file-madvise" ) )
+   {
+      for( const auto& advice : options.at( "shared-file-madvise" ).as< vector< string > >() )
+      {
+         if( advice == "hugepage" )
+            my->shared_file_options.transparent_huge_pages = true;
+         else if( advice == "random" )
+            my->shared_file_options.random_access = true;
+         else if( advice == "willneed" )
+            my->shared_file_options.prefault = true;
+         else
+            FC_ASSERT( false, "Unknown shared-file-madvise value ${a}", ("a", advice) );
+      }
+   }
+
+   if( options.count( "shared-file-numa-policy" ) )
+   {
+      auto policy = options.at( "shared-file-numa-policy" ).as< string >();
+      auto colon = policy.find( ':' );
+      auto mode = policy.substr( 0, colon );
+
+      if( mode == "interleave" )
+         my->shared_file_options.numa_policy = chainbase::segment_options::numa_interleave;
+      else if( mode == "bind" )
+         my->shared_file_options.numa_policy = chainbase::segment_options::numa_bind;
+      else
+         FC_ASSERT( false, "Unknown shared-file-numa-policy ${p}", ("p", policy) );
+
+      if( colon != string::npos )
+      {
+         auto node_list = policy.substr( colon + 1 );
+         vector< string > nodes;
+         boost::split( nodes, node_list, boost::is_any_of( "," ) );
+         for( const auto& node : nodes )
+            my->shared_file_options.numa_nodes.push_back( boost::lexical_cast< uint32_t >( node ) );
+      }
+   }
+
+   if( options.count( "shared-file-anonymous" ) )
+      my->shared_file_options.anonymous = options.at( "shared-file-anonymous" ).as< bool >();
+
    my->replay              = options.at( "replay-blockchain").as<bool>();
    my->resync              = options.at( "resync-blockchain").as<bool>();
+   my->compact_shared_memory = options.at( "compact-shared-memory" ).as<bool>();
    my->stop_replay_at      =
       options.count( "stop-replay-at-block" ) ? options.at( "stop-replay-at-block" ).as<uint32_t>() : 0;
    my->benchmark_interval  =
@@ -349,11 +526,36 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
    my->check_locks         = options.at( "check-locks" ).as< bool >();
    my->validate_invariants = options.at( "validate-database-invariants" ).as<bool>();
    my->dump_memory_details = options.at( "dump-memory-details" ).as<bool>();
+   my->analyze_block_conflicts = options.at( "analyze-block-conflicts" ).as<bool>();
    if( options.count( "flush-state-interval" ) )
       my->flush_interval = options.at( "flush-state-interval" ).as<uint32_t>();
    else
       my->flush_interval = 10000;
 
+   if( options.count( "load-snapshot" ) )
+      my->load_snapshot = options.at( "load-snapshot" ).as< bfs::path >();
+   if( options.count( "export-snapshot" ) )
+      my->export_snapshot = options.at( "export-snapshot" ).as< bfs::path >();
+   if( options.count( "snapshot-load-threads" ) )
+      my->snapshot_load_threads = options.at( "snapshot-load-threads" ).as< uint32_t >();
+
+   FC_ASSERT( my->load_snapshot.empty() || !my->replay, "load-snapshot and replay-blockchain cannot be used together" );
+
+   if( options.count( "block-log-compression" ) )
+      my->compress_block_log = options.at( "block-log-compression" ).as<bool>();
+
+   if( options.count( "api-snapshot-reads" ) )
+      my->api_snapshot_reads = options.at( "api-snapshot-reads" ).as<bool>();
+
+   if( options.count( "comment-content-store" ) )
+      my->comment_content_store = options.at( "comment-content-store" ).as<bool>();
+
+   if( options.count( "signature-recovery-threads" ) )
+      my->signature_pool_size = options.at( "signature-recovery-threads" ).as<uint32_t>();
+
+   if( options.count( "signature-key-cache-size" ) )
+      steem::protocol::signature_key_cache::instance().set_max_size( options.at( "signature-key-cache-size" ).as<uint32_t>() );
+
    if(options.count("checkpoint"))
    {
       auto cps = options.at("checkpoint").as<vector<string>>();
@@ -430,11 +632,39 @@ void chain_plugin::plugin_startup()
    db_open_args.shared_file_size = my->shared_memory_size;
    db_open_args.shared_file_full_threshold = my->shared_file_full_threshold;
    db_open_args.shared_file_scale_rate = my->shared_file_scale_rate;
+   db_open_args.shared_file_options = my->shared_file_options;
    db_open_args.do_validate_invariants = my->validate_invariants;
    db_open_args.stop_replay_at = my->stop_replay_at;
    db_open_args.benchmark_is_enabled = my->benchmark_is_enabled;
+   db_open_args.compress_block_log = my->compress_block_log;
+   db_open_args.comment_content_store = my->comment_content_store;
 
-   auto benchmark_lambda = [&dumper, &get_indexes_memory_details, dump_memory_details] ( uint32_t current_block_number,
+   if( my->analyze_block_conflicts )
+   {
+      my->pre_apply_block_conn = my->db.add_pre_apply_block_handler( [this]( const block_notification& note )
+      {
+         auto analysis = steem::chain::util::analyze_block_conflicts( note.block );
+         auto& stats = my->block_conflicts;
+         ++stats.blocks;
+         stats.transactions += analysis.transaction_groups.size();
+         stats.conflict_groups += analysis.group_count;
+         stats.serial_transactions += analysis.largest_group;
+         stats.global_transactions += analysis.global_transactions;
+      }, *this );
+   }
+
+   auto set_segment_stats = [this, &dumper]()
+   {
+      auto info = my->db.get_segment_statistics();
+      steem::utilities::benchmark_dumper::segment_stats_t stats;
+      stats.file_size = info.file_size;
+      stats.free_memory = info.free_memory;
+      stats.page_size = info.page_size;
+      stats.huge_page_bytes = info.huge_page_bytes;
+      dumper.set_segment_stats( stats );
+   };
+
+   auto benchmark_lambda = [this, &dumper, &get_indexes_memory_details, &set_segment_stats, dump_memory_details] ( uint32_t current_block_number,
       const chainbase::database::abstract_index_cntr_t& abstract_index_cntr )
    {
       if( current_block_number == 0 ) // initial call
@@ -457,6 +687,14 @@ void chain_plugin::plugin_startup()
          return;
       }
 
+      if( my->analyze_block_conflicts )
+      {
+         dumper.add_block_conflicts( my->block_conflicts );
+         my->block_conflicts = steem::utilities::benchmark_dumper::block_conflict_stats_t();
+      }
+
+      set_segment_stats();
+
       const steem::utilities::benchmark_dumper::measurement& measure =
          dumper.measure(current_block_number, get_indexes_memory_details);
       ilog( "Performance report at block ${n}. Elapsed time: ${rt} ms (real), ${ct} ms (cpu). Memory usage: ${cm} (current), ${pm} (peak) kilobytes.",
@@ -465,9 +703,30 @@ void chain_plugin::plugin_startup()
          ("ct", measure.cpu_ms)
          ("cm", measure.current_mem)
          ("pm", measure.peak_mem) );
+      ilog( "Shared memory at block ${n}: ${f} free of ${s} bytes, ${h} bytes in huge pages.",
+         ("n", current_block_number)
+         ("f", measure.segment_stats.free_memory)
+         ("s", measure.segment_stats.file_size)
+         ("h", measure.segment_stats.huge_page_bytes) );
+
+      if( my->analyze_block_conflicts )
+         ilog( "Block conflicts at block ${n}: ${t} transactions in ${g} conflict groups, ${s} serial transactions, ${gt} writing global objects.",
+            ("n", current_block_number)
+            ("t", measure.block_conflicts.transactions)
+            ("g", measure.block_conflicts.conflict_groups)
+            ("s", measure.block_conflicts.serial_transactions)
+            ("gt", measure.block_conflicts.global_transactions) );
    };
 
-   if(my->replay)
+   if( !my->load_snapshot.empty() )
+   {
+      ilog( "Loading state from snapshot ${f}", ("f", my->load_snapshot.generic_string()) );
+      db_open_args.load_snapshot = my->load_snapshot;
+      db_open_args.snapshot_load_threads = my->snapshot_load_threads;
+      my->db.wipe( db_open_args.data_dir, my->shared_memory_dir, false );
+      my->db.open( db_open_args );
+   }
+   else if(my->replay)
    {
       ilog("Replaying blockchain on user request.");
       uint32_t last_block_number = 0;
@@ -476,6 +735,10 @@ void chain_plugin::plugin_startup()
 
       if( my->benchmark_interval > 0 )
       {
+         dumper.add_block_conflicts( my->block_conflicts );
+         my->block_conflicts = steem::utilities::benchmark_dumper::block_conflict_stats_t();
+         set_segment_stats();
+
          const steem::utilities::benchmark_dumper::measurement& total_data = dumper.dump(true, get_indexes_memory_details);
          ilog( "Performance report (total). Blocks: ${b}. Elapsed time: ${rt} ms (real), ${ct} ms (cpu). Memory usage: ${cm} (current), ${pm} (peak) kilobytes.",
                ("b", total_data.block_number)
@@ -483,6 +746,14 @@ void chain_plugin::plugin_startup()
                ("ct", total_data.cpu_ms)
                ("cm", total_data.current_mem)
                ("pm", total_data.peak_mem) );
+
+         if( my->analyze_block_conflicts )
+            ilog( "Block conflicts (total). Blocks: ${b}. ${t} transactions in ${g} conflict groups, ${s} serial transactions, ${gt} writing global objects.",
+               ("b", total_data.block_conflicts.blocks)
+               ("t", total_data.block_conflicts.transactions)
+               ("g", total_data.block_conflicts.conflict_groups)
+               ("s", total_data.block_conflicts.serial_transactions)
+               ("gt", total_data.block_conflicts.global_transactions) );
       }
 
       if( my->stop_replay_at > 0 && my->stop_replay_at == last_block_number )
@@ -503,7 +774,10 @@ void chain_plugin::plugin_startup()
          my->db.open( db_open_args );
 
          if( dump_memory_details )
+         {
+            set_segment_stats();
             dumper.dump( true, get_indexes_memory_details );
+         }
       }
       catch( const fc::exception& e )
       {
@@ -521,15 +795,45 @@ void chain_plugin::plugin_startup()
       }
    }
 
+   if( my->compact_shared_memory )
+   {
+      db_open_args.benchmark = steem::chain::database::TBenchmark( 0, benchmark_lambda );
+      my->db.compact( db_open_args );
+   }
+
+   auto segment_info = my->db.get_segment_statistics();
+   ilog( "Shared memory file: ${s} bytes, page size ${p}${h}, madvise hugepage ${t} random ${r} willneed ${w}, NUMA policy ${n}, ${b} bytes in huge pages",
+      ("s", segment_info.file_size)("p", segment_info.page_size)("h", segment_info.hugetlbfs ? " (hugetlbfs)" : "")
+      ("t", segment_info.transparent_huge_pages)("r", segment_info.random_access)("w", segment_info.prefault)
+      ("n", int( segment_info.numa_policy ))("b", segment_info.huge_page_bytes) );
+
+   if( !my->export_snapshot.empty() )
+   {
+      ilog( "Exporting state snapshot to ${f}", ("f", my->export_snapshot.generic_string()) );
+      my->db.with_read_lock( [&]()
+      {
+         my->db.export_snapshot( my->export_snapshot );
+      });
+   }
+
+   if( my->api_snapshot_reads )
+   {
+      ilog( "Copying state for snapshot reads" );
+      my->db.enable_snapshots();
+   }
+
    ilog( "Started on blockchain with ${n} blocks", ("n", my->db.head_block_num()) );
    on_sync();
 
+   my->start_signature_processing();
    my->start_write_processing();
 }
 
 void chain_plugin::plugin_shutdown()
 {
    ilog("closing chain database");
+   chain::util::disconnect_signal( my->pre_apply_block_conn );
+   my->stop_signature_processing();
    my->stop_write_processing();
    my->db.close();
    ilog("database closed successfully");
@@ -546,6 +850,9 @@ bool chain_plugin::accept_block( const steem::chain::signed_block& block, bool c
 
    check_time_in_block( block );
 
+   if( !( skip & ( database::skip_transaction_signatures | database::skip_authority_check ) ) )
+      my->precompute_signature_keys( block );
+
    boost::promise< void > prom;
    write_context cxt;
    cxt.req_ptr = &block;
@@ -563,6 +870,9 @@ bool chain_plugin::accept_block( const steem::chain::signed_block& block, bool c
 
 void chain_plugin::accept_transaction( const steem::chain::signed_transaction& trx )
 {
+   // Recover signature keys on the calling thread instead of the write thread
+   my->db.precompute_signature_keys( trx );
+
    boost::promise< void > prom;
    write_context cxt;
    cxt.req_ptr = &trx;
@@ -170,7 +170,11 @@ void reblog_evaluator::do_apply( const reblog_operation& o )
 
       performance_data pd;
 
-      if( _db.head_block_time() >= _plugin->start_feeds )
+      if( _db.head_block_time() >= _plugin->start_feeds && _plugin->defer_feed_updates )
+      {
+         _plugin->defer_feed_update( o.account, c.id, true );
+      }
+      else if( _db.head_block_time() >= _plugin->start_feeds )
       {
          while( itr != idx.end() && itr->following == o.account )
          {
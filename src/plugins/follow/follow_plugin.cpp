@@ -16,6 +16,9 @@
 #include <fc/smart_ref_impl.hpp>
 #include <fc/thread/thread.hpp>
 
+#include <boost/container/flat_map.hpp>
+
+#include <algorithm>
 #include <memory>
 
 namespace steem { namespace plugins { namespace follow {
@@ -34,11 +37,22 @@ class follow_plugin_impl
 
       void pre_operation( const operation_notification& op_obj );
       void post_operation( const operation_notification& op_obj );
+      void on_pre_apply_block( const block_notification& note );
+      void on_post_apply_block( const block_notification& note );
+
+      typedef std::pair< account_name_type, const deferred_feed_update* > follower_update;
+
+      void apply_feed_updates( const account_name_type& follower, const follower_update* begin, const follower_update* end );
 
       chain::database&     _db;
       follow_plugin&                _self;
       boost::signals2::connection   _pre_apply_operation_conn;
       boost::signals2::connection   _post_apply_operation_conn;
+      boost::signals2::connection   _pre_apply_block_conn;
+      boost::signals2::connection   _post_apply_block_conn;
+
+      /// Posts and reblogs of the current block, fanned out to the feeds of the followers in on_post_apply_block()
+      std::vector< deferred_feed_update > _feed_updates;
 };
 
 struct pre_operation_visitor
@@ -194,7 +208,11 @@ struct post_operation_visitor
 
          performance_data pd;
 
-         if( db.head_block_time() >= _plugin._self.start_feeds )
+         if( db.head_block_time() >= _plugin._self.start_feeds && _plugin._self.defer_feed_updates )
+         {
+            _plugin._self.defer_feed_update( op.author, c.id, false );
+         }
+         else if( db.head_block_time() >= _plugin._self.start_feeds )
          {
             while( itr != idx.end() && itr->following == op.author )
             {
@@ -314,6 +332,168 @@ void follow_plugin_impl::post_operation( const operation_notification& note )
    }
 }
 
+void follow_plugin_impl::on_pre_apply_block( const block_notification& note )
+{
+   // Updates queued by pending transactions refer to objects that are undone before the block is applied
+   _feed_updates.clear();
+}
+
+void follow_plugin_impl::on_post_apply_block( const block_notification& note )
+{
+   try
+   {
+      const auto& idx = _db.get_index< follow_index >().indices().get< by_following_follower >();
+      std::vector< follower_update > fan_out;
+
+      for( const auto& update : _feed_updates )
+      {
+         // The comment may have been deleted later in the block
+         if( _db.find( update.comment ) == nullptr ) continue;
+
+         for( auto itr = idx.find( update.account ); itr != idx.end() && itr->following == update.account; ++itr )
+         {
+            if( itr->what & ( 1 << blog ) )
+               fan_out.emplace_back( itr->follower, &update );
+         }
+      }
+
+      // Group by follower, keeping the block order of the updates of each follower
+      std::stable_sort( fan_out.begin(), fan_out.end(), []( const follower_update& a, const follower_update& b )
+      {
+         return a.first < b.first;
+      });
+
+      for( auto itr = fan_out.begin(); itr != fan_out.end(); )
+      {
+         auto follower_end = std::find_if( itr, fan_out.end(), [&]( const follower_update& u ){ return u.first != itr->first; } );
+         apply_feed_updates( itr->first, &*itr, &*itr + ( follower_end - itr ) );
+         itr = follower_end;
+      }
+   }
+   catch( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+   }
+   catch( ... )
+   {
+      elog( "unhandled exception" );
+   }
+
+   _feed_updates.clear();
+}
+
+/**
+ * Applies all updates of a block to the feed of one follower. Reblogs of posts already in the feed
+ * are added with one modify per entry. The feed is trimmed once for all new entries: they take the
+ * ids after the newest entry, and every entry more than max_feed_size ids older than the last new one
+ * is dropped, as the per operation fan-out does when it trims before each entry. Dropped entries are
+ * reused for new ones, and only the rest are created or removed.
+ */
+void follow_plugin_impl::apply_feed_updates( const account_name_type& follower, const follower_update* begin, const follower_update* end )
+{
+   struct new_feed_entry
+   {
+      comment_id_type                  comment;
+      std::vector< account_name_type > reblogged_by;
+      bool                             added_by_reblog = false;   ///< Only then the entry has a first reblog, as on the immediate path
+      time_point_sec                   first_reblogged_on;
+   };
+
+   const auto& comment_idx = _db.get_index< feed_index >().indices().get< by_comment >();
+   const auto& feed_idx = _db.get_index< feed_index >().indices().get< by_feed >();
+
+   std::vector< new_feed_entry > new_entries;
+   boost::container::flat_map< comment_id_type, size_t > new_entry_pos;
+   boost::container::flat_map< feed_id_type, std::vector< account_name_type > > reblogs;
+
+   for( auto itr = begin; itr != end; ++itr )
+   {
+      const auto* update = itr->second;
+      auto pos = new_entry_pos.find( update->comment );
+      if( pos != new_entry_pos.end() )
+      {
+         if( update->reblog )
+            new_entries[ pos->second ].reblogged_by.push_back( update->account );
+         continue;
+      }
+
+      auto feed_itr = comment_idx.find( boost::make_tuple( update->comment, follower ) );
+      if( feed_itr != comment_idx.end() )
+      {
+         if( update->reblog )
+            reblogs[ feed_itr->id ].push_back( update->account );
+         continue;
+      }
+
+      new_entry_pos[ update->comment ] = new_entries.size();
+      new_entries.push_back( new_feed_entry() );
+      new_entries.back().comment = update->comment;
+      if( update->reblog )
+      {
+         new_entries.back().reblogged_by.push_back( update->account );
+         new_entries.back().added_by_reblog = true;
+         new_entries.back().first_reblogged_on = update->time;
+      }
+   }
+
+   for( const auto& reblog : reblogs )
+   {
+      _db.modify( _db.get< feed_object >( reblog.first ), [&]( feed_object& f )
+      {
+         f.reblogged_by.insert( f.reblogged_by.end(), reblog.second.begin(), reblog.second.end() );
+      });
+   }
+
+   if( new_entries.empty() )
+      return;
+
+   // by_feed orders the feed of an account newest first
+   auto feed_begin = feed_idx.lower_bound( follower );
+   auto feed_end = feed_idx.upper_bound( follower );
+   uint32_t next_id = feed_begin != feed_end ? feed_begin->account_feed_id + 1 : 0;
+   uint32_t last_id = next_id + new_entries.size() - 1;
+
+   std::vector< const feed_object* > trimmed;
+   for( auto itr = feed_end; itr != feed_begin; )
+   {
+      --itr;
+      if( last_id - itr->account_feed_id <= _self.max_feed_size )
+         break;
+      trimmed.push_back( &*itr );
+   }
+
+   // More new entries than fit in the feed drop the oldest of them as well
+   size_t first_kept = new_entries.size() - 1 > _self.max_feed_size ? new_entries.size() - 1 - _self.max_feed_size : 0;
+
+   for( size_t i = first_kept; i < new_entries.size(); ++i )
+   {
+      const auto& entry = new_entries[i];
+      auto fill = [&]( feed_object& f )
+      {
+         f.account = follower;
+         f.reblogged_by.clear();
+         f.reblogged_by.insert( f.reblogged_by.end(), entry.reblogged_by.begin(), entry.reblogged_by.end() );
+         f.first_reblogged_by = entry.added_by_reblog ? entry.reblogged_by.front() : account_name_type();
+         f.first_reblogged_on = entry.added_by_reblog ? entry.first_reblogged_on : time_point_sec();
+         f.comment = entry.comment;
+         f.account_feed_id = next_id + i;
+      };
+
+      if( trimmed.size() )
+      {
+         _db.modify( *trimmed.back(), fill );
+         trimmed.pop_back();
+      }
+      else
+      {
+         _db.create< feed_object >( fill );
+      }
+   }
+
+   for( const auto* feed : trimmed )
+      _db.remove( *feed );
+}
+
 } // detail
 
 follow_plugin::follow_plugin() {}
@@ -328,6 +508,7 @@ void follow_plugin::set_program_options(
    cfg.add_options()
       ("follow-max-feed-size", boost::program_options::value< uint32_t >()->default_value( 500 ), "Set the maximum size of cached feed for an account" )
       ("follow-start-feeds", boost::program_options::value< uint32_t >()->default_value( 0 ), "Block time (in epoch seconds) when to start calculating feeds" )
+      ("follow-defer-feed-updates", boost::program_options::value< bool >()->default_value( false ), "Fan out posts and reblogs to the feeds of followers once at the end of each block instead of on every operation" )
       ;
 }
 
@@ -351,12 +532,12 @@ void follow_plugin::plugin_initialize( const boost::program_options::variables_m
 
       my->_pre_apply_operation_conn = my->_db.add_pre_apply_operation_handler( [&]( const operation_notification& note ){ my->pre_operation( note ); }, *this, 0 );
       my->_post_apply_operation_conn = my->_db.add_post_apply_operation_handler( [&]( const operation_notification& note ){ my->post_operation( note ); }, *this, 0 );
-      add_plugin_index< follow_index            >( my->_db );
-      add_plugin_index< feed_index              >( my->_db );
-      add_plugin_index< blog_index              >( my->_db );
-      add_plugin_index< reputation_index        >( my->_db );
-      add_plugin_index< follow_count_index      >( my->_db );
-      add_plugin_index< blog_author_stats_index >( my->_db );
+      add_plugin_index< follow_index            >( my->_db, STEEM_FOLLOW_PLUGIN_NAME );
+      add_plugin_index< feed_index              >( my->_db, STEEM_FOLLOW_PLUGIN_NAME );
+      add_plugin_index< blog_index              >( my->_db, STEEM_FOLLOW_PLUGIN_NAME );
+      add_plugin_index< reputation_index        >( my->_db, STEEM_FOLLOW_PLUGIN_NAME );
+      add_plugin_index< follow_count_index      >( my->_db, STEEM_FOLLOW_PLUGIN_NAME );
+      add_plugin_index< blog_author_stats_index >( my->_db, STEEM_FOLLOW_PLUGIN_NAME );
 
 
       if( options.count( "follow-max-feed-size" ) )
@@ -369,16 +550,30 @@ void follow_plugin::plugin_initialize( const boost::program_options::variables_m
       {
          start_feeds = fc::time_point_sec( options[ "follow-start-feeds" ].as< uint32_t >() );
       }
+
+      defer_feed_updates = options.at( "follow-defer-feed-updates" ).as< bool >();
+      if( defer_feed_updates )
+      {
+         my->_pre_apply_block_conn = my->_db.add_pre_apply_block_handler( [&]( const block_notification& note ){ my->on_pre_apply_block( note ); }, *this, 0 );
+         my->_post_apply_block_conn = my->_db.add_post_apply_block_handler( [&]( const block_notification& note ){ my->on_post_apply_block( note ); }, *this, 0 );
+      }
    }
    FC_CAPTURE_AND_RETHROW()
 }
 
+void follow_plugin::defer_feed_update( const account_name_type& account, comment_id_type comment, bool reblog )
+{
+   my->_feed_updates.push_back( deferred_feed_update{ account, comment, reblog, my->_db.head_block_time() } );
+}
+
 void follow_plugin::plugin_startup() {}
 
 void follow_plugin::plugin_shutdown()
 {
    chain::util::disconnect_signal( my->_pre_apply_operation_conn );
    chain::util::disconnect_signal( my->_post_apply_operation_conn );
+   chain::util::disconnect_signal( my->_pre_apply_block_conn );
+   chain::util::disconnect_signal( my->_post_apply_block_conn );
 }
 
 } } } // steem::plugins::follow
@@ -15,6 +15,17 @@ namespace detail { class follow_plugin_impl; }
 
 using namespace appbase;
 using steem::chain::generic_custom_operation_interpreter;
+using steem::chain::comment_id_type;
+using steem::protocol::account_name_type;
+
+/// A post or reblog whose fan-out to the feeds of followers is deferred to the end of the block
+struct deferred_feed_update
+{
+   account_name_type    account;
+   comment_id_type      comment;
+   bool                 reblog = false;
+   fc::time_point_sec   time;
+};
 
 class follow_plugin : public appbase::plugin< follow_plugin >
 {
@@ -33,8 +44,12 @@ class follow_plugin : public appbase::plugin< follow_plugin >
       virtual void plugin_startup() override;
       virtual void plugin_shutdown() override;
 
+      /// Queues the fan-out of a post or reblog by account when defer_feed_updates is set
+      void defer_feed_update( const account_name_type& account, comment_id_type comment, bool reblog );
+
       uint32_t max_feed_size = 500;
       fc::time_point_sec start_feeds;
+      bool defer_feed_updates = false;
 
       std::shared_ptr< generic_custom_operation_interpreter< follow_plugin_operation > > _custom_operation_interpreter;
 
@@ -7,6 +7,7 @@
 
 #include <boost/preprocessor/seq/for_each.hpp>
 #include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/tuple/elem.hpp>
 
 #define DECLARE_API_METHOD_HELPER( r, data, method ) \
 BOOST_PP_CAT( method, _return ) method( const BOOST_PP_CAT( method, _args )& args, bool lock = false );
@@ -44,6 +45,24 @@ BOOST_PP_CAT( method, _return ) class :: method ( const BOOST_PP_CAT( method, _a
 
 #define DEFINE_READ_API_HELPER( r, class, method )                                                       \
 BOOST_PP_CAT( method, _return ) class :: method ( const BOOST_PP_CAT( method, _args )& args, bool lock ) \
+{                                                                                                        \
+   if( lock && my->_db.has_snapshots() )                                                                 \
+   {                                                                                                     \
+      return my->_db.with_snapshot_read( [&args, this](){ return my->method( args ); });                 \
+   }                                                                                                     \
+   else if( lock )                                                                                       \
+   {                                                                                                     \
+      return my->_db.with_read_lock( [&args, this](){ return my->method( args ); });                     \
+   }                                                                                                     \
+   else                                                                                                  \
+   {                                                                                                     \
+      return my->method( args );                                                                         \
+   }                                                                                                     \
+}
+
+/* Read APIs that use state outside of chainbase, such as the fork database, always take the read lock */
+#define DEFINE_LOCKED_READ_API_HELPER( r, class, method )                                                \
+BOOST_PP_CAT( method, _return ) class :: method ( const BOOST_PP_CAT( method, _args )& args, bool lock ) \
 {                                                                                                        \
    if( lock )                                                                                            \
    {                                                                                                     \
@@ -55,6 +74,23 @@ BOOST_PP_CAT( method, _return ) class :: method ( const BOOST_PP_CAT( method, _a
    }                                                                                                     \
 }
 
+/* data is ( class, lock group ), see chainbase::database::set_lock_group. The readers do not take the database
+   lock: they never see a failed pending transaction, but may see a block half applied or one that is undone. */
+#define DEFINE_LOCK_GROUP_READ_API_HELPER( r, data, method )                                              \
+BOOST_PP_CAT( method, _return ) BOOST_PP_TUPLE_ELEM( 2, 0, data ) :: method (                             \
+   const BOOST_PP_CAT( method, _args )& args, bool lock )                                                \
+{                                                                                                        \
+   if( lock )                                                                                            \
+   {                                                                                                     \
+      return my->_db.with_read_lock( BOOST_PP_TUPLE_ELEM( 2, 1, data ),                                  \
+         [&args, this](){ return my->method( args ); });                                                 \
+   }                                                                                                     \
+   else                                                                                                  \
+   {                                                                                                     \
+      return my->method( args );                                                                         \
+   }                                                                                                     \
+}
+
 #define DEFINE_WRITE_API_HELPER( r, class, method )                                                      \
 BOOST_PP_CAT( method, _return ) class :: method ( const BOOST_PP_CAT( method, _args )& args, bool lock ) \
 {                                                                                                        \
@@ -78,6 +114,12 @@ BOOST_PP_CAT( method, _return ) class :: method ( const BOOST_PP_CAT( method, _a
 #define DEFINE_READ_APIS( class, METHODS ) \
    BOOST_PP_SEQ_FOR_EACH( DEFINE_READ_API_HELPER, class, METHODS )
 
+#define DEFINE_LOCKED_READ_APIS( class, METHODS ) \
+   BOOST_PP_SEQ_FOR_EACH( DEFINE_LOCKED_READ_API_HELPER, class, METHODS )
+
+#define DEFINE_LOCK_GROUP_READ_APIS( class, group, METHODS ) \
+   BOOST_PP_SEQ_FOR_EACH( DEFINE_LOCK_GROUP_READ_API_HELPER, ( class, group ), METHODS )
+
 #define DEFINE_WRITE_APIS( class, METHODS ) \
    BOOST_PP_SEQ_FOR_EACH( DEFINE_WRITE_API_HELPER, class, METHODS )
 
@@ -160,8 +160,8 @@ void market_history_plugin::plugin_initialize( const boost::program_options::var
       my = std::make_unique< detail::market_history_plugin_impl >();
 
       my->_post_apply_operation_conn = my->_db.add_post_apply_operation_handler( [&]( const operation_notification& note ){ my->on_post_apply_operation( note ); }, *this, 0 );
-      add_plugin_index< bucket_index        >( my->_db );
-      add_plugin_index< order_history_index >( my->_db );
+      add_plugin_index< bucket_index        >( my->_db, STEEM_MARKET_HISTORY_PLUGIN_NAME );
+      add_plugin_index< order_history_index >( my->_db, STEEM_MARKET_HISTORY_PLUGIN_NAME );
 
       if( options.count("bucket-size" ) )
       {
@@ -45,7 +45,8 @@ enum
    tag_object_type              = ( STEEM_TAG_SPACE_ID << 8 ),
    tag_stats_object_type        = ( STEEM_TAG_SPACE_ID << 8 ) + 1,
    peer_stats_object_type       = ( STEEM_TAG_SPACE_ID << 8 ) + 2,
-   author_tag_stats_object_type = ( STEEM_TAG_SPACE_ID << 8 ) + 3
+   author_tag_stats_object_type = ( STEEM_TAG_SPACE_ID << 8 ) + 3,
+   tag_sort_object_type         = ( STEEM_TAG_SPACE_ID << 8 ) + 4
 };
 
 namespace detail { class tags_plugin_impl; }
@@ -61,6 +62,7 @@ namespace detail { class tags_plugin_impl; }
  *  4. netvotes - individual accounts voting for post minus accounts voting against it
  *
  *  When ever a comment is modified, all tag_objects for that comment are updated to match.
+ *  The sort orders live in tag_sort_index, this index only holds the orderings the plugin looks tags up by.
  */
 class tag_object : public object< tag_object_type, tag_object >
 {
@@ -128,90 +130,139 @@ typedef multi_index_container<
                member< tag_object, tag_id_type, &tag_object::id >
             >,
             composite_key_compare< std::less< account_id_type >, std::less< comment_id_type >, std::less< tag_id_type > >
-      >,
+      >
+   >,
+   allocator< tag_object >
+> tag_index;
+
+/**
+ *  The sort orders of the tag_objects, which only the tags API reads. Each tag_object has one
+ *  tag_sort_object with a copy of its sort keys, so a replay leaves this index empty and builds it
+ *  from tag_index once all blocks are applied, see database::set_deferred_index_builder().
+ */
+class tag_sort_object : public object< tag_sort_object_type, tag_sort_object >
+{
+   public:
+      template< typename Constructor, typename Allocator >
+      tag_sort_object( Constructor&& c, allocator< Allocator > a )
+      {
+         c( *this );
+      }
+
+      tag_sort_object() {}
+
+      id_type           id;
+
+      tag_id_type       tag_id;
+      tag_name_type     tag;
+      time_point_sec    created;
+      time_point_sec    active;
+      time_point_sec    cashout;
+      int64_t           net_rshares = 0;
+      int32_t           net_votes   = 0;
+      int32_t           children    = 0;
+      double            hot         = 0;
+      double            trending    = 0;
+      share_type        promoted_balance = 0;
+
+      comment_id_type   parent;
+      comment_id_type   comment;
+
+      bool is_post()const { return parent == comment_id_type(); }
+};
+
+typedef oid< tag_sort_object > tag_sort_id_type;
+
+struct by_tag_id;
+
+typedef multi_index_container<
+   tag_sort_object,
+   indexed_by<
+      ordered_unique< tag< by_id >, member< tag_sort_object, tag_sort_id_type, &tag_sort_object::id > >,
+      ordered_unique< tag< by_tag_id >, member< tag_sort_object, tag_id_type, &tag_sort_object::tag_id > >,
       ordered_unique< tag< by_parent_created >,
-            composite_key< tag_object,
-               member< tag_object, tag_name_type, &tag_object::tag >,
-               member< tag_object, comment_id_type, &tag_object::parent >,
-               member< tag_object, time_point_sec, &tag_object::created >,
-               member<tag_object, tag_id_type, &tag_object::id >
+            composite_key< tag_sort_object,
+               member< tag_sort_object, tag_name_type, &tag_sort_object::tag >,
+               member< tag_sort_object, comment_id_type, &tag_sort_object::parent >,
+               member< tag_sort_object, time_point_sec, &tag_sort_object::created >,
+               member<tag_sort_object, tag_sort_id_type, &tag_sort_object::id >
             >,
-            composite_key_compare< std::less< tag_name_type >, std::less<comment_id_type>, std::greater< time_point_sec >, std::less< tag_id_type > >
+            composite_key_compare< std::less< tag_name_type >, std::less<comment_id_type>, std::greater< time_point_sec >, std::less< tag_sort_id_type > >
       >,
       ordered_unique< tag< by_parent_active >,
-            composite_key< tag_object,
-               member< tag_object, tag_name_type, &tag_object::tag >,
-               member< tag_object, comment_id_type, &tag_object::parent >,
-               member< tag_object, time_point_sec, &tag_object::active >,
-               member< tag_object, tag_id_type, &tag_object::id >
+            composite_key< tag_sort_object,
+               member< tag_sort_object, tag_name_type, &tag_sort_object::tag >,
+               member< tag_sort_object, comment_id_type, &tag_sort_object::parent >,
+               member< tag_sort_object, time_point_sec, &tag_sort_object::active >,
+               member< tag_sort_object, tag_sort_id_type, &tag_sort_object::id >
             >,
-            composite_key_compare< std::less<tag_name_type>, std::less<comment_id_type>, std::greater< time_point_sec >, std::less< tag_id_type > >
+            composite_key_compare< std::less<tag_name_type>, std::less<comment_id_type>, std::greater< time_point_sec >, std::less< tag_sort_id_type > >
       >,
       ordered_unique< tag< by_parent_promoted >,
-            composite_key< tag_object,
-               member< tag_object, tag_name_type, &tag_object::tag >,
-               member< tag_object, comment_id_type, &tag_object::parent >,
-               member< tag_object, share_type, &tag_object::promoted_balance >,
-               member< tag_object, tag_id_type, &tag_object::id >
+            composite_key< tag_sort_object,
+               member< tag_sort_object, tag_name_type, &tag_sort_object::tag >,
+               member< tag_sort_object, comment_id_type, &tag_sort_object::parent >,
+               member< tag_sort_object, share_type, &tag_sort_object::promoted_balance >,
+               member< tag_sort_object, tag_sort_id_type, &tag_sort_object::id >
             >,
-            composite_key_compare< std::less<tag_name_type>, std::less<comment_id_type>, std::greater< share_type >, std::less< tag_id_type > >
+            composite_key_compare< std::less<tag_name_type>, std::less<comment_id_type>, std::greater< share_type >, std::less< tag_sort_id_type > >
       >,
       ordered_unique< tag< by_parent_net_votes >,
-            composite_key< tag_object,
-               member< tag_object, tag_name_type, &tag_object::tag >,
-               member< tag_object, comment_id_type, &tag_object::parent >,
-               member< tag_object, int32_t, &tag_object::net_votes >,
-               member< tag_object, tag_id_type, &tag_object::id >
+            composite_key< tag_sort_object,
+               member< tag_sort_object, tag_name_type, &tag_sort_object::tag >,
+               member< tag_sort_object, comment_id_type, &tag_sort_object::parent >,
+               member< tag_sort_object, int32_t, &tag_sort_object::net_votes >,
+               member< tag_sort_object, tag_sort_id_type, &tag_sort_object::id >
             >,
-            composite_key_compare< std::less<tag_name_type>, std::less<comment_id_type>, std::greater< int32_t >, std::less< tag_id_type > >
+            composite_key_compare< std::less<tag_name_type>, std::less<comment_id_type>, std::greater< int32_t >, std::less< tag_sort_id_type > >
       >,
       ordered_unique< tag< by_parent_children >,
-            composite_key< tag_object,
-               member< tag_object, tag_name_type, &tag_object::tag >,
-               member< tag_object, comment_id_type, &tag_object::parent >,
-               member< tag_object, int32_t, &tag_object::children >,
-               member< tag_object, tag_id_type, &tag_object::id >
+            composite_key< tag_sort_object,
+               member< tag_sort_object, tag_name_type, &tag_sort_object::tag >,
+               member< tag_sort_object, comment_id_type, &tag_sort_object::parent >,
+               member< tag_sort_object, int32_t, &tag_sort_object::children >,
+               member< tag_sort_object, tag_sort_id_type, &tag_sort_object::id >
             >,
-            composite_key_compare< std::less<tag_name_type>, std::less<comment_id_type>, std::greater< int32_t >, std::less< tag_id_type > >
+            composite_key_compare< std::less<tag_name_type>, std::less<comment_id_type>, std::greater< int32_t >, std::less< tag_sort_id_type > >
       >,
       ordered_unique< tag< by_parent_hot >,
-            composite_key< tag_object,
-               member< tag_object, tag_name_type, &tag_object::tag >,
-               member< tag_object, comment_id_type, &tag_object::parent >,
-               member< tag_object, double, &tag_object::hot >,
-               member< tag_object, tag_id_type, &tag_object::id >
+            composite_key< tag_sort_object,
+               member< tag_sort_object, tag_name_type, &tag_sort_object::tag >,
+               member< tag_sort_object, comment_id_type, &tag_sort_object::parent >,
+               member< tag_sort_object, double, &tag_sort_object::hot >,
+               member< tag_sort_object, tag_sort_id_type, &tag_sort_object::id >
             >,
-            composite_key_compare< std::less<tag_name_type>, std::less<comment_id_type>, std::greater< double >, std::less< tag_id_type > >
+            composite_key_compare< std::less<tag_name_type>, std::less<comment_id_type>, std::greater< double >, std::less< tag_sort_id_type > >
       >,
       ordered_unique< tag< by_parent_trending >,
-            composite_key< tag_object,
-               member< tag_object, tag_name_type, &tag_object::tag >,
-               member< tag_object, comment_id_type, &tag_object::parent >,
-               member< tag_object, double, &tag_object::trending >,
-               member< tag_object, tag_id_type, &tag_object::id >
+            composite_key< tag_sort_object,
+               member< tag_sort_object, tag_name_type, &tag_sort_object::tag >,
+               member< tag_sort_object, comment_id_type, &tag_sort_object::parent >,
+               member< tag_sort_object, double, &tag_sort_object::trending >,
+               member< tag_sort_object, tag_sort_id_type, &tag_sort_object::id >
             >,
-            composite_key_compare< std::less<tag_name_type>, std::less<comment_id_type>, std::greater< double >, std::less< tag_id_type > >
+            composite_key_compare< std::less<tag_name_type>, std::less<comment_id_type>, std::greater< double >, std::less< tag_sort_id_type > >
       >,
       ordered_unique< tag< by_cashout >,
-            composite_key< tag_object,
-               member< tag_object, tag_name_type, &tag_object::tag >,
-               member< tag_object, time_point_sec, &tag_object::cashout >,
-               member< tag_object, tag_id_type, &tag_object::id >
+            composite_key< tag_sort_object,
+               member< tag_sort_object, tag_name_type, &tag_sort_object::tag >,
+               member< tag_sort_object, time_point_sec, &tag_sort_object::cashout >,
+               member< tag_sort_object, tag_sort_id_type, &tag_sort_object::id >
             >,
-            composite_key_compare< std::less<tag_name_type>, std::less< time_point_sec >, std::less< tag_id_type > >
+            composite_key_compare< std::less<tag_name_type>, std::less< time_point_sec >, std::less< tag_sort_id_type > >
       >,
       ordered_unique< tag< by_reward_fund_net_rshares >,
-            composite_key< tag_object,
-               member< tag_object, tag_name_type, &tag_object::tag >,
-               const_mem_fun< tag_object, bool, &tag_object::is_post >,
-               member< tag_object, int64_t, &tag_object::net_rshares >,
-               member< tag_object, tag_id_type, &tag_object::id >
+            composite_key< tag_sort_object,
+               member< tag_sort_object, tag_name_type, &tag_sort_object::tag >,
+               const_mem_fun< tag_sort_object, bool, &tag_sort_object::is_post >,
+               member< tag_sort_object, int64_t, &tag_sort_object::net_rshares >,
+               member< tag_sort_object, tag_sort_id_type, &tag_sort_object::id >
             >,
-            composite_key_compare< std::less<tag_name_type>, std::less< bool >,std::greater< int64_t >, std::less< tag_id_type > >
+            composite_key_compare< std::less<tag_name_type>, std::less< bool >,std::greater< int64_t >, std::less< tag_sort_id_type > >
       >
    >,
-   allocator< tag_object >
-> tag_index;
+   allocator< tag_sort_object >
+> tag_sort_index;
 
 /**
  *  The purpose of this index is to quickly identify how popular various tags by maintaining variou sums over
@@ -388,6 +439,10 @@ FC_REFLECT( steem::plugins::tags::tag_object,
    (id)(tag)(created)(active)(cashout)(net_rshares)(net_votes)(hot)(trending)(promoted_balance)(children)(author)(parent)(comment) )
 CHAINBASE_SET_INDEX_TYPE( steem::plugins::tags::tag_object, steem::plugins::tags::tag_index )
 
+FC_REFLECT( steem::plugins::tags::tag_sort_object,
+   (id)(tag_id)(tag)(created)(active)(cashout)(net_rshares)(net_votes)(hot)(trending)(promoted_balance)(children)(parent)(comment) )
+CHAINBASE_SET_INDEX_TYPE( steem::plugins::tags::tag_sort_object, steem::plugins::tags::tag_sort_index )
+
 FC_REFLECT( steem::plugins::tags::tag_stats_object,
    (id)(tag)(total_payout)(net_votes)(top_posts)(comments)(total_trending) );
 CHAINBASE_SET_INDEX_TYPE( steem::plugins::tags::tag_stats_object, steem::plugins::tags::tag_stats_index )
@@ -50,6 +50,46 @@ namespace detail {
 
 using namespace steem::protocol;
 
+void copy_sort_keys( tag_sort_object& s, const tag_object& t )
+{
+   s.tag_id           = t.id;
+   s.tag              = t.tag;
+   s.created          = t.created;
+   s.active           = t.active;
+   s.cashout          = t.cashout;
+   s.net_rshares      = t.net_rshares;
+   s.net_votes        = t.net_votes;
+   s.children         = t.children;
+   s.hot              = t.hot;
+   s.trending         = t.trending;
+   s.promoted_balance = t.promoted_balance;
+   s.parent           = t.parent;
+   s.comment          = t.comment;
+}
+
+/// Keeps the tag_sort_object of t in sync, unless the replay builds the sort index afterwards
+void create_sort_keys( database& db, const tag_object& t )
+{
+   if( db.is_index_deferred< tag_sort_index >() )
+      return;
+
+   db.create< tag_sort_object >( [&]( tag_sort_object& s ) { copy_sort_keys( s, t ); } );
+}
+
+void update_sort_keys( database& db, const tag_object& t )
+{
+   const auto* sort_keys = db.is_index_deferred< tag_sort_index >() ? nullptr : db.find< tag_sort_object, by_tag_id >( t.id );
+   if( sort_keys != nullptr )
+      db.modify( *sort_keys, [&]( tag_sort_object& s ) { copy_sort_keys( s, t ); } );
+}
+
+void remove_sort_keys( database& db, const tag_object& t )
+{
+   const auto* sort_keys = db.is_index_deferred< tag_sort_index >() ? nullptr : db.find< tag_sort_object, by_tag_id >( t.id );
+   if( sort_keys != nullptr )
+      db.remove( *sort_keys );
+}
+
 class tags_plugin_impl
 {
    public:
@@ -58,19 +98,25 @@ class tags_plugin_impl
 
       void on_pre_apply_operation( const operation_notification& note );
       void on_post_apply_operation( const operation_notification& note );
+      void on_post_apply_block( const block_notification& note );
 
       chain::database&     _db;
       fc::time_point_sec   _promoted_start_time;
       bool                 _started = false;
+      bool                 _defer_score_updates = false;
       boost::signals2::connection   _pre_apply_operation_conn;
       boost::signals2::connection   _post_apply_operation_conn;
+      boost::signals2::connection   _post_apply_block_conn;
       boost::signals2::connection   on_sync_connection;
 
+      /// Comments voted on since the last block, their scores are updated once in on_post_apply_block()
+      flat_set< comment_id_type >   _dirty_comments;
+
       void remove_stats( const tag_object& tag, const tag_stats_object& stats )const;
       void add_stats( const tag_object& tag, const tag_stats_object& stats )const;
       void remove_tag( const tag_object& tag )const;
       const tag_stats_object& get_stats( const string& tag )const;
-      comment_metadata filter_tags( const comment_object& c, const comment_content_object& con )const;
+      comment_metadata filter_tags( const comment_object& c, const comment_content& con )const;
       void update_tag( const tag_object& current, const comment_object& comment, double hot, double trending )const;
       void create_tag( const string& tag, const comment_object& comment, double hot, double trending )const;
       void update_tags( const comment_object& c, bool parse_tags = false )const;
@@ -118,6 +164,7 @@ void tags_plugin_impl::add_stats( const tag_object& tag, const tag_stats_object&
 void tags_plugin_impl::remove_tag( const tag_object& tag )const
 {
    /// TODO: update tag stats object
+   remove_sort_keys( _db, tag );
    _db.remove(tag);
 
    const auto& idx = _db.get_index<author_tag_stats_index>().indices().get<by_author_tag_posts>();
@@ -144,7 +191,7 @@ const tag_stats_object& tags_plugin_impl::get_stats( const string& tag )const
    });
 }
 
-comment_metadata tags_plugin_impl::filter_tags( const comment_object& c, const comment_content_object& con ) const
+comment_metadata tags_plugin_impl::filter_tags( const comment_object& c, const comment_content& con ) const
 {
    comment_metadata meta;
 
@@ -152,7 +199,7 @@ comment_metadata tags_plugin_impl::filter_tags( const comment_object& c, const c
    {
       try
       {
-         meta = fc::json::from_string( to_string( con.json_metadata ) ).as< comment_metadata >();
+         meta = fc::json::from_string( con.json_metadata ).as< comment_metadata >();
       }
       catch( const fc::exception& e )
       {
@@ -205,8 +252,10 @@ void tags_plugin_impl::update_tag( const tag_object& current, const comment_obje
           if( obj.cashout == fc::time_point_sec() )
             obj.promoted_balance = 0;
       });
+      update_sort_keys( _db, current );
       add_stats( current, stats );
     } else {
+       remove_sort_keys( _db, current );
        _db.remove( current );
     }
 }
@@ -234,6 +283,7 @@ void tags_plugin_impl::create_tag( const string& tag, const comment_object& comm
        obj.hot               = hot;
        obj.trending          = trending;
    });
+   create_sort_keys( _db, tag_obj );
    add_stats( tag_obj, get_stats( tag ) );
 
 
@@ -270,7 +320,7 @@ void tags_plugin_impl::update_tags( const comment_object& c, bool parse_tags )co
 #ifndef IS_LOW_MEM
    if( parse_tags )
    {
-      auto meta = filter_tags( c, _db.get< comment_content_object, chain::by_comment >( c.id ) );
+      auto meta = filter_tags( c, _db.get_comment_content( c.id ) );
       auto citr = comment_idx.lower_bound( c.id );
 
       map< string, const tag_object* > existing_tags;
@@ -336,7 +386,7 @@ struct pre_apply_operation_visitor
 
    void operator()( const delete_comment_operation& op )const
    {
-      const auto& comment = _db.find< comment_object, chain::by_permlink >( boost::make_tuple( op.author, op.permlink ) );
+      const auto& comment = _db.find_comment( op.author, op.permlink );
 
       if( comment == nullptr )
          return;
@@ -355,6 +405,7 @@ struct pre_apply_operation_visitor
 
       for( const auto* tag_ptr : to_remove )
       {
+         remove_sort_keys( _db, *tag_ptr );
          _db.remove( *tag_ptr );
       }
    }
@@ -404,6 +455,7 @@ struct operation_visitor
                       if( t.cashout != fc::time_point_sec::maximum() )
                           t.promoted_balance += op.amount.amount;
                   });
+                  update_sort_keys( _my._db, *citr );
                   ++citr;
                }
             }
@@ -419,7 +471,12 @@ struct operation_visitor
    {
       if( _my._started )
       {
-         _my.update_tags( _my._db.get_comment( op.author, op.permlink ) );
+         const auto& c = _my._db.get_comment( op.author, op.permlink );
+
+         if( _my._defer_score_updates )
+            _my._dirty_comments.insert( c.id );
+         else
+            _my.update_tags( c );
       }
    }
 
@@ -429,7 +486,7 @@ struct operation_visitor
          _my.update_tags( c );
 
 #ifndef IS_LOW_MEM
-         comment_metadata meta = _my.filter_tags( c, _my._db.get< comment_content_object, chain::by_comment >( c.id ) );
+         comment_metadata meta = _my.filter_tags( c, _my._db.get_comment_content( c.id ) );
 
          for( const string& tag : meta.tags )
          {
@@ -485,6 +542,30 @@ void tags_plugin_impl::on_post_apply_operation( const operation_notification& no
    }
 }
 
+void tags_plugin_impl::on_post_apply_block( const block_notification& note )
+{
+   try
+   {
+      // Votes of pending transactions that did not make it into the block only cause a recomputation
+      for( const auto& id : _dirty_comments )
+      {
+         const auto* c = _db.find( id );
+         if( c != nullptr )
+            update_tags( *c );
+      }
+   }
+   catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+   }
+   catch ( ... )
+   {
+      elog( "unhandled exception" );
+   }
+
+   _dirty_comments.clear();
+}
+
 } /// end detail namespace
 
 tags_plugin::tags_plugin() {}
@@ -498,6 +579,7 @@ void tags_plugin::set_program_options(
    cfg.add_options()
       ("tags-start-promoted", boost::program_options::value< uint32_t >()->default_value( 0 ), "Block time (in epoch seconds) when to start calculating promoted content. Should be 1 week prior to current time." )
       ("tags-skip-startup-update", bpo::bool_switch()->default_value(false), "Skip updating tags on startup. Can safely be skipped when starting a previously running node. Should not be skipped when reindexing.")
+      ("tags-defer-score-updates", bpo::bool_switch()->default_value(false), "Update the hot and trending scores of voted comments once at the end of each block instead of on every vote.")
       ;
 }
 
@@ -509,6 +591,10 @@ void tags_plugin::plugin_initialize(const boost::program_options::variables_map&
    my->_pre_apply_operation_conn = my->_db.add_pre_apply_operation_handler( [&]( const operation_notification& note ){ my->on_pre_apply_operation( note ); }, *this, 0 );
    my->_post_apply_operation_conn = my->_db.add_post_apply_operation_handler( [&]( const operation_notification& note ){ my->on_post_apply_operation( note ); }, *this, 0 );
 
+   my->_defer_score_updates = options.at( "tags-defer-score-updates" ).as< bool >();
+   if( my->_defer_score_updates )
+      my->_post_apply_block_conn = my->_db.add_post_apply_block_handler( [&]( const block_notification& note ){ my->on_post_apply_block( note ); }, *this, 0 );
+
    if( !options.at( "tags-skip-startup-update" ).as< bool >() )
    {
       my->on_sync_connection = appbase::app().get_plugin< chain::chain_plugin >().on_sync.connect( 0, [this]()
@@ -527,9 +613,22 @@ void tags_plugin::plugin_initialize(const boost::program_options::variables_map&
    }
 
    add_plugin_index< tag_index               >( my->_db );
+   add_plugin_index< tag_sort_index          >( my->_db );
    add_plugin_index< tag_stats_index         >( my->_db );
    add_plugin_index< author_tag_stats_index  >( my->_db );
 
+   my->_db.set_deferred_index_builder< tag_sort_index >( [this]()
+   {
+      const auto& tags = my->_db.get_index< tag_index >().indices();
+      auto itr = tags.begin();
+
+      my->_db.bulk_create< tag_sort_object >( tags.size(), [&]( tag_sort_object& s, size_t )
+      {
+         detail::copy_sort_keys( s, *itr );
+         ++itr;
+      });
+   });
+
    if( options.count( "tags-start-promoted" ) )
    {
       my->_promoted_start_time = fc::time_point_sec( options[ "tags-start-promoted" ].as< uint32_t >() );
@@ -547,6 +646,7 @@ void tags_plugin::plugin_startup()
 {
    chain::util::disconnect_signal( my->_pre_apply_operation_conn );
    chain::util::disconnect_signal( my->_post_apply_operation_conn );
+   chain::util::disconnect_signal( my->_post_apply_block_conn );
 }
 
 } } } /// steem::plugins::tags
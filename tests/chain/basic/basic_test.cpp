@@ -25,8 +25,10 @@
 #include <boost/test/unit_test.hpp>
 
 #include <steem/chain/database.hpp>
+#include <steem/chain/utils/block_conflict_analyzer.hpp>
 #include <steem/protocol/protocol.hpp>
 
+#include <steem/protocol/signature_key_cache.hpp>
 #include <steem/protocol/steem_operations.hpp>
 
 #include <fc/crypto/digest.hpp>
@@ -324,4 +326,107 @@ BOOST_AUTO_TEST_CASE( calculate_merkle_root )
    BOOST_CHECK( block.calculate_merkle_root() == c(dO) );
 }
 
+BOOST_AUTO_TEST_CASE( signature_key_cache )
+{
+   auto alice_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "alice" ) ) );
+   auto bob_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "bob" ) ) );
+
+   signed_transaction tx;
+   transfer_operation op;
+   op.from = "alice";
+   op.to = "bob";
+   op.amount = asset( 1, STEEM_SYMBOL );
+   tx.operations.push_back( op );
+   tx.sign( alice_key, STEEM_CHAIN_ID );
+   tx.sign( bob_key, STEEM_CHAIN_ID );
+
+   steem::protocol::signature_key_cache cache( 2 );
+   auto digest = tx.sig_digest( STEEM_CHAIN_ID );
+
+   auto keys = cache.recover( digest, tx.signatures );
+   BOOST_REQUIRE_EQUAL( keys.size(), 2 );
+   BOOST_CHECK( keys[0] == public_key_type( alice_key.get_public_key() ) );
+   BOOST_CHECK( keys[1] == public_key_type( bob_key.get_public_key() ) );
+   BOOST_CHECK_EQUAL( cache.misses(), 2 );
+   BOOST_CHECK_EQUAL( cache.hits(), 0 );
+
+   keys = cache.recover( digest, tx.signatures );
+   BOOST_CHECK( keys[0] == public_key_type( alice_key.get_public_key() ) );
+   BOOST_CHECK( keys[1] == public_key_type( bob_key.get_public_key() ) );
+   BOOST_CHECK_EQUAL( cache.misses(), 2 );
+   BOOST_CHECK_EQUAL( cache.hits(), 2 );
+
+   // A third key evicts the least recently used entry
+   auto charlie_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "charlie" ) ) );
+   tx.sign( charlie_key, STEEM_CHAIN_ID );
+   keys = cache.recover( digest, tx.signatures );
+   BOOST_CHECK( keys[2] == public_key_type( charlie_key.get_public_key() ) );
+   BOOST_CHECK_EQUAL( cache.size(), 2 );
+
+   BOOST_CHECK( tx.get_signature_keys( STEEM_CHAIN_ID ).size() == 3 );
+}
+
+BOOST_AUTO_TEST_CASE( block_conflict_analysis )
+{
+   signed_block block;
+
+   auto add_transaction = [&]( const operation& op )
+   {
+      signed_transaction tx;
+      tx.operations.push_back( op );
+      block.transactions.push_back( tx );
+   };
+
+   transfer_operation transfer;
+   transfer.from = "alice";
+   transfer.to = "bob";
+   transfer.amount = ASSET( "1.000 TESTS" );
+   add_transaction( transfer );
+
+   vote_operation vote;
+   vote.voter = "carol";
+   vote.author = "dave";
+   vote.permlink = "test";
+   vote.weight = STEEM_100_PERCENT;
+   add_transaction( vote );
+
+   BOOST_TEST_MESSAGE( "--- Transactions sharing an account conflict" );
+   transfer.from = "bob";
+   transfer.to = "eve";
+   add_transaction( transfer );
+
+   BOOST_TEST_MESSAGE( "--- Transactions writing the order book conflict" );
+   limit_order_create_operation order;
+   order.owner = "frank";
+   order.amount_to_sell = ASSET( "1.000 TESTS" );
+   order.min_to_receive = ASSET( "1.000 TBD" );
+   add_transaction( order );
+
+   order.owner = "gina";
+   add_transaction( order );
+
+   BOOST_TEST_MESSAGE( "--- A transaction joins the groups of all its resources" );
+   transfer.from = "eve";
+   transfer.to = "frank";
+   add_transaction( transfer );
+
+   BOOST_TEST_MESSAGE( "--- Creating vesting conflicts with witness votes" );
+   transfer_to_vesting_operation vest;
+   vest.from = "hank";
+   vest.to = "hank";
+   vest.amount = ASSET( "1.000 TESTS" );
+   add_transaction( vest );
+
+   account_witness_vote_operation witness_vote;
+   witness_vote.account = "ivan";
+   witness_vote.witness = "judy";
+   add_transaction( witness_vote );
+
+   auto analysis = util::analyze_block_conflicts( block );
+   BOOST_REQUIRE( analysis.transaction_groups == std::vector< uint32_t >( { 0, 1, 0, 0, 0, 0, 2, 2 } ) );
+   BOOST_REQUIRE_EQUAL( analysis.group_count, 3 );
+   BOOST_REQUIRE_EQUAL( analysis.largest_group, 5 );
+   BOOST_REQUIRE_EQUAL( analysis.global_transactions, 4 );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -46,14 +46,32 @@ using namespace steem::protocol;
 
 BOOST_AUTO_TEST_SUITE( block_tests )
 
-void open_test_database( database& db, const fc::path& dir )
+database::open_args test_open_args( const fc::path& dir )
 {
    database::open_args args;
    args.data_dir = dir;
    args.shared_mem_dir = dir;
    args.initial_supply = INITIAL_TEST_SUPPLY;
    args.shared_file_size = TEST_SHARED_MEM_SIZE;
-   db.open( args );
+   return args;
+}
+
+void open_test_database( database& db, const fc::path& dir )
+{
+   db.open( test_open_args( dir ) );
+}
+
+fc::ecc::private_key test_init_key()
+{
+   return fc::ecc::private_key::regenerate( fc::sha256::hash( string( "init_key" ) ) );
+}
+
+/// Generates blocks until block_num is irreversible
+void generate_until_irreversible( database& db, uint32_t block_num )
+{
+   auto init_account_priv_key = test_init_key();
+   while( db.get_dynamic_global_properties().last_irreversible_block_num < block_num )
+      db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
 }
 
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
@@ -126,6 +144,338 @@ BOOST_AUTO_TEST_CASE( generate_empty_blocks )
    }
 }
 
+BOOST_AUTO_TEST_CASE( block_log_read )
+{
+   try {
+      for( bool compress : { false, true } )
+      {
+         BOOST_TEST_MESSAGE( "Testing " << ( compress ? "compressed" : "uncompressed" ) << " block log" );
+
+         fc::temp_directory data_dir( steem::utilities::temp_directory_path() );
+         fc::path log_file = data_dir.path() / "block_log";
+         std::vector< signed_block > blocks;
+
+         {
+            block_log log;
+            log.open( log_file, compress );
+            BOOST_CHECK( !log.head().valid() );
+            BOOST_CHECK_EQUAL( log.is_compressed(), compress );
+
+            for( uint32_t i = 0; i < 10; ++i )
+            {
+               signed_block b;
+               b.previous = blocks.empty() ? block_id_type() : blocks.back().id();
+               b.timestamp = fc::time_point_sec( STEEM_TESTING_GENESIS_TIMESTAMP + i * STEEM_BLOCK_INTERVAL );
+               b.witness = STEEM_GENESIS_WITNESS_NAME;
+               blocks.push_back( b );
+               log.append( b );
+
+               // Appended blocks are visible to readers immediately
+               auto read = log.read_block_by_num( b.block_num() );
+               BOOST_REQUIRE( read.valid() );
+               BOOST_CHECK( read->id() == b.id() );
+            }
+
+            BOOST_CHECK( !log.read_block_by_num( 11 ).valid() );
+            BOOST_CHECK( log.get_block_pos( 0 ) == block_log::npos );
+            BOOST_CHECK( log.get_block_pos( 11 ) == block_log::npos );
+         }
+
+         {
+            // The format of an existing log wins over the requested one
+            block_log log;
+            log.open( log_file, !compress );
+            BOOST_CHECK_EQUAL( log.is_compressed(), compress );
+            BOOST_REQUIRE( log.head().valid() );
+            BOOST_CHECK( log.head()->id() == blocks.back().id() );
+
+            auto itr = log.read_block( log.get_block_pos( 1 ) );
+            for( size_t i = 0; i < blocks.size(); ++i )
+            {
+               BOOST_CHECK( itr.first.id() == blocks[i].id() );
+               if( i + 1 < blocks.size() )
+                  itr = log.read_block( itr.second );
+            }
+
+            auto range = log.read_block_range( 3, 4 );
+            BOOST_REQUIRE_EQUAL( range.size(), 4u );
+            for( size_t i = 0; i < range.size(); ++i )
+               BOOST_CHECK( range[i].id() == blocks[ i + 2 ].id() );
+
+            // Ranges stop at the head of the log
+            range = log.read_block_range( 8, 100 );
+            BOOST_REQUIRE_EQUAL( range.size(), 3u );
+            BOOST_CHECK( range.back().id() == blocks.back().id() );
+
+            BOOST_CHECK( log.read_block_range( 0, 5 ).empty() );
+            BOOST_CHECK( log.read_block_range( 11, 5 ).empty() );
+            BOOST_CHECK( log.read_block_range( 1, 0 ).empty() );
+         }
+
+         fc::remove_all( fc::path( log_file.generic_string() + ".index" ) );
+
+         {
+            block_log log;
+            log.open( log_file );
+
+            for( const auto& b : blocks )
+            {
+               auto read = log.read_block_by_num( b.block_num() );
+               BOOST_REQUIRE( read.valid() );
+               BOOST_CHECK( read->id() == b.id() );
+            }
+         }
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( state_snapshot )
+{
+   try {
+      fc::temp_directory data_dir( steem::utilities::temp_directory_path() );
+      fc::temp_directory snapshot_dir( steem::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "init_key" ) ) );
+      auto snapshot_file = data_dir.path() / "state.snapshot";
+
+      {
+         database db;
+         db._log_hardforks = false;
+         open_test_database( db, data_dir.path() );
+         while( db.get_dynamic_global_properties().last_irreversible_block_num < 50 )
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         db.close();
+      }
+
+      block_id_type head_id;
+      size_t account_count = 0;
+      asset init_balance;
+      {
+         database db;
+         db._log_hardforks = false;
+         open_test_database( db, data_dir.path() );
+         head_id = db.head_block_id();
+         account_count = db.count< account_object >();
+         init_balance = db.get_account( STEEM_GENESIS_WITNESS_NAME ).balance;
+
+         BOOST_TEST_MESSAGE( "Exporting the state at block " << db.head_block_num() );
+         db.with_read_lock( [&]() { db.export_snapshot( snapshot_file ); } );
+         db.close();
+      }
+
+      fc::copy( data_dir.path() / "block_log", snapshot_dir.path() / "block_log" );
+      fc::copy( data_dir.path() / "block_log.index", snapshot_dir.path() / "block_log.index" );
+
+      database::open_args args;
+      args.data_dir = snapshot_dir.path();
+      args.shared_mem_dir = snapshot_dir.path();
+      args.initial_supply = INITIAL_TEST_SUPPLY;
+      args.shared_file_size = TEST_SHARED_MEM_SIZE;
+      args.load_snapshot = snapshot_file;
+
+      {
+         BOOST_TEST_MESSAGE( "Loading the snapshot into an empty database" );
+         database db;
+         db._log_hardforks = false;
+         db.open( args );
+
+         BOOST_REQUIRE( db.head_block_id() == head_id );
+         BOOST_REQUIRE_EQUAL( db.count< account_object >(), account_count );
+         BOOST_REQUIRE( db.get_account( STEEM_GENESIS_WITNESS_NAME ).balance == init_balance );
+
+         auto b = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         BOOST_REQUIRE( db.head_block_id() == b.id() );
+         db.close();
+      }
+
+      BOOST_TEST_MESSAGE( "Rejecting a corrupted snapshot" );
+      {
+         std::fstream f( snapshot_file.generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+         f.seekp( -1, std::ios::end );
+         f.put( 0x55 );
+      }
+
+      fc::remove_all( snapshot_dir.path() / "shared_memory.bin" );
+      fc::remove_all( snapshot_dir.path() / "shared_memory.meta" );
+      database db;
+      db._log_hardforks = false;
+      STEEM_REQUIRE_THROW( db.open( args ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( compact_shared_memory )
+{
+   try {
+      fc::temp_directory data_dir( steem::utilities::temp_directory_path() );
+      auto args = test_open_args( data_dir.path() );
+
+      database db;
+      db._log_hardforks = false;
+      db.open( args );
+      generate_until_irreversible( db, 50 );
+      db.close();
+
+      db.open( args );
+      auto head_id = db.head_block_id();
+      auto account_count = db.count< account_object >();
+      auto free_memory = db.get_free_memory();
+
+      BOOST_TEST_MESSAGE( "Compacting rebuilds the state in a fresh segment" );
+      db.compact( args );
+
+      BOOST_REQUIRE( db.head_block_id() == head_id );
+      BOOST_REQUIRE_EQUAL( db.count< account_object >(), account_count );
+      BOOST_REQUIRE_GE( db.get_free_memory(), free_memory );
+      BOOST_REQUIRE( !fc::exists( data_dir.path() / "compact.snapshot" ) );
+
+      auto b = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), test_init_key(), database::skip_nothing );
+      BOOST_REQUIRE( db.head_block_id() == b.id() );
+      db.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+#ifndef IS_LOW_MEM
+BOOST_AUTO_TEST_CASE( reindex_deferred_indices )
+{
+   try {
+      fc::temp_directory data_dir( steem::utilities::temp_directory_path() );
+      auto init_account_priv_key = test_init_key();
+      auto args = test_open_args( data_dir.path() );
+
+      time_point_sec edited;
+      {
+         database db;
+         db._log_hardforks = false;
+         db.open( args );
+
+         signed_transaction trx;
+         comment_operation op;
+         op.author = STEEM_GENESIS_WITNESS_NAME;
+         op.permlink = "test";
+         op.parent_permlink = "test";
+         op.title = "foo";
+         op.body = "bar";
+         trx.operations.push_back( op );
+         trx.set_expiration( db.head_block_time() + STEEM_MAX_TIME_UNTIL_EXPIRATION );
+         trx.sign( init_account_priv_key, db.get_chain_id() );
+         PUSH_TX( db, trx );
+         db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+
+         trx.clear();
+         op.body = "baz";
+         trx.operations.push_back( op );
+         trx.set_expiration( db.head_block_time() + STEEM_MAX_TIME_UNTIL_EXPIRATION );
+         trx.sign( init_account_priv_key, db.get_chain_id() );
+         PUSH_TX( db, trx );
+         db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+
+         const auto& clu = db.get< comment_last_update_object, by_comment >( db.get_comment( STEEM_GENESIS_WITNESS_NAME, string( "test" ) ).id );
+         edited = clu.last_update;
+         BOOST_REQUIRE( edited == db.head_block_time() );
+
+         generate_until_irreversible( db, db.head_block_num() );
+         db.close();
+      }
+
+      BOOST_TEST_MESSAGE( "Replaying leaves comment_last_update_index to be built after the last block" );
+      database db;
+      db._log_hardforks = false;
+      db.reindex( args );
+
+      const auto& comment = db.get_comment( STEEM_GENESIS_WITNESS_NAME, string( "test" ) );
+      BOOST_REQUIRE_EQUAL( db.count< comment_last_update_object >(), db.count< comment_object >() );
+      BOOST_REQUIRE( db.get< comment_last_update_object, by_comment >( comment.id ).last_update == edited );
+      BOOST_REQUIRE( !db.is_index_deferred< comment_last_update_index >() );
+
+      const auto& by_last_update_idx = db.get_index< comment_last_update_index, by_author_last_update >();
+      auto itr = by_last_update_idx.lower_bound( account_name_type( STEEM_GENESIS_WITNESS_NAME ) );
+      BOOST_REQUIRE( itr != by_last_update_idx.end() && itr->comment == comment.id );
+      db.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+#endif
+
+#ifndef IS_LOW_MEM
+BOOST_AUTO_TEST_CASE( external_comment_content )
+{
+   try {
+      fc::temp_directory data_dir( steem::utilities::temp_directory_path() );
+      auto init_account_priv_key = test_init_key();
+      auto args = test_open_args( data_dir.path() );
+      args.comment_content_store = true;
+
+      database db;
+      db._log_hardforks = false;
+      db.open( args );
+
+      signed_transaction trx;
+      comment_operation op;
+      op.author = STEEM_GENESIS_WITNESS_NAME;
+      op.permlink = "test";
+      op.parent_permlink = "test";
+      op.title = "foo";
+      op.body = "bar";
+      trx.operations.push_back( op );
+      trx.set_expiration( db.head_block_time() + STEEM_MAX_TIME_UNTIL_EXPIRATION );
+      trx.sign( init_account_priv_key, db.get_chain_id() );
+      PUSH_TX( db, trx );
+      db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+
+      comment_id_type comment = db.get_comment( STEEM_GENESIS_WITNESS_NAME, string( "test" ) ).id;
+      BOOST_REQUIRE( db.find< comment_content_object, by_comment >( comment ) != nullptr );
+
+      BOOST_TEST_MESSAGE( "Content moves to the store once its block is irreversible" );
+      generate_until_irreversible( db, db.head_block_num() );
+
+      BOOST_REQUIRE( db.find< comment_content_object, by_comment >( comment ) == nullptr );
+      BOOST_REQUIRE_EQUAL( db.get_comment_content( comment ).title, "foo" );
+      BOOST_REQUIRE_EQUAL( db.get_comment_content( comment ).body, "bar" );
+
+      BOOST_TEST_MESSAGE( "An edit starts from the stored content" );
+      trx.clear();
+      op.title = "";
+      op.body = "baz";
+      trx.operations.push_back( op );
+      trx.set_expiration( db.head_block_time() + STEEM_MAX_TIME_UNTIL_EXPIRATION );
+      trx.sign( init_account_priv_key, db.get_chain_id() );
+      PUSH_TX( db, trx );
+      db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+
+      BOOST_REQUIRE( db.find< comment_content_object, by_comment >( comment ) != nullptr );
+      BOOST_REQUIRE_EQUAL( db.get_comment_content( comment ).title, "foo" );
+      BOOST_REQUIRE_EQUAL( db.get_comment_content( comment ).body, "baz" );
+
+      generate_until_irreversible( db, db.head_block_num() );
+
+      BOOST_REQUIRE( db.find< comment_content_object, by_comment >( comment ) == nullptr );
+      BOOST_REQUIRE_EQUAL( db.get_comment_content( comment ).body, "baz" );
+      db.close();
+
+      BOOST_TEST_MESSAGE( "The store survives a restart and cannot be dropped without a replay" );
+      db.open( args );
+      BOOST_REQUIRE_EQUAL( db.get_comment_content( comment ).body, "baz" );
+      db.close();
+
+      args.comment_content_store = false;
+      STEEM_REQUIRE_THROW( db.open( args ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+#endif
+
 BOOST_AUTO_TEST_CASE( undo_block )
 {
    try {
@@ -355,6 +705,71 @@ BOOST_AUTO_TEST_CASE( duplicate_transactions )
    }
 }
 
+BOOST_AUTO_TEST_CASE( reapply_pending_transactions )
+{
+   try {
+      fc::temp_directory dir1( steem::utilities::temp_directory_path() ),
+                         dir2( steem::utilities::temp_directory_path() );
+      database db1,
+               db2;
+      db1._log_hardforks = false;
+      open_test_database( db1, dir1.path() );
+      db2._log_hardforks = false;
+      open_test_database( db2, dir2.path() );
+
+      auto skip_sigs = database::skip_transaction_signatures | database::skip_authority_check;
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("init_key")) );
+      public_key_type init_account_pub_key  = init_account_priv_key.get_public_key();
+
+      BOOST_TEST_MESSAGE( "Pushing a long lived and a short lived pending transaction" );
+      signed_transaction trx;
+      account_create_operation cop;
+      cop.new_account_name = "alice";
+      cop.creator = STEEM_GENESIS_WITNESS_NAME;
+      cop.owner = authority(1, init_account_pub_key, 1);
+      cop.active = cop.owner;
+      trx.operations.push_back(cop);
+      trx.set_expiration( db1.head_block_time() + STEEM_MAX_TIME_UNTIL_EXPIRATION );
+      trx.sign( init_account_priv_key, db1.get_chain_id() );
+      PUSH_TX( db1, trx, skip_sigs );
+      auto long_lived_id = trx.id();
+
+      trx = decltype(trx)();
+      cop.new_account_name = "bob";
+      trx.operations.push_back(cop);
+      trx.set_expiration( db1.head_block_time() + STEEM_BLOCK_INTERVAL );
+      trx.sign( init_account_priv_key, db1.get_chain_id() );
+      PUSH_TX( db1, trx, skip_sigs );
+      auto short_lived_id = trx.id();
+
+      BOOST_REQUIRE_EQUAL( db1._pending_tx.size(), 2 );
+      BOOST_REQUIRE( db1._validated_tx.count( long_lived_id ) );
+      BOOST_REQUIRE( db1._validated_tx.count( short_lived_id ) );
+
+      BOOST_TEST_MESSAGE( "Pushing a block that expires the short lived transaction" );
+      auto b = db2.generate_block( db2.get_slot_time(1), db2.get_scheduled_witness( 1 ), init_account_priv_key, skip_sigs );
+      PUSH_BLOCK( db1, b, skip_sigs );
+
+      BOOST_REQUIRE_EQUAL( db1._pending_tx.size(), 1 );
+      BOOST_REQUIRE( db1._pending_tx.front().id() == long_lived_id );
+      BOOST_REQUIRE( db1._validated_tx.count( long_lived_id ) );
+      BOOST_REQUIRE( !db1._validated_tx.count( short_lived_id ) );
+      BOOST_REQUIRE( db1.find_account( "alice" ) != nullptr );
+      BOOST_REQUIRE( db1.find_account( "bob" ) == nullptr );
+
+      BOOST_TEST_MESSAGE( "Including the pending transaction in a block" );
+      b = db1.generate_block( db1.get_slot_time(1), db1.get_scheduled_witness( 1 ), init_account_priv_key, skip_sigs );
+      BOOST_REQUIRE_EQUAL( b.transactions.size(), 1 );
+      BOOST_REQUIRE_EQUAL( db1._pending_tx.size(), 0 );
+      BOOST_REQUIRE( db1._validated_tx.empty() );
+      BOOST_REQUIRE( db1.find_account( "alice" ) != nullptr );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( tapos )
 {
    try {
@@ -119,6 +119,9 @@ BOOST_AUTO_TEST_CASE( apply_account_creation )
       BOOST_REQUIRE( acct.balance.amount.value == ASSET( "0.000 TESTS" ).amount.value );
       BOOST_REQUIRE( acct.sbd_balance.amount.value == ASSET( "0.000 TBD" ).amount.value );
       BOOST_REQUIRE( acct.id._id == acct_auth.id._id );
+#ifndef IS_LOW_MEM
+      BOOST_REQUIRE( db->get< account_metadata_object, by_account >( acct.id ).json_metadata == "{\"foo\":\"bar\"}" );
+#endif
 
       /// because init_witness has created vesting shares and blocks have been produced, 100 STEEM is worth less than 100 vesting shares due to rounding
       BOOST_REQUIRE( acct.vesting_shares.amount.value == ( op.fee * ( vest_shares / vests ) ).amount.value );
@@ -338,13 +341,9 @@ BOOST_AUTO_TEST_CASE( apply_account_update )
       BOOST_REQUIRE( acct_auth.active == authority( 2, new_private_key.get_public_key(), 2 ) );
       BOOST_REQUIRE( acct.memo_key == new_private_key.get_public_key() );
 
-      /* This is being moved out of consensus
       #ifndef IS_LOW_MEM
-         BOOST_REQUIRE( acct.json_metadata == "{\"bar\":\"foo\"}" );
-      #else
-         BOOST_REQUIRE( acct.json_metadata == "" );
+         BOOST_REQUIRE( db->get< account_metadata_object, by_account >( acct.id ).json_metadata == "{\"bar\":\"foo\"}" );
       #endif
-      */
 
       validate_database();
 
@@ -1761,7 +1760,7 @@ BOOST_AUTO_TEST_CASE( apply_claimed_account_creation )
       BOOST_REQUIRE( bob_auth.posting == authority( 3, priv_key.get_public_key(), 3 ) );
       BOOST_REQUIRE( bob.memo_key == priv_key.get_public_key() );
 #ifndef IS_LOW_MEM // json_metadata is not stored on low memory nodes
-      BOOST_REQUIRE( bob.json_metadata == "{\"foo\":\"bar\"}" );
+      BOOST_REQUIRE( db->get< account_metadata_object, by_account >( bob.id ).json_metadata == "{\"foo\":\"bar\"}" );
 #endif
       BOOST_REQUIRE( bob.proxy == "" );
       BOOST_REQUIRE( bob.recovery_account == "alice" );
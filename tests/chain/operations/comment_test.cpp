@@ -122,7 +122,7 @@ BOOST_AUTO_TEST_CASE( apply_comment )
 
       BOOST_REQUIRE( alice_comment.author == op.author );
       BOOST_REQUIRE( to_string( alice_comment.permlink ) == op.permlink );
-      BOOST_REQUIRE( to_string( alice_comment.parent_permlink ) == op.parent_permlink );
+      BOOST_REQUIRE( db->get_permlink( alice_comment.parent_permlink ) == op.parent_permlink );
       BOOST_REQUIRE( alice_comment.last_update == db->head_block_time() );
       BOOST_REQUIRE( alice_comment.created == db->head_block_time() );
       BOOST_REQUIRE( alice_comment.net_rshares.value == 0 );
@@ -167,13 +167,15 @@ BOOST_AUTO_TEST_CASE( apply_comment )
       BOOST_REQUIRE( bob_comment.author == op.author );
       BOOST_REQUIRE( to_string( bob_comment.permlink ) == op.permlink );
       BOOST_REQUIRE( bob_comment.parent_author == op.parent_author );
-      BOOST_REQUIRE( to_string( bob_comment.parent_permlink ) == op.parent_permlink );
+      BOOST_REQUIRE( db->get_permlink( bob_comment.parent_permlink ) == op.parent_permlink );
       BOOST_REQUIRE( bob_comment.last_update == db->head_block_time() );
       BOOST_REQUIRE( bob_comment.created == db->head_block_time() );
       BOOST_REQUIRE( bob_comment.net_rshares.value == 0 );
       BOOST_REQUIRE( bob_comment.abs_rshares.value == 0 );
       BOOST_REQUIRE( bob_comment.cashout_time == bob_comment.created + STEEM_CASHOUT_WINDOW_SECONDS );
       BOOST_REQUIRE( bob_comment.root_comment == alice_comment.id );
+      BOOST_REQUIRE( bob_comment.permlink_hash == permlink_hash( op.permlink ) );
+      BOOST_REQUIRE( bob_comment.category == alice_comment.category );
       validate_database();
 
       BOOST_TEST_MESSAGE( "--- Test Sam posting a comment on Bob's comment" );
@@ -194,7 +196,7 @@ BOOST_AUTO_TEST_CASE( apply_comment )
       BOOST_REQUIRE( sam_comment.author == op.author );
       BOOST_REQUIRE( to_string( sam_comment.permlink ) == op.permlink );
       BOOST_REQUIRE( sam_comment.parent_author == op.parent_author );
-      BOOST_REQUIRE( to_string( sam_comment.parent_permlink ) == op.parent_permlink );
+      BOOST_REQUIRE( db->get_permlink( sam_comment.parent_permlink ) == op.parent_permlink );
       BOOST_REQUIRE( sam_comment.last_update == db->head_block_time() );
       BOOST_REQUIRE( sam_comment.created == db->head_block_time() );
       BOOST_REQUIRE( sam_comment.net_rshares.value == 0 );
@@ -238,7 +240,7 @@ BOOST_AUTO_TEST_CASE( apply_comment )
       BOOST_REQUIRE( mod_sam_comment.author == op.author );
       BOOST_REQUIRE( to_string( mod_sam_comment.permlink ) == op.permlink );
       BOOST_REQUIRE( mod_sam_comment.parent_author == op.parent_author );
-      BOOST_REQUIRE( to_string( mod_sam_comment.parent_permlink ) == op.parent_permlink );
+      BOOST_REQUIRE( db->get_permlink( mod_sam_comment.parent_permlink ) == op.parent_permlink );
       BOOST_REQUIRE( mod_sam_comment.last_update == db->head_block_time() );
       BOOST_REQUIRE( mod_sam_comment.created == created );
       BOOST_REQUIRE( mod_sam_comment.cashout_time == mod_sam_comment.created + STEEM_CASHOUT_WINDOW_SECONDS );
@@ -334,8 +336,11 @@ BOOST_AUTO_TEST_CASE( apply_comment_delete )
       tx.sign( alice_private_key, db->get_chain_id() );
       db->push_transaction( tx, 0 );
 
-      auto test_comment = db->find< comment_object, by_permlink >( boost::make_tuple( "alice", string( "test1" ) ) );
+      auto test_comment = db->find_comment( "alice", string( "test1" ) );
       BOOST_REQUIRE( test_comment == nullptr );
+      // Only parent permlinks and categories are interned, and they are kept after deletes
+      BOOST_REQUIRE( db->find_permlink( "test1" ) == nullptr );
+      BOOST_REQUIRE( db->find_permlink( "test" ) != nullptr );
 
 
       BOOST_TEST_MESSAGE( "--- Test failure deleting a comment past cashout" );
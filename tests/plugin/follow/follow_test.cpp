@@ -0,0 +1,201 @@
+#ifdef IS_TEST_NET
+#include <boost/test/unit_test.hpp>
+
+#include <steem/chain/account_object.hpp>
+#include <steem/chain/comment_object.hpp>
+#include <steem/protocol/steem_operations.hpp>
+
+#include <steem/plugins/follow/follow_plugin.hpp>
+#include <steem/plugins/follow/follow_objects.hpp>
+#include <steem/plugins/follow/follow_operations.hpp>
+
+#include "../../fixtures/database_fixture.hpp"
+
+using namespace steem::chain;
+using namespace steem::protocol;
+
+BOOST_FIXTURE_TEST_SUITE( follow, database_fixture )
+
+BOOST_AUTO_TEST_CASE( deferred_feed_updates )
+{
+   using namespace steem::plugins::follow;
+
+   try
+   {
+      int argc = boost::unit_test::framework::master_test_suite().argc;
+      char** argv = boost::unit_test::framework::master_test_suite().argv;
+      for( int i=1; i<argc; i++ )
+      {
+         const std::string arg = argv[i];
+         if( arg == "--record-assert-trip" )
+            fc::enable_record_assert_trip = true;
+         if( arg == "--show-test-names" )
+            std::cout << "running test " << boost::unit_test::framework::current_test_case().p_name << std::endl;
+      }
+
+      std::string defer_arg = "--follow-defer-feed-updates=true";
+      std::string feed_size_arg = "--follow-max-feed-size=3";
+      std::vector< char* > follow_argv = { argv[0], &defer_arg[0], &feed_size_arg[0] };
+
+      appbase::app().register_plugin< follow_plugin >();
+      db_plugin = &appbase::app().register_plugin< steem::plugins::debug_node::debug_node_plugin >();
+      init_account_pub_key = init_account_priv_key.get_public_key();
+
+      db_plugin->logging = false;
+      appbase::app().initialize<
+         steem::plugins::follow::follow_plugin,
+         steem::plugins::debug_node::debug_node_plugin
+      >( follow_argv.size(), follow_argv.data() );
+
+      db = &appbase::app().get_plugin< steem::plugins::chain::chain_plugin >().db();
+      BOOST_REQUIRE( db );
+      BOOST_REQUIRE( appbase::app().get_plugin< follow_plugin >().defer_feed_updates );
+
+      open_database();
+
+      generate_block();
+      db->set_hardfork( STEEM_NUM_HARDFORKS );
+      generate_block();
+
+      ACTORS( (alice)(bob)(carol)(dave)(eve)(sam)(zoe) );
+      generate_block();
+
+      std::map< std::string, fc::ecc::private_key > keys = {
+         { "alice", alice_private_key }, { "bob", bob_private_key }, { "carol", carol_private_key },
+         { "dave", dave_private_key }, { "eve", eve_private_key }, { "sam", sam_private_key }, { "zoe", zoe_private_key } };
+
+      auto push = [&]( const operation& op, const std::string& signer )
+      {
+         signed_transaction tx;
+         tx.operations.push_back( op );
+         tx.set_expiration( db->head_block_time() + STEEM_MAX_TIME_UNTIL_EXPIRATION );
+         tx.set_reference_block( db->head_block_id() );
+         tx.sign( keys.at( signer ), db->get_chain_id() );
+         db->push_transaction( tx, 0 );
+      };
+
+      auto post = [&]( const std::string& author, const std::string& permlink )
+      {
+         comment_operation op;
+         op.author = author;
+         op.permlink = permlink;
+         op.parent_permlink = "test";
+         op.title = "foo";
+         op.body = "bar";
+         push( op, author );
+      };
+
+      auto follow_blog = [&]( const std::string& follower, const std::string& following )
+      {
+         follow_operation fop;
+         fop.follower = follower;
+         fop.following = following;
+         fop.what.insert( "blog" );
+
+         custom_json_operation op;
+         op.id = STEEM_FOLLOW_PLUGIN_NAME;
+         op.required_posting_auths.insert( follower );
+         op.json = fc::json::to_string( follow_plugin_operation( fop ) );
+         push( op, follower );
+      };
+
+      auto reblog = [&]( const std::string& account, const std::string& author, const std::string& permlink )
+      {
+         reblog_operation rop;
+         rop.account = account;
+         rop.author = author;
+         rop.permlink = permlink;
+
+         custom_json_operation op;
+         op.id = STEEM_FOLLOW_PLUGIN_NAME;
+         op.required_posting_auths.insert( account );
+         op.json = fc::json::to_string( follow_plugin_operation( rop ) );
+         push( op, account );
+      };
+
+      const auto& feed_idx = db->get_index< feed_index >().indices().get< by_feed >();
+
+      // The feed of account, oldest entry first
+      auto get_feed = [&]( const std::string& account )
+      {
+         std::vector< const feed_object* > feed;
+         for( auto itr = feed_idx.lower_bound( account ); itr != feed_idx.end() && itr->account == account; ++itr )
+            feed.insert( feed.begin(), &*itr );
+         return feed;
+      };
+
+      auto comment_id = [&]( const std::string& author, const std::string& permlink )
+      {
+         return db->get_comment( author, permlink ).id;
+      };
+
+      for( const auto& author : { "alice", "bob", "carol", "dave", "eve" } )
+         follow_blog( "sam", author );
+      generate_block();
+
+      BOOST_TEST_MESSAGE( "--- Posts of pending transactions are not in feeds" );
+      post( "alice", "a1" );
+      BOOST_REQUIRE( get_feed( "sam" ).empty() );
+      generate_block();
+
+      auto feed = get_feed( "sam" );
+      BOOST_REQUIRE_EQUAL( feed.size(), 1u );
+      BOOST_REQUIRE( feed[0]->comment == comment_id( "alice", "a1" ) );
+      BOOST_REQUIRE_EQUAL( feed[0]->account_feed_id, 0u );
+
+      BOOST_TEST_MESSAGE( "--- Several posts of one block are trimmed once, as if added one by one" );
+      post( "bob", "b1" );
+      post( "carol", "c1" );
+      post( "dave", "d1" );
+      post( "eve", "e1" );
+      generate_block();
+
+      // Adding entries one by one keeps those at most max_feed_size ids older than the last one
+      feed = get_feed( "sam" );
+      BOOST_REQUIRE_EQUAL( feed.size(), 4u );
+      BOOST_REQUIRE( feed[0]->comment == comment_id( "bob", "b1" ) );
+      BOOST_REQUIRE( feed[1]->comment == comment_id( "carol", "c1" ) );
+      BOOST_REQUIRE( feed[2]->comment == comment_id( "dave", "d1" ) );
+      BOOST_REQUIRE( feed[3]->comment == comment_id( "eve", "e1" ) );
+      for( uint32_t i = 0; i < feed.size(); ++i )
+         BOOST_REQUIRE_EQUAL( feed[i]->account_feed_id, i + 1 );
+
+      BOOST_TEST_MESSAGE( "--- A post reblogged in the same block has no first reblog" );
+      generate_blocks( db->head_block_time() + fc::seconds( STEEM_MIN_ROOT_COMMENT_INTERVAL.to_seconds() + STEEM_BLOCK_INTERVAL ) );
+      post( "alice", "a2" );
+      reblog( "bob", "alice", "a2" );
+      generate_block();
+
+      feed = get_feed( "sam" );
+      BOOST_REQUIRE_EQUAL( feed.size(), 4u );
+      BOOST_REQUIRE( feed.back()->comment == comment_id( "alice", "a2" ) );
+      BOOST_REQUIRE( feed.back()->reblogged_by.size() == 1 && feed.back()->reblogged_by[0] == account_name_type( "bob" ) );
+      BOOST_REQUIRE( feed.back()->first_reblogged_by == account_name_type() );
+
+      BOOST_TEST_MESSAGE( "--- Feeds are built from the followers at the end of the block" );
+      post( "carol", "c2" );
+      follow_blog( "zoe", "carol" );
+      generate_block();
+
+      feed = get_feed( "zoe" );
+      BOOST_REQUIRE_EQUAL( feed.size(), 1u );
+      BOOST_REQUIRE( feed[0]->comment == comment_id( "carol", "c2" ) );
+
+      BOOST_TEST_MESSAGE( "--- Posts deleted in the same block are not added to feeds" );
+      post( "dave", "d2" );
+      delete_comment_operation del;
+      del.author = "dave";
+      del.permlink = "d2";
+      push( del, "dave" );
+      generate_block();
+
+      feed = get_feed( "sam" );
+      BOOST_REQUIRE( feed.back()->comment == comment_id( "carol", "c2" ) );
+
+      validate_database();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+#endif
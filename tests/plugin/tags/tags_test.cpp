@@ -0,0 +1,144 @@
+#ifdef IS_TEST_NET
+#include <boost/test/unit_test.hpp>
+
+#include <steem/chain/account_object.hpp>
+#include <steem/chain/comment_object.hpp>
+#include <steem/protocol/steem_operations.hpp>
+
+#include <steem/plugins/tags/tags_plugin.hpp>
+
+#include "../../fixtures/database_fixture.hpp"
+
+using namespace steem::chain;
+using namespace steem::protocol;
+
+BOOST_FIXTURE_TEST_SUITE( tags, database_fixture )
+
+BOOST_AUTO_TEST_CASE( deferred_score_updates )
+{
+   using namespace steem::plugins::tags;
+
+   try
+   {
+      int argc = boost::unit_test::framework::master_test_suite().argc;
+      char** argv = boost::unit_test::framework::master_test_suite().argv;
+      for( int i=1; i<argc; i++ )
+      {
+         const std::string arg = argv[i];
+         if( arg == "--record-assert-trip" )
+            fc::enable_record_assert_trip = true;
+         if( arg == "--show-test-names" )
+            std::cout << "running test " << boost::unit_test::framework::current_test_case().p_name << std::endl;
+      }
+
+      std::string defer_arg = "--tags-defer-score-updates";
+      std::string skip_arg = "--tags-skip-startup-update";
+      std::vector< char* > tags_argv = { argv[0], &defer_arg[0], &skip_arg[0] };
+
+      appbase::app().register_plugin< tags_plugin >();
+      db_plugin = &appbase::app().register_plugin< steem::plugins::debug_node::debug_node_plugin >();
+      init_account_pub_key = init_account_priv_key.get_public_key();
+
+      db_plugin->logging = false;
+      appbase::app().initialize<
+         steem::plugins::tags::tags_plugin,
+         steem::plugins::debug_node::debug_node_plugin
+      >( tags_argv.size(), tags_argv.data() );
+
+      db = &appbase::app().get_plugin< steem::plugins::chain::chain_plugin >().db();
+      BOOST_REQUIRE( db );
+
+      open_database();
+
+      // Only marks the plugin as started, the chain plugin is not started by the fixture
+      appbase::app().get_plugin< tags_plugin >().plugin_startup();
+
+      generate_block();
+      db->set_hardfork( STEEM_NUM_HARDFORKS );
+      generate_block();
+
+      ACTORS( (alice)(bob)(carol)(dave) );
+      generate_block();
+
+      vest( "bob", ASSET( "1000.000 TESTS" ) );
+      vest( "carol", ASSET( "1000.000 TESTS" ) );
+      vest( "dave", ASSET( "1000.000 TESTS" ) );
+      generate_block();
+
+      std::map< std::string, fc::ecc::private_key > keys = {
+         { "alice", alice_private_key }, { "bob", bob_private_key },
+         { "carol", carol_private_key }, { "dave", dave_private_key } };
+
+      auto push = [&]( const operation& op, const std::string& signer )
+      {
+         signed_transaction tx;
+         tx.operations.push_back( op );
+         tx.set_expiration( db->head_block_time() + STEEM_MAX_TIME_UNTIL_EXPIRATION );
+         tx.set_reference_block( db->head_block_id() );
+         tx.sign( keys.at( signer ), db->get_chain_id() );
+         db->push_transaction( tx, 0 );
+      };
+
+      auto vote = [&]( const std::string& voter )
+      {
+         vote_operation op;
+         op.voter = voter;
+         op.author = "alice";
+         op.permlink = "lorem";
+         op.weight = STEEM_100_PERCENT;
+         push( op, voter );
+      };
+
+      comment_operation post;
+      post.author = "alice";
+      post.permlink = "lorem";
+      post.parent_permlink = "test";
+      post.title = "foo";
+      post.body = "bar";
+      post.json_metadata = "{\"tags\":[\"ipsum\"]}";
+      push( post, "alice" );
+      generate_block();
+
+      const auto& tag_idx = db->get_index< tag_index, steem::plugins::tags::by_comment >();
+      const auto& comment = db->get_comment( "alice", string( "lorem" ) );
+
+      auto get_tags = [&]()
+      {
+         std::vector< const tag_object* > result;
+         for( auto itr = tag_idx.lower_bound( comment.id ); itr != tag_idx.end() && itr->comment == comment.id; ++itr )
+            result.push_back( &*itr );
+         return result;
+      };
+
+      BOOST_REQUIRE_EQUAL( get_tags().size(), 2u );
+
+      BOOST_TEST_MESSAGE( "--- Votes of pending transactions do not update the scores" );
+      vote( "bob" );
+      vote( "carol" );
+      vote( "dave" );
+
+      BOOST_REQUIRE_EQUAL( comment.net_votes, 3 );
+      for( const auto* tag : get_tags() )
+      {
+         BOOST_REQUIRE_EQUAL( tag->net_votes, 0 );
+         BOOST_REQUIRE_EQUAL( tag->net_rshares, 0 );
+      }
+
+      BOOST_TEST_MESSAGE( "--- Several votes of one block are applied once at the end of the block" );
+      generate_block();
+
+      BOOST_REQUIRE_EQUAL( comment.net_votes, 3 );
+      BOOST_REQUIRE( comment.net_rshares > 0 );
+      for( const auto* tag : get_tags() )
+      {
+         BOOST_REQUIRE_EQUAL( tag->net_votes, comment.net_votes );
+         BOOST_REQUIRE_EQUAL( tag->net_rshares, comment.net_rshares.value );
+      }
+
+      validate_database();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+#endif